@@ -0,0 +1,70 @@
+// SPDX-FileCopyrightText: 2026 Frank Hunleth
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// C API for other NIF libraries
+//
+// This lets another NIF library, like an SPI display driver, read and write
+// Circuits.GPIO handles without going back to Elixir. Only this header is
+// needed. It's stable: functions are only ever added to the end of the
+// table and the version is bumped when that happens.
+//
+// Get the table's address from `Circuits.GPIO.CApi.api/0` and pass it to
+// the other library along with the handle's resource from
+// `Circuits.GPIO.CApi.resource/1`:
+//
+//     static const struct circuits_gpio_api *gpio_api;
+//
+//     ErlNifUInt64 address;
+//     if (!enif_get_uint64(env, argv[0], &address))
+//         return enif_make_badarg(env);
+//     gpio_api = (const struct circuits_gpio_api *) (uintptr_t) address;
+//     if (gpio_api->magic != CIRCUITS_GPIO_API_MAGIC ||
+//             gpio_api->version < CIRCUITS_GPIO_API_VERSION)
+//         return enif_make_badarg(env);
+//
+//     circuits_gpio_handle *dc;
+//     if (!gpio_api->get_handle(env, argv[1], &dc))
+//         return enif_make_badarg(env);
+//     gpio_api->keep_handle(dc);
+//
+// Handles are only valid while the other library holds a reference to them.
+// Functions that return an int return 0 or a negative errno. Reads and writes
+// can be called from any thread. Closing the handle from Elixir waits for any
+// that are in progress and later ones return -EBADF. Pass NULL for env when calling from a
+// thread that wasn't created by the BEAM.
+
+#ifndef CIRCUITS_GPIO_API_H
+#define CIRCUITS_GPIO_API_H
+
+#include <erl_nif.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CIRCUITS_GPIO_API_MAGIC 0x4750494fU // "GPIO"
+#define CIRCUITS_GPIO_API_VERSION 1
+
+typedef struct circuits_gpio_handle circuits_gpio_handle;
+
+struct circuits_gpio_api {
+    uint32_t magic;
+    uint32_t version;
+
+    // Get the handle from a resource term. Returns false if it isn't one.
+    bool (*get_handle)(ErlNifEnv *env, ERL_NIF_TERM term, circuits_gpio_handle **handle);
+
+    // Hold on to a handle after the NIF call returns and let it go
+    void (*keep_handle)(circuits_gpio_handle *handle);
+    void (*release_handle)(circuits_gpio_handle *handle);
+
+    // Number of lines in the handle. Bit i of values is line i.
+    int (*num_lines)(const circuits_gpio_handle *handle);
+
+    // Read all of the handle's lines
+    int (*read)(circuits_gpio_handle *handle, uint64_t *value);
+
+    // Set the lines in mask to value. The handle must be an output.
+    int (*write)(ErlNifEnv *env, circuits_gpio_handle *handle, uint64_t mask, uint64_t value);
+};
+
+#endif // CIRCUITS_GPIO_API_H
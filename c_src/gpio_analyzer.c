@@ -0,0 +1,324 @@
+// SPDX-FileCopyrightText: 2026 Frank Hunleth
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Logic analyzer captures
+//
+// A capture records the edges on a set of handles into a buffer that's
+// allocated when it starts so that nothing is sent per edge. Each handle gets
+// a subscriber in the analyzer mode that adds its edges to the shared capture.
+//
+// Until the trigger, the buffer is a ring that keeps the last pre_trigger
+// edges. The value that each handle had before the oldest kept edge is
+// remembered so that the capture can be replayed from a known state. After
+// the trigger, edges are added until the buffer is full.
+
+#include "gpio_nif.h"
+
+#include <string.h>
+
+// Bytes per edge in capture_stop's binary:
+// <<timestamp::little-signed-64, value::little-64, source::8>>
+#define ANALYZER_RECORD_SIZE 17
+#define ANALYZER_MAX_EDGES (1 << 22)
+
+struct analyzer_edge {
+    int64_t timestamp;
+    uint64_t value;
+    int source;
+};
+
+// Shared by the subscribers of a capture. Everything is guarded by the lock
+// since the handles' changes can be delivered from different threads.
+struct gpio_analyzer {
+    ErlNifMutex *lock;
+
+    int num_sources;
+    int widths[MAX_GPIO_LISTENERS];
+
+    // Each handle's value before the first edge in the buffer and when that
+    // was
+    uint64_t initial[MAX_GPIO_LISTENERS];
+    int64_t start_timestamp;
+
+    // Trigger when (value & trigger_mask) becomes trigger_pattern on
+    // trigger_source. trigger_source is -1 to start triggered.
+    int trigger_source;
+    uint64_t trigger_mask;
+    uint64_t trigger_pattern;
+    bool triggered;
+    int64_t trigger_timestamp;
+
+    // Ring of edges. Only the first pre_trigger slots are used until the
+    // trigger.
+    struct analyzer_edge *edges;
+    int capacity;
+    int pre_trigger;
+    int first;
+    int count;
+
+    // Edges that came after the buffer filled up or the capture was stopped
+    uint64_t dropped;
+    bool stopped;
+};
+
+// Per-handle subscriber state
+struct analyzer_source {
+    struct gpio_analyzer *analyzer;
+    int source;
+};
+
+void gpio_analyzer_dtor(ErlNifEnv *env, void *obj)
+{
+    (void) env;
+    struct gpio_analyzer *analyzer = (struct gpio_analyzer *) obj;
+
+    if (analyzer->lock)
+        enif_mutex_destroy(analyzer->lock);
+    if (analyzer->edges)
+        enif_free(analyzer->edges);
+}
+
+static bool get_analyzer_options(ErlNifEnv *env, struct gpio_analyzer *analyzer, ERL_NIF_TERM options)
+{
+    ERL_NIF_TERM value;
+
+    analyzer->capacity = 65536;
+    if (enif_get_map_value(env, options, enif_make_atom(env, "max_edges"), &value) &&
+            (!enif_get_int(env, value, &analyzer->capacity) ||
+             analyzer->capacity < 1 || analyzer->capacity > ANALYZER_MAX_EDGES))
+        return false;
+
+    if (enif_get_map_value(env, options, enif_make_atom(env, "pre_trigger"), &value) &&
+            (!enif_get_int(env, value, &analyzer->pre_trigger) ||
+             analyzer->pre_trigger < 0 || analyzer->pre_trigger > analyzer->capacity))
+        return false;
+
+    // trigger: {source, mask, pattern}
+    analyzer->trigger_source = -1;
+    if (enif_get_map_value(env, options, enif_make_atom(env, "trigger"), &value)) {
+        const ERL_NIF_TERM *tuple;
+        int arity;
+        ErlNifUInt64 mask, pattern;
+        if (!enif_get_tuple(env, value, &arity, &tuple) ||
+                arity != 3 ||
+                !enif_get_int(env, tuple[0], &analyzer->trigger_source) ||
+                analyzer->trigger_source < 0 ||
+                analyzer->trigger_source >= analyzer->num_sources ||
+                !enif_get_uint64(env, tuple[1], &mask) ||
+                !enif_get_uint64(env, tuple[2], &pattern) ||
+                (pattern & ~mask) != 0)
+            return false;
+
+        analyzer->trigger_mask = mask;
+        analyzer->trigger_pattern = pattern;
+    }
+
+    return true;
+}
+
+struct gpio_analyzer *alloc_gpio_analyzer(ErlNifEnv *env, int num_sources, ERL_NIF_TERM options)
+{
+    struct gpio_priv *priv = enif_priv_data(env);
+    struct gpio_analyzer *analyzer = enif_alloc_resource(priv->gpio_analyzer_rt, sizeof(struct gpio_analyzer));
+    memset(analyzer, 0, sizeof(struct gpio_analyzer));
+    analyzer->num_sources = num_sources;
+
+    if (!get_analyzer_options(env, analyzer, options)) {
+        enif_release_resource(analyzer);
+        return NULL;
+    }
+
+    analyzer->lock = enif_mutex_create("gpio_analyzer");
+    analyzer->edges = enif_alloc(sizeof(struct analyzer_edge) * analyzer->capacity);
+    if (!analyzer->lock || !analyzer->edges) {
+        enif_release_resource(analyzer);
+        return NULL;
+    }
+
+    analyzer->triggered = (analyzer->trigger_source < 0);
+    analyzer->start_timestamp = hal_timestamp();
+    analyzer->trigger_timestamp = analyzer->triggered ? analyzer->start_timestamp : 0;
+    return analyzer;
+}
+
+void attach_gpio_analyzer(struct gpio_sub *sub, struct gpio_analyzer *analyzer, int source, struct gpio_pin *pin)
+{
+    struct analyzer_source *state = sub->state;
+
+    enif_keep_resource(analyzer);
+    state->analyzer = analyzer;
+    state->source = source;
+
+    uint64_t value = 0;
+    hal_read_gpio(pin, &value);
+
+    enif_mutex_lock(analyzer->lock);
+    analyzer->widths[source] = pin->num_lines;
+    analyzer->initial[source] = value;
+    enif_mutex_unlock(analyzer->lock);
+}
+
+static bool trigger_matches(const struct gpio_analyzer *analyzer, uint64_t value)
+{
+    return (value & analyzer->trigger_mask) == analyzer->trigger_pattern;
+}
+
+static void add_edge(struct gpio_analyzer *analyzer, int source, const struct gpio_change *change)
+{
+    int limit = analyzer->triggered ? analyzer->capacity : analyzer->pre_trigger;
+
+    if (analyzer->count == limit) {
+        if (analyzer->triggered) {
+            analyzer->dropped++;
+            return;
+        }
+
+        // Before the trigger, make room by forgetting the oldest edge
+        if (limit > 0) {
+            const struct analyzer_edge *oldest = &analyzer->edges[analyzer->first];
+            analyzer->initial[oldest->source] = oldest->value;
+            analyzer->start_timestamp = oldest->timestamp;
+            analyzer->first = (analyzer->first + 1) % analyzer->capacity;
+            analyzer->count--;
+        } else {
+            analyzer->initial[source] = change->value;
+            analyzer->start_timestamp = change->timestamp;
+            return;
+        }
+    }
+
+    struct analyzer_edge *edge = &analyzer->edges[(analyzer->first + analyzer->count) % analyzer->capacity];
+    edge->timestamp = change->timestamp;
+    edge->value = change->value;
+    edge->source = source;
+    analyzer->count++;
+}
+
+static bool analyzer_init(ErlNifEnv *env, struct gpio_sub *sub, int num_lines, ERL_NIF_TERM options)
+{
+    // The capture is attached by capture_start
+    return true;
+}
+
+static void analyzer_update(ErlNifEnv *env, ErlNifEnv *msg_env, struct gpio_sub *sub, const struct gpio_change *change)
+{
+    struct analyzer_source *state = sub->state;
+    struct gpio_analyzer *analyzer = state->analyzer;
+    bool triggered = false;
+    bool filled = false;
+
+    enif_mutex_lock(analyzer->lock);
+    if (analyzer->stopped) {
+        analyzer->dropped++;
+        enif_mutex_unlock(analyzer->lock);
+        return;
+    }
+
+    if (!analyzer->triggered &&
+            state->source == analyzer->trigger_source &&
+            trigger_matches(analyzer, change->value) &&
+            !trigger_matches(analyzer, change->previous_value)) {
+        analyzer->triggered = true;
+        analyzer->trigger_timestamp = change->timestamp;
+        triggered = true;
+    }
+
+    bool was_full = analyzer->triggered && analyzer->count == analyzer->capacity;
+    add_edge(analyzer, state->source, change);
+    filled = !was_full && analyzer->triggered && analyzer->count == analyzer->capacity;
+    enif_mutex_unlock(analyzer->lock);
+
+    if (triggered)
+        send_gpio_event(env, msg_env, sub, enif_make_atom(msg_env, "triggered"), change->timestamp, enif_make_new_map(msg_env));
+    if (filled)
+        send_gpio_event(env, msg_env, sub, enif_make_atom(msg_env, "capture_full"), change->timestamp, enif_make_new_map(msg_env));
+}
+
+static ERL_NIF_TERM analyzer_read(ErlNifEnv *env, struct gpio_sub *sub, bool clear)
+{
+    struct analyzer_source *state = sub->state;
+    struct gpio_analyzer *analyzer = state->analyzer;
+
+    enif_mutex_lock(analyzer->lock);
+    ERL_NIF_TERM map = enif_make_new_map(env);
+    enif_make_map_put(env, map, enif_make_atom(env, "edges"), enif_make_int(env, analyzer->count), &map);
+    enif_make_map_put(env, map, enif_make_atom(env, "triggered"), enif_make_atom(env, analyzer->triggered ? "true" : "false"), &map);
+    enif_mutex_unlock(analyzer->lock);
+
+    return map;
+}
+
+static void analyzer_dtor(struct gpio_sub *sub)
+{
+    struct analyzer_source *state = sub->state;
+
+    if (state->analyzer)
+        enif_release_resource(state->analyzer);
+}
+
+// Not in the list of modes that subscribe/2 can use
+const struct gpio_mode gpio_analyzer_mode = {
+    .name = "analyzer",
+    .state_size = sizeof(struct analyzer_source),
+    .init = analyzer_init,
+    .update = analyzer_update,
+    .read = analyzer_read,
+    .dtor = analyzer_dtor
+};
+
+static void put_le64(uint8_t *p, uint64_t value)
+{
+    for (int i = 0; i < 8; i++)
+        p[i] = (uint8_t) (value >> (8 * i));
+}
+
+static ERL_NIF_TERM make_capture_result(ErlNifEnv *env, const struct gpio_analyzer *analyzer)
+{
+    ERL_NIF_TERM edges;
+    uint8_t *p = enif_make_new_binary(env, (size_t) analyzer->count * ANALYZER_RECORD_SIZE, &edges);
+    for (int i = 0; i < analyzer->count; i++) {
+        const struct analyzer_edge *edge = &analyzer->edges[(analyzer->first + i) % analyzer->capacity];
+        put_le64(p, (uint64_t) edge->timestamp);
+        put_le64(p + 8, edge->value);
+        p[16] = (uint8_t) edge->source;
+        p += ANALYZER_RECORD_SIZE;
+    }
+
+    ERL_NIF_TERM widths[MAX_GPIO_LISTENERS];
+    ERL_NIF_TERM initial[MAX_GPIO_LISTENERS];
+    for (int i = 0; i < analyzer->num_sources; i++) {
+        widths[i] = enif_make_int(env, analyzer->widths[i]);
+        initial[i] = enif_make_uint64(env, analyzer->initial[i]);
+    }
+
+    ERL_NIF_TERM map = enif_make_new_map(env);
+    enif_make_map_put(env, map, enif_make_atom(env, "widths"), enif_make_list_from_array(env, widths, analyzer->num_sources), &map);
+    enif_make_map_put(env, map, enif_make_atom(env, "initial"), enif_make_list_from_array(env, initial, analyzer->num_sources), &map);
+    enif_make_map_put(env, map, enif_make_atom(env, "start_timestamp"), enif_make_int64(env, analyzer->start_timestamp), &map);
+    enif_make_map_put(env, map, enif_make_atom(env, "trigger_timestamp"),
+                      analyzer->triggered ? enif_make_int64(env, analyzer->trigger_timestamp) : enif_make_atom(env, "nil"), &map);
+    enif_make_map_put(env, map, enif_make_atom(env, "edges"), edges, &map);
+    enif_make_map_put(env, map, enif_make_atom(env, "dropped"), enif_make_uint64(env, analyzer->dropped), &map);
+    return map;
+}
+
+ERL_NIF_TERM capture_stop(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+    struct gpio_priv *priv = enif_priv_data(env);
+    struct gpio_analyzer *analyzer;
+
+    if (argc != 1 ||
+            !enif_get_resource(env, argv[0], priv->gpio_analyzer_rt, (void**) &analyzer))
+        return enif_make_badarg(env);
+
+    // Once stopped, subscribers only count drops, so the ring can be copied
+    // into the binary without the lock. Only the counts and the other fields
+    // need to be taken while holding it.
+    enif_mutex_lock(analyzer->lock);
+    analyzer->stopped = true;
+    struct gpio_analyzer snapshot = *analyzer;
+    enif_mutex_unlock(analyzer->lock);
+
+    return make_ok_tuple(env, make_capture_result(env, &snapshot));
+}
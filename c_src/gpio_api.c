@@ -0,0 +1,85 @@
+// SPDX-FileCopyrightText: 2026 Frank Hunleth
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// C API for other NIF libraries. See circuits_gpio_api.h.
+
+#include "gpio_nif.h"
+#include "circuits_gpio_api.h"
+
+#include <errno.h>
+
+// Other libraries call in with their own env, so enif_priv_data can't be used
+// to find the resource type
+static ErlNifResourceType *api_pin_rt;
+
+static bool api_get_handle(ErlNifEnv *env, ERL_NIF_TERM term, circuits_gpio_handle **handle)
+{
+    return api_pin_rt && enif_get_resource(env, term, api_pin_rt, (void**) handle);
+}
+
+static void api_keep_handle(circuits_gpio_handle *handle)
+{
+    enif_keep_resource(handle);
+}
+
+static void api_release_handle(circuits_gpio_handle *handle)
+{
+    enif_release_resource(handle);
+}
+
+static int api_num_lines(const circuits_gpio_handle *handle)
+{
+    const struct gpio_pin *pin = (const struct gpio_pin *) handle;
+    return pin->num_lines;
+}
+
+static int api_read(circuits_gpio_handle *handle, uint64_t *value)
+{
+    struct gpio_pin *pin = (struct gpio_pin *) handle;
+
+    // Elixir can close the handle while the other library is using it
+    if (!keep_gpio_fd(pin))
+        return -EBADF;
+
+    int rc = hal_read_gpio(pin, value);
+    release_gpio_fd(pin);
+    return rc;
+}
+
+static int api_write(ErlNifEnv *env, circuits_gpio_handle *handle, uint64_t mask, uint64_t value)
+{
+    struct gpio_pin *pin = (struct gpio_pin *) handle;
+    if (!keep_gpio_fd(pin))
+        return -EBADF;
+
+    int rc = line_request(pin)->config.is_output ? hal_write_gpio_masked(pin, mask, value, env) : -EPERM;
+    release_gpio_fd(pin);
+    return rc;
+}
+
+static const struct circuits_gpio_api gpio_api = {
+    .magic = CIRCUITS_GPIO_API_MAGIC,
+    .version = CIRCUITS_GPIO_API_VERSION,
+    .get_handle = api_get_handle,
+    .keep_handle = api_keep_handle,
+    .release_handle = api_release_handle,
+    .num_lines = api_num_lines,
+    .read = api_read,
+    .write = api_write
+};
+
+void init_gpio_api(struct gpio_priv *priv)
+{
+    api_pin_rt = priv->gpio_pin_rt;
+}
+
+ERL_NIF_TERM c_api(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+    (void) argc;
+    (void) argv;
+
+    return enif_make_tuple2(env,
+                            enif_make_uint(env, CIRCUITS_GPIO_API_VERSION),
+                            enif_make_uint64(env, (ErlNifUInt64) (uintptr_t) &gpio_api));
+}
@@ -0,0 +1,369 @@
+// SPDX-FileCopyrightText: 2026 Frank Hunleth
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Protocol decoders
+//
+// These are subscription modes that turn the edges of a serial protocol into
+// one message per frame. They only use edge timestamps, so they work the same
+// whether the edges come from the cdev poller thread or the stub. Adding a
+// decoder is a matter of adding a struct gpio_mode here and listing it in
+// gpio_modes.c.
+
+#include "gpio_nif.h"
+
+#include <string.h>
+
+// Counts that all decoders return from read_subscription
+struct decoder_stats {
+    uint64_t frames;
+    uint64_t errors;
+};
+
+static ERL_NIF_TERM make_decoder_stats(ErlNifEnv *env, struct decoder_stats *stats, bool clear)
+{
+    ERL_NIF_TERM map = enif_make_new_map(env);
+    enif_make_map_put(env, map, enif_make_atom(env, "frames"), enif_make_uint64(env, stats->frames), &map);
+    enif_make_map_put(env, map, enif_make_atom(env, "errors"), enif_make_uint64(env, stats->errors), &map);
+
+    if (clear)
+        memset(stats, 0, sizeof(struct decoder_stats));
+
+    return map;
+}
+
+static bool between(int64_t value, int64_t min, int64_t max)
+{
+    return value >= min && value <= max;
+}
+
+// Wiegand
+//
+// Bit 0 is the D0 line and bit 1 is D1. Both idle high. A low pulse on D0 is
+// a 0 and on D1 is a 1. Bits are sent most significant first and a frame ends
+// when no bits come for frame_gap_ns.
+
+struct wiegand_decoder {
+    struct decoder_stats stats;
+    int64_t frame_gap_ns;
+
+    int bits;
+    uint64_t data;
+    int64_t last_bit;
+};
+
+static bool wiegand_init(ErlNifEnv *env, struct gpio_sub *sub, int num_lines, ERL_NIF_TERM options)
+{
+    struct wiegand_decoder *decoder = sub->state;
+    decoder->frame_gap_ns = 25000000;
+
+    ERL_NIF_TERM value;
+    if (enif_get_map_value(env, options, enif_make_atom(env, "frame_gap_us"), &value)) {
+        ErlNifSInt64 gap_us;
+        if (!enif_get_int64(env, value, &gap_us) || gap_us <= 0 || gap_us > INT64_MAX / 1000)
+            return false;
+        decoder->frame_gap_ns = gap_us * 1000;
+    }
+
+    return num_lines == 2;
+}
+
+static void wiegand_update(ErlNifEnv *env, ErlNifEnv *msg_env, struct gpio_sub *sub, const struct gpio_change *change)
+{
+    struct wiegand_decoder *decoder = sub->state;
+
+    uint64_t falling = change->falling & 3;
+    if (falling == 0)
+        return;
+
+    // Both lines going low at once isn't a valid bit
+    if (falling == 3) {
+        decoder->stats.errors++;
+        return;
+    }
+
+    // Frames longer than 64 bits keep their last 64
+    decoder->data = (decoder->data << 1) | (falling == 2);
+    decoder->bits++;
+    decoder->last_bit = change->timestamp;
+}
+
+static int64_t wiegand_deadline(const struct gpio_sub *sub)
+{
+    const struct wiegand_decoder *decoder = sub->state;
+    return decoder->bits > 0 ? decoder->last_bit + decoder->frame_gap_ns : INT64_MAX;
+}
+
+static void wiegand_service(ErlNifEnv *env, ErlNifEnv *msg_env, struct gpio_sub *sub, int64_t now)
+{
+    struct wiegand_decoder *decoder = sub->state;
+    if (decoder->bits == 0 || decoder->last_bit + decoder->frame_gap_ns > now)
+        return;
+
+    ERL_NIF_TERM map = enif_make_new_map(msg_env);
+    enif_make_map_put(msg_env, map, enif_make_atom(msg_env, "bits"), enif_make_int(msg_env, decoder->bits), &map);
+    enif_make_map_put(msg_env, map, enif_make_atom(msg_env, "data"), enif_make_uint64(msg_env, decoder->data), &map);
+    send_gpio_event(env, msg_env, sub, enif_make_atom(msg_env, "wiegand"), decoder->last_bit, map);
+
+    decoder->stats.frames++;
+    decoder->bits = 0;
+    decoder->data = 0;
+}
+
+static ERL_NIF_TERM wiegand_read(ErlNifEnv *env, struct gpio_sub *sub, bool clear)
+{
+    struct wiegand_decoder *decoder = sub->state;
+    return make_decoder_stats(env, &decoder->stats, clear);
+}
+
+const struct gpio_mode gpio_wiegand_mode = {
+    .name = "wiegand",
+    .state_size = sizeof(struct wiegand_decoder),
+    .init = wiegand_init,
+    .update = wiegand_update,
+    .deadline = wiegand_deadline,
+    .service = wiegand_service,
+    .read = wiegand_read
+};
+
+// NEC infrared
+//
+// For the active-low output of an IR receiver module. A frame is a 9 ms burst
+// (low), a 4.5 ms space (high), and 32 bits sent least significant first.
+// Each bit is a 562 us burst followed by a 562 us space for a 0 or a 1687 us
+// space for a 1. A 9 ms burst and 2.25 ms space is a repeat code for a held
+// button.
+
+enum nec_state {
+    NEC_IDLE,
+    NEC_LEADER,
+    NEC_DATA,
+    NEC_REPEAT
+};
+
+struct nec_decoder {
+    struct decoder_stats stats;
+
+    enum nec_state state;
+    int64_t last_edge;
+    int bits;
+    uint32_t data;
+
+    bool have_last;
+    int address;
+    int command;
+};
+
+static bool nec_init(ErlNifEnv *env, struct gpio_sub *sub, int num_lines, ERL_NIF_TERM options)
+{
+    return num_lines == 1;
+}
+
+static void send_nec(ErlNifEnv *env, ErlNifEnv *msg_env, struct gpio_sub *sub, int64_t timestamp, bool repeat)
+{
+    struct nec_decoder *decoder = sub->state;
+
+    ERL_NIF_TERM map = enif_make_new_map(msg_env);
+    enif_make_map_put(msg_env, map, enif_make_atom(msg_env, "address"), enif_make_int(msg_env, decoder->address), &map);
+    enif_make_map_put(msg_env, map, enif_make_atom(msg_env, "command"), enif_make_int(msg_env, decoder->command), &map);
+    enif_make_map_put(msg_env, map, enif_make_atom(msg_env, "repeat"), enif_make_atom(msg_env, repeat ? "true" : "false"), &map);
+    send_gpio_event(env, msg_env, sub, enif_make_atom(msg_env, "nec"), timestamp, map);
+}
+
+static void nec_frame_done(ErlNifEnv *env, ErlNifEnv *msg_env, struct gpio_sub *sub, int64_t timestamp)
+{
+    struct nec_decoder *decoder = sub->state;
+    int address = decoder->data & 0xff;
+    int address_inverse = (decoder->data >> 8) & 0xff;
+    int command = (decoder->data >> 16) & 0xff;
+    int command_inverse = (decoder->data >> 24) & 0xff;
+
+    decoder->state = NEC_IDLE;
+    if ((command ^ command_inverse) != 0xff) {
+        decoder->stats.errors++;
+        return;
+    }
+
+    // Extended NEC uses both address bytes
+    decoder->address = ((address ^ address_inverse) == 0xff) ? address : (address | (address_inverse << 8));
+    decoder->command = command;
+    decoder->have_last = true;
+    decoder->stats.frames++;
+    send_nec(env, msg_env, sub, timestamp, false);
+}
+
+static void nec_update(ErlNifEnv *env, ErlNifEnv *msg_env, struct gpio_sub *sub, const struct gpio_change *change)
+{
+    struct nec_decoder *decoder = sub->state;
+    bool rising = change->rising & 1;
+    bool falling = change->falling & 1;
+    if (!rising && !falling)
+        return;
+
+    int64_t duration = change->timestamp - decoder->last_edge;
+    decoder->last_edge = change->timestamp;
+
+    switch (decoder->state) {
+    case NEC_IDLE:
+        // End of a burst. Check for a leader.
+        if (rising && between(duration, 7000000, 11000000))
+            decoder->state = NEC_LEADER;
+        break;
+
+    case NEC_LEADER:
+        if (falling && between(duration, 3500000, 5500000)) {
+            decoder->state = NEC_DATA;
+            decoder->bits = 0;
+            decoder->data = 0;
+        } else if (falling && between(duration, 1700000, 2800000)) {
+            decoder->state = NEC_REPEAT;
+        } else {
+            decoder->state = NEC_IDLE;
+        }
+        break;
+
+    case NEC_DATA:
+        if (rising) {
+            if (!between(duration, 200000, 900000)) {
+                decoder->stats.errors++;
+                decoder->state = NEC_IDLE;
+            }
+        } else if (between(duration, 200000, 900000)) {
+            decoder->bits++;
+        } else if (between(duration, 1200000, 2200000)) {
+            decoder->data |= (uint32_t) 1 << decoder->bits;
+            decoder->bits++;
+        } else {
+            decoder->stats.errors++;
+            decoder->state = NEC_IDLE;
+        }
+
+        if (decoder->state == NEC_DATA && decoder->bits == 32)
+            nec_frame_done(env, msg_env, sub, change->timestamp);
+        break;
+
+    case NEC_REPEAT:
+        if (rising && between(duration, 200000, 900000) && decoder->have_last)
+            send_nec(env, msg_env, sub, change->timestamp, true);
+        decoder->state = NEC_IDLE;
+        break;
+    }
+}
+
+static ERL_NIF_TERM nec_read(ErlNifEnv *env, struct gpio_sub *sub, bool clear)
+{
+    struct nec_decoder *decoder = sub->state;
+    return make_decoder_stats(env, &decoder->stats, clear);
+}
+
+const struct gpio_mode gpio_nec_mode = {
+    .name = "nec",
+    .state_size = sizeof(struct nec_decoder),
+    .init = nec_init,
+    .update = nec_update,
+    .read = nec_read
+};
+
+// DHT22 / AM2302
+//
+// After the host pulls the line low to start a reading and releases it, the
+// sensor answers with an 80 us low and 80 us high and then sends 40 bits. Each
+// bit is a 50 us low followed by a 26-28 us high for a 0 or a 70 us high for a
+// 1. Only the high times matter. The reading is the last 40 of them once the
+// line has been quiet for a millisecond. Anything longer than 200 us between
+// edges starts over.
+
+struct dht_decoder {
+    struct decoder_stats stats;
+
+    int64_t last_rise;
+    int64_t last_edge;
+    int bits;
+    uint64_t data;
+};
+
+static bool dht_init(ErlNifEnv *env, struct gpio_sub *sub, int num_lines, ERL_NIF_TERM options)
+{
+    struct dht_decoder *decoder = sub->state;
+    decoder->last_rise = -1;
+    return num_lines == 1;
+}
+
+static void dht_update(ErlNifEnv *env, ErlNifEnv *msg_env, struct gpio_sub *sub, const struct gpio_change *change)
+{
+    struct dht_decoder *decoder = sub->state;
+    bool rising = change->rising & 1;
+    bool falling = change->falling & 1;
+    if (!rising && !falling)
+        return;
+
+    if (change->timestamp - decoder->last_edge > 200000) {
+        decoder->bits = 0;
+        decoder->data = 0;
+        decoder->last_rise = -1;
+    }
+    decoder->last_edge = change->timestamp;
+
+    if (rising) {
+        decoder->last_rise = change->timestamp;
+    } else if (decoder->last_rise >= 0) {
+        int64_t high_ns = change->timestamp - decoder->last_rise;
+        decoder->data = (decoder->data << 1) | (high_ns > 50000);
+        decoder->bits++;
+    }
+}
+
+static int64_t dht_deadline(const struct gpio_sub *sub)
+{
+    const struct dht_decoder *decoder = sub->state;
+    return decoder->bits > 0 ? decoder->last_edge + 1000000 : INT64_MAX;
+}
+
+static void dht_service(ErlNifEnv *env, ErlNifEnv *msg_env, struct gpio_sub *sub, int64_t now)
+{
+    struct dht_decoder *decoder = sub->state;
+    if (decoder->bits == 0 || decoder->last_edge + 1000000 > now)
+        return;
+
+    int bits = decoder->bits;
+    uint64_t data = decoder->data;
+    decoder->bits = 0;
+    decoder->data = 0;
+
+    uint8_t bytes[5];
+    for (int i = 0; i < 5; i++)
+        bytes[i] = (data >> (32 - 8 * i)) & 0xff;
+
+    if (bits < 40 || (uint8_t) (bytes[0] + bytes[1] + bytes[2] + bytes[3]) != bytes[4]) {
+        decoder->stats.errors++;
+        return;
+    }
+
+    double humidity = ((bytes[0] << 8) | bytes[1]) / 10.0;
+    double temperature = (((bytes[2] & 0x7f) << 8) | bytes[3]) / 10.0;
+    if (bytes[2] & 0x80)
+        temperature = -temperature;
+
+    ERL_NIF_TERM map = enif_make_new_map(msg_env);
+    enif_make_map_put(msg_env, map, enif_make_atom(msg_env, "humidity"), enif_make_double(msg_env, humidity), &map);
+    enif_make_map_put(msg_env, map, enif_make_atom(msg_env, "temperature"), enif_make_double(msg_env, temperature), &map);
+    enif_make_map_put(msg_env, map, enif_make_atom(msg_env, "raw"), enif_make_uint64(msg_env, data & 0xffffffffffULL), &map);
+    send_gpio_event(env, msg_env, sub, enif_make_atom(msg_env, "dht"), decoder->last_edge, map);
+    decoder->stats.frames++;
+}
+
+static ERL_NIF_TERM dht_read(ErlNifEnv *env, struct gpio_sub *sub, bool clear)
+{
+    struct dht_decoder *decoder = sub->state;
+    return make_decoder_stats(env, &decoder->stats, clear);
+}
+
+const struct gpio_mode gpio_dht_mode = {
+    .name = "dht",
+    .state_size = sizeof(struct dht_decoder),
+    .init = dht_init,
+    .update = dht_update,
+    .deadline = dht_deadline,
+    .service = dht_service,
+    .read = dht_read
+};
@@ -0,0 +1,162 @@
+// SPDX-FileCopyrightText: 2026 Frank Hunleth
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Heartbeat and watchdog toggler
+//
+// Toggles every line of an output handle twice per period from a native
+// thread so that external watchdogs see a steady signal no matter how busy
+// the BEAM is. With a feed deadline, toggling stops when the BEAM hasn't
+// called heartbeat_feed for that long and starts again on the next feed. That
+// way the watchdog still notices when the VM really hangs.
+
+#include "gpio_nif.h"
+
+#include <errno.h>
+
+#define HEARTBEAT_MIN_PERIOD_NS 200000LL
+#define HEARTBEAT_MAX_PERIOD_NS 60000000000LL
+#define HEARTBEAT_MAX_FEED_NS 3600000000000LL
+
+struct gpio_heartbeat {
+    uint64_t mask;
+    int64_t half_period_ns;
+
+    // When non-zero, stop toggling when there hasn't been a feed for this long
+    int64_t feed_ns;
+
+    // Guarded by the task lock
+    int64_t last_feed;
+    bool starved;
+};
+
+static void send_heartbeat_event(struct gpio_task *task, const char *event, int64_t timestamp)
+{
+    ErlNifEnv *msg_env = task->msg_env;
+    send_task_event(task, enif_make_atom(msg_env, event), timestamp, enif_make_new_map(msg_env));
+}
+
+// Check the feed deadline. Returns true if toggling should continue.
+static bool heartbeat_fed(struct gpio_task *task, int64_t now)
+{
+    struct gpio_heartbeat *heartbeat = task->state;
+
+    if (heartbeat->feed_ns <= 0)
+        return true;
+
+    enif_mutex_lock(task->lock);
+    bool was_starved = heartbeat->starved;
+    heartbeat->starved = (now - heartbeat->last_feed > heartbeat->feed_ns);
+    bool starved = heartbeat->starved;
+    enif_mutex_unlock(task->lock);
+
+    if (starved && !was_starved)
+        send_heartbeat_event(task, "starved", now);
+    else if (!starved && was_starved)
+        send_heartbeat_event(task, "resumed", now);
+
+    return !starved;
+}
+
+static void heartbeat_run(struct gpio_task *task)
+{
+    struct gpio_heartbeat *heartbeat = task->state;
+    struct gpio_pin *pin = task->pins[0];
+    uint64_t value = 0;
+    int64_t next = hal_timestamp();
+
+    while (gpio_task_wait(task, next)) {
+        int64_t now = hal_timestamp();
+
+        // Wait for a feed to wake things up
+        if (!heartbeat_fed(task, now)) {
+            next = INT64_MAX;
+            continue;
+        }
+
+        if (next == INT64_MAX)
+            next = now;
+        if (now < next)
+            continue;
+
+        value ^= heartbeat->mask;
+        int rc = task_write_gpio_masked(pin, heartbeat->mask, value);
+        if (rc < 0) {
+            send_task_error(task, rc);
+            return;
+        }
+
+        // Skip toggles that were missed rather than running them back to back
+        next += heartbeat->half_period_ns;
+        if (next < now)
+            next = now + heartbeat->half_period_ns;
+    }
+}
+
+static const struct gpio_task_type gpio_heartbeat_task = {
+    .name = "gpio_heartbeat",
+    .state_size = sizeof(struct gpio_heartbeat),
+    .run = heartbeat_run
+};
+
+ERL_NIF_TERM heartbeat_start(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+    struct gpio_pin *pin;
+    ErlNifPid pid;
+    int64_t period_ns = 1000000000;
+    int64_t feed_ns = 0;
+
+    // heartbeat_start(gpio, notify_id, pid, options)
+    if (argc != 4 ||
+            !get_gpio_pin(env, argv[0], &pin) ||
+            !enif_get_local_pid(env, argv[2], &pid) ||
+            !get_option_int64(env, argv[3], "period_ns", HEARTBEAT_MIN_PERIOD_NS, HEARTBEAT_MAX_PERIOD_NS, &period_ns) ||
+            !get_option_int64(env, argv[3], "feed_ns", 0, HEARTBEAT_MAX_FEED_NS, &feed_ns))
+        return enif_make_badarg(env);
+
+    if (!line_request(pin)->config.is_output)
+        return enif_make_tuple2(env, atom_error, enif_make_atom(env, "pin_not_output"));
+
+    struct gpio_task *task = alloc_gpio_task(env, &gpio_heartbeat_task, &pid, argv[1]);
+    if (!task)
+        return make_errno_error(env, -ENOMEM);
+
+    struct gpio_heartbeat *heartbeat = task->state;
+    heartbeat->mask = (pin->num_lines >= 64) ? ~(uint64_t) 0 : (((uint64_t) 1 << pin->num_lines) - 1);
+    heartbeat->half_period_ns = period_ns / 2;
+    heartbeat->feed_ns = feed_ns;
+    heartbeat->last_feed = hal_timestamp();
+    add_gpio_task_pin(task, pin);
+
+    int rc = start_gpio_task(task);
+    if (rc < 0) {
+        enif_release_resource(task);
+        return make_errno_error(env, rc);
+    }
+
+    ERL_NIF_TERM task_term = enif_make_resource(env, task);
+    enif_release_resource(task);
+
+    return make_ok_tuple(env, task_term);
+}
+
+ERL_NIF_TERM heartbeat_feed(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+    struct gpio_task *task;
+
+    if (argc != 1 || !get_gpio_task(env, argv[0], &gpio_heartbeat_task, &task))
+        return enif_make_badarg(env);
+
+    struct gpio_heartbeat *heartbeat = task->state;
+
+    enif_mutex_lock(task->lock);
+    heartbeat->last_feed = hal_timestamp();
+    bool starved = heartbeat->starved;
+    enif_mutex_unlock(task->lock);
+
+    // The thread is waiting indefinitely when starved
+    if (starved)
+        wake_gpio_task(task);
+
+    return atom_ok;
+}
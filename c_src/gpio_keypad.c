@@ -0,0 +1,282 @@
+// SPDX-FileCopyrightText: 2026 Frank Hunleth
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Matrix keypad scanner
+//
+// Rows are an open-drain output group (open-source for active-high keypads) and
+// columns are an input group. Each scan drives one row at a time to its active
+// level and reads the columns. A key is pressed when its column reads the
+// active level while its row is driven. Between scans, all rows are left
+// inactive, which lets them float.
+
+#include "gpio_nif.h"
+
+#include <errno.h>
+#include <string.h>
+
+struct gpio_keypad {
+    int num_rows;
+    int num_cols;
+    bool active_low;
+
+    int64_t scan_ns;
+    int64_t settle_ns;
+    int64_t debounce_ns;
+
+    // Tuple with a key for each code or 0 to send codes. It's in the task's
+    // env.
+    ERL_NIF_TERM keys;
+
+    // Debounced key state with a bit per column for each row. This is read by
+    // keypad_pressed, so it's guarded by the task lock.
+    uint64_t pressed[GPIO_MAX_LINES];
+
+    // Row states that differ from pressed and when they were first seen
+    uint64_t pending[GPIO_MAX_LINES];
+    int64_t pending_since[GPIO_MAX_LINES];
+};
+
+static uint64_t lines_mask(int num_lines)
+{
+    return (num_lines >= 64) ? ~(uint64_t) 0 : (((uint64_t) 1 << num_lines) - 1);
+}
+
+static ERL_NIF_TERM make_key(ErlNifEnv *env, const struct gpio_keypad *keypad, int code)
+{
+    if (keypad->keys) {
+        const ERL_NIF_TERM *keys;
+        int arity;
+        enif_get_tuple(env, keypad->keys, &arity, &keys);
+        return enif_make_copy(env, keys[code]);
+    }
+    return enif_make_int(env, code);
+}
+
+static void send_key(struct gpio_task *task, int row, int col, bool down, int64_t timestamp)
+{
+    struct gpio_keypad *keypad = task->state;
+    ErlNifEnv *msg_env = task->msg_env;
+
+    ERL_NIF_TERM map = enif_make_new_map(msg_env);
+    enif_make_map_put(msg_env, map, enif_make_atom(msg_env, "key"), make_key(msg_env, keypad, row * keypad->num_cols + col), &map);
+    enif_make_map_put(msg_env, map, enif_make_atom(msg_env, "row"), enif_make_int(msg_env, row), &map);
+    enif_make_map_put(msg_env, map, enif_make_atom(msg_env, "column"), enif_make_int(msg_env, col), &map);
+    send_task_event(task, enif_make_atom(msg_env, down ? "key_down" : "key_up"), timestamp, map);
+}
+
+// Read which columns are active for each row
+static int scan_keypad(struct gpio_task *task, uint64_t *raw)
+{
+    struct gpio_keypad *keypad = task->state;
+    struct gpio_pin *rows = task->pins[0];
+    struct gpio_pin *cols = task->pins[1];
+    uint64_t row_mask = lines_mask(keypad->num_rows);
+    uint64_t col_mask = lines_mask(keypad->num_cols);
+    uint64_t idle = keypad->active_low ? row_mask : 0;
+
+    for (int row = 0; row < keypad->num_rows; row++) {
+        uint64_t row_bit = (uint64_t) 1 << row;
+        int rc = task_write_gpio_masked(rows, row_mask, idle ^ row_bit);
+        if (rc < 0)
+            return rc;
+
+        // Waiting with the task lets stop interrupt a long settle time
+        if (!gpio_task_wait(task, hal_timestamp() + keypad->settle_ns)) {
+            task_write_gpio_masked(rows, row_mask, idle);
+            return -EINTR;
+        }
+
+        uint64_t value;
+        rc = task_read_gpio(cols, &value);
+        if (rc < 0)
+            return rc;
+
+        raw[row] = (keypad->active_low ? ~value : value) & col_mask;
+    }
+
+    return task_write_gpio_masked(rows, row_mask, idle);
+}
+
+// A row's new state is accepted once it has been the same for debounce_ns
+static void debounce_keypad(struct gpio_task *task, const uint64_t *raw, int64_t now)
+{
+    struct gpio_keypad *keypad = task->state;
+
+    for (int row = 0; row < keypad->num_rows; row++) {
+        if (raw[row] == keypad->pressed[row] || raw[row] != keypad->pending[row]) {
+            keypad->pending[row] = raw[row];
+            keypad->pending_since[row] = now;
+            if (raw[row] != keypad->pressed[row] && keypad->debounce_ns > 0)
+                continue;
+        } else if (now - keypad->pending_since[row] < keypad->debounce_ns) {
+            continue;
+        }
+
+        uint64_t changed = raw[row] ^ keypad->pressed[row];
+        if (changed == 0)
+            continue;
+
+        enif_mutex_lock(task->lock);
+        keypad->pressed[row] = raw[row];
+        enif_mutex_unlock(task->lock);
+
+        for (; changed; changed &= changed - 1) {
+            int col = __builtin_ctzll(changed);
+            send_key(task, row, col, (raw[row] >> col) & 1, now);
+        }
+    }
+}
+
+static void keypad_run(struct gpio_task *task)
+{
+    struct gpio_keypad *keypad = task->state;
+    uint64_t raw[GPIO_MAX_LINES];
+    int64_t next_scan = hal_timestamp();
+
+    while (gpio_task_wait(task, next_scan)) {
+        int64_t now = hal_timestamp();
+        if (now < next_scan)
+            continue;
+
+        int rc = scan_keypad(task, raw);
+        if (rc == -EINTR)
+            return;
+        if (rc < 0) {
+            send_task_error(task, rc);
+            return;
+        }
+
+        debounce_keypad(task, raw, now);
+
+        // Skip scans that were missed rather than running them back to back
+        next_scan += keypad->scan_ns;
+        if (next_scan < now)
+            next_scan = now + keypad->scan_ns;
+    }
+}
+
+static const struct gpio_task_type gpio_keypad_task = {
+    .name = "gpio_keypad",
+    .state_size = sizeof(struct gpio_keypad),
+    .run = keypad_run
+};
+
+static bool keypad_init(ErlNifEnv *env, struct gpio_task *task, ERL_NIF_TERM options)
+{
+    struct gpio_keypad *keypad = task->state;
+    int64_t scan_ms = 10;
+    int64_t settle_us = 10;
+    int64_t debounce_us = 20000;
+    ERL_NIF_TERM value;
+
+    if (!get_option_int64(env, options, "scan_ms", 1, 60000, &scan_ms) ||
+            !get_option_int64(env, options, "settle_us", 0, 10000, &settle_us) ||
+            !get_option_int64(env, options, "debounce_us", 0, 1000000, &debounce_us))
+        return false;
+
+    keypad->scan_ns = scan_ms * 1000000;
+    keypad->settle_ns = settle_us * 1000;
+    keypad->debounce_ns = debounce_us * 1000;
+
+    // Every row settles once per scan, so they all have to fit in the period
+    if (keypad->settle_ns * keypad->num_rows >= keypad->scan_ns)
+        return false;
+
+    keypad->active_low = true;
+    if (enif_get_map_value(env, options, enif_make_atom(env, "active_low"), &value) &&
+            !enif_get_boolean(env, value, &keypad->active_low))
+        return false;
+
+    if (enif_get_map_value(env, options, enif_make_atom(env, "keys"), &value)) {
+        const ERL_NIF_TERM *keys;
+        int arity;
+        if (!enif_get_tuple(env, value, &arity, &keys) ||
+                arity != keypad->num_rows * keypad->num_cols)
+            return false;
+        keypad->keys = enif_make_copy(task->env, value);
+    }
+
+    return true;
+}
+
+ERL_NIF_TERM keypad_start(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+    struct gpio_pin *rows;
+    struct gpio_pin *cols;
+    ErlNifPid pid;
+
+    // keypad_start(rows, cols, notify_id, pid, options)
+    if (argc != 5 ||
+            !get_gpio_pin(env, argv[0], &rows) ||
+            !get_gpio_pin(env, argv[1], &cols) ||
+            !enif_get_local_pid(env, argv[3], &pid))
+        return enif_make_badarg(env);
+
+    if (!line_request(rows)->config.is_output)
+        return enif_make_tuple2(env, atom_error, enif_make_atom(env, "pin_not_output"));
+
+    struct gpio_task *task = alloc_gpio_task(env, &gpio_keypad_task, &pid, argv[2]);
+    if (!task)
+        return make_errno_error(env, -ENOMEM);
+
+    struct gpio_keypad *keypad = task->state;
+    keypad->num_rows = rows->num_lines;
+    keypad->num_cols = cols->num_lines;
+    add_gpio_task_pin(task, rows);
+    add_gpio_task_pin(task, cols);
+
+    if (!keypad_init(env, task, argv[4])) {
+        enif_release_resource(task);
+        return enif_make_badarg(env);
+    }
+
+    // Pressing two keys in a column connects their rows, so rows can only
+    // drive their active level. Otherwise a scanned row shorts to an idle one.
+    enum drive_mode drive = line_request(rows)->config.drive;
+    if (keypad->active_low && drive != DRIVE_OPEN_DRAIN) {
+        enif_release_resource(task);
+        return enif_make_tuple2(env, atom_error, enif_make_atom(env, "not_open_drain"));
+    }
+    if (!keypad->active_low && drive != DRIVE_OPEN_SOURCE) {
+        enif_release_resource(task);
+        return enif_make_tuple2(env, atom_error, enif_make_atom(env, "not_open_source"));
+    }
+
+    int rc = start_gpio_task(task);
+    if (rc < 0) {
+        enif_release_resource(task);
+        return make_errno_error(env, rc);
+    }
+
+    ERL_NIF_TERM task_term = enif_make_resource(env, task);
+    enif_release_resource(task);
+
+    return make_ok_tuple(env, task_term);
+}
+
+ERL_NIF_TERM keypad_pressed(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+    struct gpio_task *task;
+
+    if (argc != 1 || !get_gpio_task(env, argv[0], &gpio_keypad_task, &task))
+        return enif_make_badarg(env);
+
+    struct gpio_keypad *keypad = task->state;
+    uint64_t pressed[GPIO_MAX_LINES];
+
+    enif_mutex_lock(task->lock);
+    memcpy(pressed, keypad->pressed, sizeof(pressed));
+    enif_mutex_unlock(task->lock);
+
+    // Build the list backwards so that it's in code order
+    ERL_NIF_TERM list = enif_make_list(env, 0);
+    for (int row = keypad->num_rows - 1; row >= 0; row--) {
+        for (int col = keypad->num_cols - 1; col >= 0; col--) {
+            if ((pressed[row] >> col) & 1)
+                list = enif_make_list_cell(env, make_key(env, keypad, row * keypad->num_cols + col), list);
+        }
+    }
+
+    return list;
+}
@@ -0,0 +1,718 @@
+// SPDX-FileCopyrightText: 2026 Frank Hunleth
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Subscription modes
+//
+// These process changes where they're detected (the cdev poller thread or the
+// stub) and keep the results in the subscriber. Elixir reads them with
+// read_subscription/3 or gets occasional summary messages instead of one
+// message per edge.
+
+#include "gpio_nif.h"
+
+#include <string.h>
+
+static bool get_option_ms(ErlNifEnv *env, ERL_NIF_TERM options, const char *key, int64_t *ns)
+{
+    ERL_NIF_TERM value;
+    if (!enif_get_map_value(env, options, enif_make_atom(env, key), &value))
+        return true;
+
+    ErlNifSInt64 ms;
+    if (!enif_get_int64(env, value, &ms) || ms < 0 || ms > INT64_MAX / 1000000)
+        return false;
+
+    *ns = ms * 1000000;
+    return true;
+}
+
+// Encoder mode
+//
+// Bit 0 is A and bit 1 is B. Turning one way goes 00 -> 01 -> 11 -> 10 and
+// counts up. Every state change is a count, so there are four per cycle. An
+// optional bit 2 is the index (Z) line.
+
+#define ENCODER_ERROR 2
+
+// Indexed by (previous_state << 2) | state
+static const int8_t encoder_steps[16] = {
+    0, 1, -1, ENCODER_ERROR,
+    -1, 0, ENCODER_ERROR, 1,
+    1, ENCODER_ERROR, 0, -1,
+    ENCODER_ERROR, -1, 1, 0
+};
+
+static bool encoder_init(ErlNifEnv *env, struct gpio_sub *sub, int num_lines, ERL_NIF_TERM options)
+{
+    struct gpio_encoder *encoder = sub->state;
+
+    return (num_lines == 2 || num_lines == 3) &&
+           get_option_ms(env, options, "report_ms", &encoder->report_ns);
+}
+
+static void send_encoder_position(ErlNifEnv *env, ErlNifEnv *msg_env, struct gpio_sub *sub, int64_t timestamp)
+{
+    struct gpio_encoder *encoder = sub->state;
+
+    encoder->report_pending = false;
+    encoder->last_report = timestamp;
+
+    ERL_NIF_TERM map = enif_make_new_map(msg_env);
+    enif_make_map_put(msg_env, map, atom_position, enif_make_int64(msg_env, encoder->position), &map);
+    enif_make_map_put(msg_env, map, enif_make_atom(msg_env, "errors"), enif_make_uint64(msg_env, encoder->errors), &map);
+    send_gpio_event(env, msg_env, sub, atom_position, timestamp, map);
+}
+
+static void encoder_update(ErlNifEnv *env, ErlNifEnv *msg_env, struct gpio_sub *sub, const struct gpio_change *change)
+{
+    struct gpio_encoder *encoder = sub->state;
+
+    if (change->rising & 4) {
+        encoder->index_count++;
+        encoder->index_position = encoder->position;
+    }
+
+    if (((change->rising | change->falling) & 3) == 0)
+        return;
+
+    // Both lines changing or an edge that doesn't change the state means that
+    // an edge was missed
+    int step = encoder_steps[((change->previous_value & 3) << 2) | (change->value & 3)];
+    if (step == 0 || step == ENCODER_ERROR) {
+        encoder->errors++;
+        return;
+    }
+
+    encoder->position += step;
+
+    if (encoder->report_ns <= 0 || encoder->report_pending)
+        return;
+
+    // Report the first move right away and then at most once per report_ns
+    if (change->timestamp - encoder->last_report >= encoder->report_ns)
+        send_encoder_position(env, msg_env, sub, change->timestamp);
+    else
+        encoder->report_pending = true;
+}
+
+static int64_t encoder_deadline(const struct gpio_sub *sub)
+{
+    const struct gpio_encoder *encoder = sub->state;
+    return encoder->report_pending ? encoder->last_report + encoder->report_ns : INT64_MAX;
+}
+
+static void encoder_service(ErlNifEnv *env, ErlNifEnv *msg_env, struct gpio_sub *sub, int64_t now)
+{
+    const struct gpio_encoder *encoder = sub->state;
+    if (encoder->report_pending && encoder->last_report + encoder->report_ns <= now)
+        send_encoder_position(env, msg_env, sub, now);
+}
+
+static ERL_NIF_TERM encoder_read(ErlNifEnv *env, struct gpio_sub *sub, bool clear)
+{
+    struct gpio_encoder *encoder = sub->state;
+
+    ERL_NIF_TERM map = enif_make_new_map(env);
+    enif_make_map_put(env, map, atom_position, enif_make_int64(env, encoder->position), &map);
+    enif_make_map_put(env, map, enif_make_atom(env, "errors"), enif_make_uint64(env, encoder->errors), &map);
+    enif_make_map_put(env, map, enif_make_atom(env, "index_count"), enif_make_uint64(env, encoder->index_count), &map);
+    enif_make_map_put(env, map, enif_make_atom(env, "index_position"), enif_make_int64(env, encoder->index_position), &map);
+
+    if (clear) {
+        encoder->position = 0;
+        encoder->errors = 0;
+        encoder->index_count = 0;
+        encoder->index_position = 0;
+    }
+
+    return map;
+}
+
+static const struct gpio_mode encoder_mode = {
+    .name = "encoder",
+    .state_size = sizeof(struct gpio_encoder),
+    .init = encoder_init,
+    .update = encoder_update,
+    .deadline = encoder_deadline,
+    .service = encoder_service,
+    .read = encoder_read
+};
+
+// Counter mode
+//
+// Count the edges selected by the trigger on each line of line_mask and
+// compute their frequency over a sliding window.
+
+static bool counter_init(ErlNifEnv *env, struct gpio_sub *sub, int num_lines, ERL_NIF_TERM options)
+{
+    struct gpio_counter *counter = sub->state;
+
+    counter->num_lines = num_lines;
+    counter->both_edges = (sub->emit_trigger == TRIGGER_BOTH);
+    counter->window_ns = 1000000000;
+    counter->start = hal_timestamp();
+    counter->bucket_start = counter->start;
+    counter->last_report = counter->start;
+
+    return get_option_ms(env, options, "window_ms", &counter->window_ns) &&
+           counter->window_ns > 0 &&
+           get_option_ms(env, options, "report_ms", &counter->report_ns);
+}
+
+// Move the window up to now, dropping buckets that fall out of it
+static void counter_advance(struct gpio_counter *counter, int64_t now)
+{
+    int64_t bucket_ns = counter->window_ns / GPIO_COUNTER_BUCKETS;
+
+    if (now - counter->bucket_start >= counter->window_ns + bucket_ns) {
+        // Nothing's left in the window
+        for (int i = 0; i < counter->num_lines; i++)
+            memset(counter->lines[i].buckets, 0, sizeof(counter->lines[i].buckets));
+        counter->bucket_start = now;
+        return;
+    }
+
+    while (now - counter->bucket_start >= bucket_ns) {
+        counter->bucket = (counter->bucket + 1) % GPIO_COUNTER_BUCKETS;
+        counter->bucket_start += bucket_ns;
+        for (int i = 0; i < counter->num_lines; i++)
+            counter->lines[i].buckets[counter->bucket] = 0;
+    }
+}
+
+static void counter_update(ErlNifEnv *env, ErlNifEnv *msg_env, struct gpio_sub *sub, const struct gpio_change *change)
+{
+    struct gpio_counter *counter = sub->state;
+
+    uint64_t edges;
+    switch (sub->emit_trigger) {
+    case TRIGGER_RISING: edges = change->rising; break;
+    case TRIGGER_FALLING: edges = change->falling; break;
+    case TRIGGER_BOTH: edges = change->rising | change->falling; break;
+    default: edges = 0; break;
+    }
+    edges &= sub->line_mask;
+    if (edges == 0)
+        return;
+
+    counter_advance(counter, change->timestamp);
+
+    for (int i = 0; i < counter->num_lines; i++) {
+        if (!(edges & ((uint64_t) 1 << i)))
+            continue;
+
+        struct gpio_line_count *line = &counter->lines[i];
+        if (line->count == 0)
+            line->first_timestamp = change->timestamp;
+        line->last_timestamp = change->timestamp;
+        line->count++;
+        line->buckets[counter->bucket]++;
+    }
+}
+
+// Make a map with the counts and frequencies as of now
+static ERL_NIF_TERM make_counts(ErlNifEnv *env, struct gpio_counter *counter, int64_t now)
+{
+    counter_advance(counter, now);
+
+    // The current bucket is only partially through its time
+    int64_t bucket_ns = counter->window_ns / GPIO_COUNTER_BUCKETS;
+    int64_t span = (GPIO_COUNTER_BUCKETS - 1) * bucket_ns + (now - counter->bucket_start);
+    if (now - counter->start < span)
+        span = now - counter->start;
+
+    ERL_NIF_TERM atom_count = enif_make_atom(env, "count");
+    ERL_NIF_TERM atom_frequency = enif_make_atom(env, "frequency");
+    ERL_NIF_TERM atom_first_timestamp = enif_make_atom(env, "first_timestamp");
+    ERL_NIF_TERM atom_last_timestamp = enif_make_atom(env, "last_timestamp");
+    ERL_NIF_TERM atom_nil = enif_make_atom(env, "nil");
+
+    ERL_NIF_TERM lines[GPIO_MAX_LINES];
+    for (int i = 0; i < counter->num_lines; i++) {
+        const struct gpio_line_count *line = &counter->lines[i];
+
+        uint64_t recent = 0;
+        for (int j = 0; j < GPIO_COUNTER_BUCKETS; j++)
+            recent += line->buckets[j];
+
+        // Frequency is in cycles per second, so count both edges as one
+        double frequency = (span > 0) ? recent * 1e9 / span : 0.0;
+        if (counter->both_edges)
+            frequency /= 2;
+
+        ERL_NIF_TERM map = enif_make_new_map(env);
+        enif_make_map_put(env, map, atom_count, enif_make_uint64(env, line->count), &map);
+        enif_make_map_put(env, map, atom_frequency, enif_make_double(env, frequency), &map);
+        enif_make_map_put(env, map, atom_first_timestamp, line->count ? enif_make_int64(env, line->first_timestamp) : atom_nil, &map);
+        enif_make_map_put(env, map, atom_last_timestamp, line->count ? enif_make_int64(env, line->last_timestamp) : atom_nil, &map);
+        lines[i] = map;
+    }
+
+    ERL_NIF_TERM result = enif_make_new_map(env);
+    enif_make_map_put(env, result, enif_make_atom(env, "lines"), enif_make_list_from_array(env, lines, counter->num_lines), &result);
+    return result;
+}
+
+static int64_t counter_deadline(const struct gpio_sub *sub)
+{
+    const struct gpio_counter *counter = sub->state;
+    return counter->report_ns > 0 ? counter->last_report + counter->report_ns : INT64_MAX;
+}
+
+static void counter_service(ErlNifEnv *env, ErlNifEnv *msg_env, struct gpio_sub *sub, int64_t now)
+{
+    struct gpio_counter *counter = sub->state;
+    if (counter->report_ns <= 0 || counter->last_report + counter->report_ns > now)
+        return;
+
+    counter->last_report = now;
+    send_gpio_event(env, msg_env, sub, enif_make_atom(msg_env, "count"), now, make_counts(msg_env, counter, now));
+}
+
+static ERL_NIF_TERM counter_read(ErlNifEnv *env, struct gpio_sub *sub, bool clear)
+{
+    struct gpio_counter *counter = sub->state;
+    int64_t now = hal_timestamp();
+
+    ERL_NIF_TERM result = make_counts(env, counter, now);
+    enif_make_map_put(env, result, atom_timestamp, enif_make_int64(env, now), &result);
+
+    if (clear) {
+        memset(counter->lines, 0, sizeof(struct gpio_line_count) * counter->num_lines);
+        counter->start = now;
+        counter->bucket_start = now;
+    }
+
+    return result;
+}
+
+static const struct gpio_mode counter_mode = {
+    .name = "counter",
+    .state_size = sizeof(struct gpio_counter),
+    .init = counter_init,
+    .update = counter_update,
+    .deadline = counter_deadline,
+    .service = counter_service,
+    .read = counter_read
+};
+
+// Pulse mode
+//
+// Measure the high time of each pulse and the low time and period before it
+// on each line of line_mask. Each pulse can be sent as it ends or the
+// measurements can be summarized.
+
+static bool pulse_init(ErlNifEnv *env, struct gpio_sub *sub, int num_lines, ERL_NIF_TERM options)
+{
+    struct gpio_pulses *pulses = sub->state;
+
+    pulses->num_lines = num_lines;
+    pulses->last_report = hal_timestamp();
+    for (int i = 0; i < num_lines; i++) {
+        pulses->lines[i].last_rise = -1;
+        pulses->lines[i].last_fall = -1;
+        pulses->lines[i].low_ns = -1;
+        pulses->lines[i].period_ns = -1;
+    }
+
+    ERL_NIF_TERM value;
+    if (enif_get_map_value(env, options, enif_make_atom(env, "each_pulse"), &value) &&
+            !enif_get_boolean(env, value, &pulses->each_pulse))
+        return false;
+
+    return get_option_ms(env, options, "report_ms", &pulses->report_ns);
+}
+
+static void add_to_range(struct gpio_range *range, int64_t value)
+{
+    if (range->count == 0 || value < range->min)
+        range->min = value;
+    if (range->count == 0 || value > range->max)
+        range->max = value;
+    range->sum += value;
+    range->count++;
+}
+
+static ERL_NIF_TERM make_ns_or_nil(ErlNifEnv *env, int64_t ns)
+{
+    return ns >= 0 ? enif_make_int64(env, ns) : enif_make_atom(env, "nil");
+}
+
+static void send_pulse(ErlNifEnv *env,
+                       ErlNifEnv *msg_env,
+                       struct gpio_sub *sub,
+                       int line,
+                       int64_t timestamp,
+                       int64_t high_ns,
+                       int64_t low_ns,
+                       int64_t period_ns)
+{
+    ERL_NIF_TERM map = enif_make_new_map(msg_env);
+    enif_make_map_put(msg_env, map, enif_make_atom(msg_env, "line"), enif_make_int(msg_env, line), &map);
+    enif_make_map_put(msg_env, map, enif_make_atom(msg_env, "high_ns"), enif_make_int64(msg_env, high_ns), &map);
+    enif_make_map_put(msg_env, map, enif_make_atom(msg_env, "low_ns"), make_ns_or_nil(msg_env, low_ns), &map);
+    enif_make_map_put(msg_env, map, enif_make_atom(msg_env, "period_ns"), make_ns_or_nil(msg_env, period_ns), &map);
+    send_gpio_event(env, msg_env, sub, enif_make_atom(msg_env, "pulse"), timestamp, map);
+}
+
+static void pulse_update(ErlNifEnv *env, ErlNifEnv *msg_env, struct gpio_sub *sub, const struct gpio_change *change)
+{
+    struct gpio_pulses *pulses = sub->state;
+    uint64_t rising = change->rising & sub->line_mask;
+    uint64_t falling = change->falling & sub->line_mask;
+
+    for (int i = 0; i < pulses->num_lines; i++) {
+        uint64_t bit = (uint64_t) 1 << i;
+        struct gpio_line_pulses *line = &pulses->lines[i];
+
+        if (rising & bit) {
+            line->low_ns = line->last_fall >= 0 ? change->timestamp - line->last_fall : -1;
+            line->period_ns = line->last_rise >= 0 ? change->timestamp - line->last_rise : -1;
+            line->last_rise = change->timestamp;
+        }
+
+        if ((falling & bit) && line->last_rise >= 0) {
+            int64_t high_ns = change->timestamp - line->last_rise;
+
+            add_to_range(&line->high, high_ns);
+            if (line->low_ns >= 0) {
+                add_to_range(&line->low, line->low_ns);
+                if (high_ns + line->low_ns > 0)
+                    add_to_range(&line->duty, high_ns * 1000000 / (high_ns + line->low_ns));
+            }
+            if (line->period_ns >= 0)
+                add_to_range(&line->period, line->period_ns);
+
+            if (pulses->each_pulse)
+                send_pulse(env, msg_env, sub, i, change->timestamp, high_ns, line->low_ns, line->period_ns);
+        }
+
+        if (falling & bit)
+            line->last_fall = change->timestamp;
+    }
+}
+
+// Make %{min: min, max: max, mean: mean} or nil if nothing was measured.
+// Values are divided by scale if it's non-zero.
+static ERL_NIF_TERM make_range(ErlNifEnv *env, const struct gpio_range *range, double scale)
+{
+    if (range->count == 0)
+        return enif_make_atom(env, "nil");
+
+    ERL_NIF_TERM map = enif_make_new_map(env);
+    if (scale > 0) {
+        enif_make_map_put(env, map, enif_make_atom(env, "min"), enif_make_double(env, range->min / scale), &map);
+        enif_make_map_put(env, map, enif_make_atom(env, "max"), enif_make_double(env, range->max / scale), &map);
+        enif_make_map_put(env, map, enif_make_atom(env, "mean"), enif_make_double(env, (double) range->sum / range->count / scale), &map);
+    } else {
+        enif_make_map_put(env, map, enif_make_atom(env, "min"), enif_make_int64(env, range->min), &map);
+        enif_make_map_put(env, map, enif_make_atom(env, "max"), enif_make_int64(env, range->max), &map);
+        enif_make_map_put(env, map, enif_make_atom(env, "mean"), enif_make_int64(env, range->sum / (int64_t) range->count), &map);
+    }
+    return map;
+}
+
+static ERL_NIF_TERM make_pulse_summary(ErlNifEnv *env, struct gpio_pulses *pulses)
+{
+    ERL_NIF_TERM lines[GPIO_MAX_LINES];
+    for (int i = 0; i < pulses->num_lines; i++) {
+        const struct gpio_line_pulses *line = &pulses->lines[i];
+
+        ERL_NIF_TERM map = enif_make_new_map(env);
+        enif_make_map_put(env, map, enif_make_atom(env, "count"), enif_make_uint64(env, line->high.count), &map);
+        enif_make_map_put(env, map, enif_make_atom(env, "high_ns"), make_range(env, &line->high, 0), &map);
+        enif_make_map_put(env, map, enif_make_atom(env, "low_ns"), make_range(env, &line->low, 0), &map);
+        enif_make_map_put(env, map, enif_make_atom(env, "period_ns"), make_range(env, &line->period, 0), &map);
+        enif_make_map_put(env, map, enif_make_atom(env, "duty"), make_range(env, &line->duty, 1000000.0), &map);
+        lines[i] = map;
+    }
+
+    ERL_NIF_TERM result = enif_make_new_map(env);
+    enif_make_map_put(env, result, enif_make_atom(env, "lines"), enif_make_list_from_array(env, lines, pulses->num_lines), &result);
+    return result;
+}
+
+// Clear the summary. Edge times are kept so the next pulse is measured.
+static void reset_pulse_summary(struct gpio_pulses *pulses)
+{
+    for (int i = 0; i < pulses->num_lines; i++) {
+        struct gpio_line_pulses *line = &pulses->lines[i];
+        memset(&line->high, 0, sizeof(struct gpio_range));
+        memset(&line->low, 0, sizeof(struct gpio_range));
+        memset(&line->period, 0, sizeof(struct gpio_range));
+        memset(&line->duty, 0, sizeof(struct gpio_range));
+    }
+}
+
+static int64_t pulse_deadline(const struct gpio_sub *sub)
+{
+    const struct gpio_pulses *pulses = sub->state;
+    return pulses->report_ns > 0 ? pulses->last_report + pulses->report_ns : INT64_MAX;
+}
+
+static void pulse_service(ErlNifEnv *env, ErlNifEnv *msg_env, struct gpio_sub *sub, int64_t now)
+{
+    struct gpio_pulses *pulses = sub->state;
+    if (pulses->report_ns <= 0 || pulses->last_report + pulses->report_ns > now)
+        return;
+
+    pulses->last_report = now;
+    send_gpio_event(env, msg_env, sub, enif_make_atom(msg_env, "pulses"), now, make_pulse_summary(msg_env, pulses));
+    reset_pulse_summary(pulses);
+}
+
+static ERL_NIF_TERM pulse_read(ErlNifEnv *env, struct gpio_sub *sub, bool clear)
+{
+    struct gpio_pulses *pulses = sub->state;
+
+    ERL_NIF_TERM result = make_pulse_summary(env, pulses);
+    enif_make_map_put(env, result, atom_timestamp, enif_make_int64(env, hal_timestamp()), &result);
+
+    if (clear)
+        reset_pulse_summary(pulses);
+
+    return result;
+}
+
+static const struct gpio_mode pulse_mode = {
+    .name = "pulse",
+    .state_size = sizeof(struct gpio_pulses),
+    .init = pulse_init,
+    .update = pulse_update,
+    .deadline = pulse_deadline,
+    .service = pulse_service,
+    .read = pulse_read
+};
+
+// Latch mode
+//
+// Remember which lines had edges so that short pulses between reads aren't
+// missed.
+
+static bool latch_init(ErlNifEnv *env, struct gpio_sub *sub, int num_lines, ERL_NIF_TERM options)
+{
+    return true;
+}
+
+static void latch_update(ErlNifEnv *env, ErlNifEnv *msg_env, struct gpio_sub *sub, const struct gpio_change *change)
+{
+    struct gpio_latch *latch = sub->state;
+    latch->rising |= change->rising & sub->line_mask;
+    latch->falling |= change->falling & sub->line_mask;
+}
+
+static ERL_NIF_TERM latch_read(ErlNifEnv *env, struct gpio_sub *sub, bool clear)
+{
+    struct gpio_latch *latch = sub->state;
+
+    ERL_NIF_TERM map = enif_make_new_map(env);
+    enif_make_map_put(env, map, enif_make_atom(env, "rising"), enif_make_uint64(env, latch->rising), &map);
+    enif_make_map_put(env, map, enif_make_atom(env, "falling"), enif_make_uint64(env, latch->falling), &map);
+
+    if (clear)
+        memset(latch, 0, sizeof(struct gpio_latch));
+
+    return map;
+}
+
+const struct gpio_mode gpio_latch_mode = {
+    .name = "latch",
+    .state_size = sizeof(struct gpio_latch),
+    .init = latch_init,
+    .update = latch_update,
+    .read = latch_read
+};
+
+// Capture mode
+//
+// Read a data group on each strobe edge selected by the trigger and send the
+// values in batches. The data is read right after the edge is seen, so it's
+// as close to the strobe as the poller can get without a round trip through
+// Elixir. Each record is the strobe's timestamp and the data group's value as
+// little endian 64-bit integers.
+
+#define CAPTURE_RECORD_SIZE 16
+#define CAPTURE_MAX_BATCH 4096
+
+struct gpio_capture {
+    // The data group. The subscriber holds a reference to it and keeps it
+    // from being closed while reading it.
+    struct gpio_pin *data;
+
+    int batch;
+
+    // When non-zero, send partial batches this long after their first record
+    int64_t flush_ns;
+
+    // Records waiting to be sent
+    uint8_t *records;
+    int count;
+    int64_t first_timestamp;
+
+    // Strobe edges where the data couldn't be read
+    uint64_t errors;
+};
+
+static bool capture_init(ErlNifEnv *env, struct gpio_sub *sub, int num_lines, ERL_NIF_TERM options)
+{
+    struct gpio_capture *capture = sub->state;
+    struct gpio_pin *data;
+    ERL_NIF_TERM value;
+
+    if (!enif_get_map_value(env, options, enif_make_atom(env, "data"), &value) ||
+            !get_gpio_pin(env, value, &data))
+        return false;
+
+    enif_keep_resource(data);
+    capture->data = data;
+    capture->batch = 64;
+    capture->flush_ns = 10000000;
+
+    if (enif_get_map_value(env, options, enif_make_atom(env, "batch"), &value) &&
+            (!enif_get_int(env, value, &capture->batch) ||
+             capture->batch < 1 || capture->batch > CAPTURE_MAX_BATCH))
+        return false;
+
+    if (!get_option_ms(env, options, "flush_ms", &capture->flush_ns))
+        return false;
+
+    capture->records = enif_alloc(capture->batch * CAPTURE_RECORD_SIZE);
+    return capture->records != NULL;
+}
+
+static void capture_dtor(struct gpio_sub *sub)
+{
+    struct gpio_capture *capture = sub->state;
+
+    if (capture->data)
+        enif_release_resource(capture->data);
+    if (capture->records)
+        enif_free(capture->records);
+}
+
+static void put_le64(uint8_t *p, uint64_t value)
+{
+    for (int i = 0; i < 8; i++)
+        p[i] = (uint8_t) (value >> (8 * i));
+}
+
+static ERL_NIF_TERM take_capture_records(ErlNifEnv *env, struct gpio_capture *capture)
+{
+    ERL_NIF_TERM data;
+    size_t len = (size_t) capture->count * CAPTURE_RECORD_SIZE;
+    memcpy(enif_make_new_binary(env, len, &data), capture->records, len);
+    capture->count = 0;
+    return data;
+}
+
+static void send_capture(ErlNifEnv *env, ErlNifEnv *msg_env, struct gpio_sub *sub)
+{
+    struct gpio_capture *capture = sub->state;
+    int64_t timestamp = capture->first_timestamp;
+
+    ERL_NIF_TERM map = enif_make_new_map(msg_env);
+    enif_make_map_put(msg_env, map, enif_make_atom(msg_env, "data"), take_capture_records(msg_env, capture), &map);
+    send_gpio_event(env, msg_env, sub, enif_make_atom(msg_env, "capture"), timestamp, map);
+}
+
+static void capture_update(ErlNifEnv *env, ErlNifEnv *msg_env, struct gpio_sub *sub, const struct gpio_change *change)
+{
+    struct gpio_capture *capture = sub->state;
+
+    uint64_t edges;
+    switch (sub->emit_trigger) {
+    case TRIGGER_RISING: edges = change->rising; break;
+    case TRIGGER_FALLING: edges = change->falling; break;
+    case TRIGGER_BOTH: edges = change->rising | change->falling; break;
+    default: edges = 0; break;
+    }
+    if ((edges & sub->line_mask) == 0)
+        return;
+
+    // The data handle can be closed by its owner at any time
+    uint64_t value;
+    if (!keep_gpio_fd(capture->data)) {
+        capture->errors++;
+        return;
+    }
+    int rc = hal_read_gpio(capture->data, &value);
+    release_gpio_fd(capture->data);
+    if (rc < 0) {
+        capture->errors++;
+        return;
+    }
+
+    if (capture->count == 0)
+        capture->first_timestamp = change->timestamp;
+
+    uint8_t *record = capture->records + capture->count * CAPTURE_RECORD_SIZE;
+    put_le64(record, (uint64_t) change->timestamp);
+    put_le64(record + 8, value);
+    capture->count++;
+
+    if (capture->count == capture->batch)
+        send_capture(env, msg_env, sub);
+}
+
+static int64_t capture_deadline(const struct gpio_sub *sub)
+{
+    const struct gpio_capture *capture = sub->state;
+    return (capture->count > 0 && capture->flush_ns > 0) ? capture->first_timestamp + capture->flush_ns : INT64_MAX;
+}
+
+static void capture_service(ErlNifEnv *env, ErlNifEnv *msg_env, struct gpio_sub *sub, int64_t now)
+{
+    if (capture_deadline(sub) <= now)
+        send_capture(env, msg_env, sub);
+}
+
+static ERL_NIF_TERM capture_read(ErlNifEnv *env, struct gpio_sub *sub, bool clear)
+{
+    struct gpio_capture *capture = sub->state;
+
+    // Reading always takes the records so that they're only returned once
+    ERL_NIF_TERM map = enif_make_new_map(env);
+    enif_make_map_put(env, map, enif_make_atom(env, "data"), take_capture_records(env, capture), &map);
+    enif_make_map_put(env, map, enif_make_atom(env, "errors"), enif_make_uint64(env, capture->errors), &map);
+
+    if (clear)
+        capture->errors = 0;
+
+    return map;
+}
+
+static const struct gpio_mode capture_mode = {
+    .name = "capture",
+    .state_size = sizeof(struct gpio_capture),
+    .init = capture_init,
+    .update = capture_update,
+    .deadline = capture_deadline,
+    .service = capture_service,
+    .read = capture_read,
+    .dtor = capture_dtor
+};
+
+static const struct gpio_mode *const gpio_modes[] = {
+    &encoder_mode,
+    &counter_mode,
+    &pulse_mode,
+    &gpio_latch_mode,
+    &capture_mode,
+    &gpio_wiegand_mode,
+    &gpio_nec_mode,
+    &gpio_dht_mode
+};
+
+const struct gpio_mode *find_gpio_mode(ErlNifEnv *env, ERL_NIF_TERM name)
+{
+    char buffer[16];
+    if (!enif_get_atom(env, name, buffer, sizeof(buffer), ERL_NIF_LATIN1))
+        return NULL;
+
+    for (size_t i = 0; i < sizeof(gpio_modes) / sizeof(gpio_modes[0]); i++) {
+        if (strcmp(gpio_modes[i]->name, buffer) == 0)
+            return gpio_modes[i];
+    }
+    return NULL;
+}
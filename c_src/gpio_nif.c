@@ -9,6 +9,8 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <sched.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
@@ -28,14 +30,92 @@ ERL_NIF_TERM atom_ref;
 ERL_NIF_TERM atom_timestamp;
 ERL_NIF_TERM atom_value;
 ERL_NIF_TERM atom_previous_value;
+ERL_NIF_TERM atom_changed;
+ERL_NIF_TERM atom_event;
+ERL_NIF_TERM atom_source;
+ERL_NIF_TERM atom_position;
 
 #ifdef DEBUG
 FILE *log_location = NULL;
 #endif
 
+static int remove_gpio_subs(ErlNifEnv *env, struct gpio_pin *pin, ERL_NIF_TERM notify_id);
+
+// Bit i of the result is bit bits[i] of value
+static uint64_t gather_bits(const uint8_t *bits, int num_bits, uint64_t value)
+{
+    uint64_t result = 0;
+    for (int i = 0; i < num_bits; i++)
+        result |= ((value >> bits[i]) & 1) << i;
+    return result;
+}
+
+// Bit bits[i] of the result is bit i of value
+static uint64_t scatter_bits(const uint8_t *bits, int num_bits, uint64_t value)
+{
+    uint64_t result = 0;
+    for (int i = 0; i < num_bits; i++)
+        result |= ((value >> i) & 1) << bits[i];
+    return result;
+}
+
+// The handle that owns the line request. That's where subscribers are kept.
+struct gpio_pin *line_request(struct gpio_pin *pin)
+{
+    return pin->parent ? pin->parent : pin;
+}
+
+bool keep_gpio_fd(struct gpio_pin *pin)
+{
+    struct gpio_pin *request = line_request(pin);
+
+    atomic_fetch_add(&request->fd_users, 1);
+    if (atomic_load(&request->closing) || pin->fd < 0) {
+        atomic_fetch_sub(&request->fd_users, 1);
+        return false;
+    }
+    return true;
+}
+
+void release_gpio_fd(struct gpio_pin *pin)
+{
+    atomic_fetch_sub(&line_request(pin)->fd_users, 1);
+}
+
+// Stop new keep_gpio_fd users and wait for the current ones to finish so
+// that the fd can't be closed and reused out from under them
+static void wait_for_gpio_fd_users(struct gpio_pin *pin)
+{
+    atomic_store(&pin->closing, true);
+    while (atomic_load(&pin->fd_users) > 0)
+        sched_yield();
+}
+
+static void release_gpio_subs(struct gpio_sub *const *subs, int num_subs)
+{
+    for (int i = 0; i < num_subs; i++)
+        enif_release_resource(subs[i]);
+}
+
 static void release_gpio_pin(struct gpio_priv *priv, struct gpio_pin *pin)
 {
-    hal_close_gpio(pin);
+    if (pin->parent) {
+        // Sub-handles only need their subscribers removed from the parent
+        if (pin->fd >= 0) {
+            pin->fd = -1;
+            remove_gpio_subs(NULL, pin, 0);
+        }
+    } else {
+        wait_for_gpio_fd_users(pin);
+        if (pin->lock)
+            enif_mutex_lock(pin->lock);
+        hal_close_gpio(pin);
+        release_gpio_subs(pin->subs, pin->num_subs);
+        pin->num_subs = 0;
+        if (pin->lock)
+            enif_mutex_unlock(pin->lock);
+    }
+
     if (pin->env) {
         enif_free_env(pin->env);
         pin->env = NULL;
@@ -71,19 +151,6 @@ static void unregister_gpio_pin(struct gpio_priv *priv, struct gpio_pin *pin)
     enif_mutex_unlock(priv->gpio_pins_lock);
 }
 
-// Reset the pin's environment to hold exactly the terms it needs. Without this,
-// repeated subscribe calls would accumulate copies in pin->env and grow it
-// without bound.
-static void set_pin_terms(struct gpio_pin *pin,
-                          ERL_NIF_TERM gpio_spec,
-                          bool notify_map,
-                          ERL_NIF_TERM notify_id)
-{
-    enif_clear_env(pin->env);
-    pin->gpio_spec = enif_make_copy(pin->env, gpio_spec);
-    pin->notify_id = notify_map ? enif_make_copy(pin->env, notify_id) : 0;
-}
-
 static void gpio_pin_dtor(ErlNifEnv *env, void *obj)
 {
     struct gpio_priv *priv = enif_priv_data(env);
@@ -93,6 +160,16 @@ static void gpio_pin_dtor(ErlNifEnv *env, void *obj)
 
     unregister_gpio_pin(priv, pin);
     release_gpio_pin(priv, pin);
+
+    if (pin->parent) {
+        enif_release_resource(pin->parent);
+        pin->parent = NULL;
+    }
+
+    if (pin->lock) {
+        enif_mutex_destroy(pin->lock);
+        pin->lock = NULL;
+    }
 }
 
 static void gpio_pin_stop(ErlNifEnv *env, void *obj, int fd, int is_direct_call)
@@ -120,6 +197,56 @@ static void gpio_pin_down(ErlNifEnv *env, void *obj, ErlNifPid *pid, ErlNifMonit
 #endif
 }
 
+static void gpio_sub_dtor(ErlNifEnv *env, void *obj)
+{
+    (void) env;
+    struct gpio_sub *sub = (struct gpio_sub *) obj;
+
+    if (sub->env) {
+        enif_free_env(sub->env);
+        sub->env = NULL;
+    }
+
+    if (sub->merge) {
+        atomic_fetch_sub(&sub->merge->num_sources, 1);
+        enif_release_resource(sub->merge);
+        sub->merge = NULL;
+    }
+
+    if (sub->lock) {
+        enif_mutex_destroy(sub->lock);
+        sub->lock = NULL;
+    }
+
+    if (sub->state) {
+        if (sub->mode && sub->mode->dtor)
+            sub->mode->dtor(sub);
+        enif_free(sub->state);
+        sub->state = NULL;
+    }
+
+    if (sub->debounce_edges) {
+        enif_free(sub->debounce_edges);
+        sub->debounce_edges = NULL;
+    }
+
+    if (sub->reflex.output) {
+        enif_release_resource(sub->reflex.output);
+        sub->reflex.output = NULL;
+    }
+}
+
+static void gpio_merge_dtor(ErlNifEnv *env, void *obj)
+{
+    (void) env;
+    struct gpio_merge *merge = (struct gpio_merge *) obj;
+
+    if (merge->env) {
+        enif_free_env(merge->env);
+        merge->env = NULL;
+    }
+}
+
 #if (ERL_NIF_MAJOR_VERSION == 2 && ERL_NIF_MINOR_VERSION >= 16)
 // OTP-24 and later
 static ErlNifResourceTypeInit gpio_pin_init = {gpio_pin_dtor, gpio_pin_stop, gpio_pin_down, 3, NULL};
@@ -135,8 +262,8 @@ int send_gpio_message(ErlNifEnv *env,
                       int64_t timestamp,
                       int value)
 {
-    // gpio_spec lives in the pin's environment, so it has to be copied to
-    // msg_env before it can be used in a term created there.
+    // gpio_spec lives in the subscriber's environment, so it has to be copied
+    // to msg_env before it can be used in a term created there.
     ERL_NIF_TERM msg = enif_make_tuple4(msg_env,
                                         atom_circuits_gpio,
                                         enif_make_copy(msg_env, gpio_spec),
@@ -156,17 +283,21 @@ int send_gpio_change(ErlNifEnv *env,
                      ErlNifEnv *msg_env,
                      ERL_NIF_TERM notify_id,
                      ErlNifPid *pid,
-                     int64_t timestamp,
-                     uint64_t value,
-                     uint64_t previous_value)
+                     const struct gpio_change *change,
+                     bool merged,
+                     int source)
 {
-    // notify_id lives in the pin's environment, so it has to be copied to
-    // msg_env before it can be used in a term created there.
+    // notify_id lives in the subscriber's environment, so it has to be copied
+    // to msg_env before it can be used in a term created there.
     ERL_NIF_TERM map = enif_make_new_map(msg_env);
     enif_make_map_put(msg_env, map, atom_ref, enif_make_copy(msg_env, notify_id), &map);
-    enif_make_map_put(msg_env, map, atom_timestamp, enif_make_int64(msg_env, timestamp), &map);
-    enif_make_map_put(msg_env, map, atom_value, enif_make_uint64(msg_env, value), &map);
-    enif_make_map_put(msg_env, map, atom_previous_value, enif_make_uint64(msg_env, previous_value), &map);
+    enif_make_map_put(msg_env, map, atom_timestamp, enif_make_int64(msg_env, change->timestamp), &map);
+    enif_make_map_put(msg_env, map, atom_value, enif_make_uint64(msg_env, change->value), &map);
+    enif_make_map_put(msg_env, map, atom_previous_value, enif_make_uint64(msg_env, change->previous_value), &map);
+    if (merged)
+        enif_make_map_put(msg_env, map, atom_changed, enif_make_uint64(msg_env, change->rising | change->falling), &map);
+    if (source >= 0)
+        enif_make_map_put(msg_env, map, atom_source, enif_make_int(msg_env, source), &map);
 
     ERL_NIF_TERM msg = enif_make_tuple2(msg_env, atom_circuits_gpio, map);
 
@@ -177,44 +308,497 @@ int send_gpio_change(ErlNifEnv *env,
     return rc;
 }
 
-bool emit_gpio_change(ErlNifEnv *env,
-                      ErlNifEnv *msg_env,
-                      bool notify_map,
-                      ERL_NIF_TERM notify_term,
-                      ErlNifPid *pid,
-                      enum trigger_mode emit_trigger,
-                      int64_t timestamp,
-                      uint64_t new_value,
-                      uint64_t previous_value,
-                      int changed_bit)
+int send_gpio_event(ErlNifEnv *env,
+                    ErlNifEnv *msg_env,
+                    struct gpio_sub *sub,
+                    ERL_NIF_TERM event,
+                    int64_t timestamp,
+                    ERL_NIF_TERM map)
 {
-    int new_bit = (int) ((new_value >> changed_bit) & 1);
-    bool rising = new_bit != 0;
+    enif_make_map_put(msg_env, map, atom_ref, enif_make_copy(msg_env, sub->notify_term), &map);
+    enif_make_map_put(msg_env, map, atom_event, event, &map);
+    enif_make_map_put(msg_env, map, atom_timestamp, enif_make_int64(msg_env, timestamp), &map);
+    if (sub->source >= 0)
+        enif_make_map_put(msg_env, map, atom_source, enif_make_int(msg_env, sub->source), &map);
 
-    bool want;
-    switch (emit_trigger) {
+    ERL_NIF_TERM msg = enif_make_tuple2(msg_env, atom_circuits_gpio, map);
+
+    ErlNifPid pid = atomic_load(&sub->pid);
+    int rc = enif_send(env, &pid, msg_env, msg);
+
+    enif_clear_env(msg_env);
+
+    if (!rc)
+        sub->dead = true;
+
+    return rc;
+}
+
+static int send_gpio_timeout(ErlNifEnv *env,
+                             ErlNifEnv *msg_env,
+                             struct gpio_sub *sub,
+                             int64_t timestamp)
+{
+    ERL_NIF_TERM map = enif_make_new_map(msg_env);
+    enif_make_map_put(msg_env, map, atom_value, enif_make_uint64(msg_env, sub->last_value), &map);
+
+    return send_gpio_event(env, msg_env, sub, enif_make_atom(msg_env, "timeout"), timestamp, map);
+}
+
+static bool sub_wants(const struct gpio_sub *sub, const struct gpio_change *change)
+{
+    uint64_t rising = change->rising & sub->line_mask;
+    uint64_t falling = change->falling & sub->line_mask;
+
+    if (sub->has_match) {
+        if ((rising | falling) == 0)
+            return false;
+
+        bool was_matching = (change->previous_value & sub->match_mask) == sub->match_pattern;
+        bool is_matching = (change->value & sub->match_mask) == sub->match_pattern;
+        if (was_matching == is_matching)
+            return false;
+
+        // Entering the pattern is treated like a rising edge and leaving it
+        // like a falling one.
+        rising = is_matching;
+        falling = was_matching;
+    }
+
+    switch (sub->emit_trigger) {
     case TRIGGER_BOTH:
-        want = true;
-        break;
+        return (rising | falling) != 0;
     case TRIGGER_RISING:
-        want = rising;
-        break;
+        return rising != 0;
     case TRIGGER_FALLING:
-        want = !rising;
-        break;
+        return falling != 0;
     case TRIGGER_NONE:
     default:
-        want = false;
-        break;
+        return false;
     }
+}
 
-    if (!want)
-        return true;
+static bool send_merge_entry(ErlNifEnv *env,
+                             ErlNifEnv *msg_env,
+                             struct gpio_merge *merge,
+                             const struct gpio_merge_entry *entry)
+{
+    ErlNifPid pid = atomic_load(&merge->pid);
+    if (!send_gpio_change(env, msg_env, merge->notify_term, &pid, &entry->change, entry->merged, entry->source))
+        merge->dead = true;
+    return !merge->dead;
+}
 
-    if (notify_map)
-        return send_gpio_change(env, msg_env, notify_term, pid, timestamp, new_value, previous_value);
+// Send the changes in the reorder buffer that have waited long enough
+static void flush_merge(ErlNifEnv *env, ErlNifEnv *msg_env, struct gpio_merge *merge, int64_t now)
+{
+    int sent = 0;
+    while (sent < merge->count &&
+            !merge->dead &&
+            merge->entries[sent].change.timestamp + merge->reorder_ns <= now) {
+        send_merge_entry(env, msg_env, merge, &merge->entries[sent]);
+        sent++;
+    }
+
+    if (merge->dead)
+        sent = merge->count;
+
+    merge->count -= sent;
+    memmove(&merge->entries[0], &merge->entries[sent], merge->count * sizeof(struct gpio_merge_entry));
+}
+
+static void add_to_merge(ErlNifEnv *env,
+                         ErlNifEnv *msg_env,
+                         struct gpio_merge *merge,
+                         const struct gpio_change *change,
+                         bool merged,
+                         int source)
+{
+    struct gpio_merge_entry entry;
+    entry.change = *change;
+    entry.merged = merged;
+    entry.source = source;
+
+    if (merge->reorder_ns <= 0) {
+        send_merge_entry(env, msg_env, merge, &entry);
+        return;
+    }
+
+    // Make room by sending the oldest change early
+    if (merge->count == GPIO_MERGE_BUFFER_LEN)
+        flush_merge(env, msg_env, merge, merge->entries[0].change.timestamp + merge->reorder_ns);
+
+    // Insertion sort from the end since changes almost always arrive in order
+    int i = merge->count;
+    while (i > 0 && merge->entries[i - 1].change.timestamp > change->timestamp) {
+        merge->entries[i] = merge->entries[i - 1];
+        i--;
+    }
+    merge->entries[i] = entry;
+    merge->count++;
+}
+
+static void notify_sub(ErlNifEnv *env,
+                       ErlNifEnv *msg_env,
+                       struct gpio_sub *sub,
+                       const struct gpio_change *change,
+                       bool merged)
+{
+    if (!sub_wants(sub, change))
+        return;
+
+    if (sub->merge) {
+        add_to_merge(env, msg_env, sub->merge, change, merged, sub->source);
+        if (sub->merge->dead)
+            sub->dead = true;
+        return;
+    }
+
+    bool ok;
+    ErlNifPid pid = atomic_load(&sub->pid);
+    if (sub->notify_map)
+        ok = send_gpio_change(env, msg_env, sub->notify_term, &pid, change, merged, sub->source);
     else
-        return send_gpio_message(env, msg_env, notify_term, pid, timestamp, new_bit);
+        ok = send_gpio_message(env, msg_env, sub->notify_term, &pid, change->timestamp, (int) (change->value & 1));
+
+    // enif_send only fails when the receiver has exited. It's not coming back,
+    // so stop trying.
+    if (!ok)
+        sub->dead = true;
+}
+
+// Reflexes don't need the receiver, so they keep running after it exits
+static bool sub_running(const struct gpio_sub *sub)
+{
+    return !sub->dead || sub->reflex.rule != REFLEX_NONE;
+}
+
+static bool reflex_input_active(const struct gpio_sub *sub, uint64_t value)
+{
+    if (sub->has_match)
+        return (value & sub->match_mask) == sub->match_pattern;
+    else
+        return (value & sub->line_mask) != 0;
+}
+
+static void drive_reflex(ErlNifEnv *env, const struct gpio_reflex *reflex, bool high)
+{
+    // There's nobody to tell if this fails. The output handle was probably
+    // closed. Its owner can close it at any time, so keep it open while
+    // writing.
+    if (!keep_gpio_fd(reflex->output))
+        return;
+
+    hal_write_gpio_masked(reflex->output, reflex->output_mask, high ? reflex->output_mask : 0, env);
+    release_gpio_fd(reflex->output);
+}
+
+// Drive a subscriber's reflex output when its input becomes active or
+// inactive. This runs before the subscriber is notified so that sending the
+// message doesn't delay the output.
+static void run_reflex(ErlNifEnv *env, struct gpio_sub *sub, const struct gpio_change *change)
+{
+    struct gpio_reflex *reflex = &sub->reflex;
+    bool active = reflex_input_active(sub, change->value);
+    if (active == reflex->active)
+        return;
+
+    reflex->active = active;
+    switch (reflex->rule) {
+    case REFLEX_MIRROR:
+        drive_reflex(env, reflex, active);
+        break;
+    case REFLEX_INVERT:
+        drive_reflex(env, reflex, !active);
+        break;
+    case REFLEX_SET_ON_RISING:
+    case REFLEX_CLEAR_ON_RISING:
+        if (active)
+            drive_reflex(env, reflex, reflex->rule == REFLEX_SET_ON_RISING);
+        break;
+    case REFLEX_SET_ON_FALLING:
+    case REFLEX_CLEAR_ON_FALLING:
+        if (!active)
+            drive_reflex(env, reflex, reflex->rule == REFLEX_SET_ON_FALLING);
+        break;
+    case REFLEX_PULSE:
+        // Pulses are timed from the edge and another edge restarts them
+        if (active) {
+            drive_reflex(env, reflex, true);
+            reflex->pulse_end = change->timestamp + reflex->pulse_ns;
+            if (reflex->pulse_end == 0)
+                reflex->pulse_end = 1;
+        }
+        break;
+    case REFLEX_NONE:
+    default:
+        break;
+    }
+}
+
+// Set the output for the input's current value when the reflex is added
+static void start_reflex(ErlNifEnv *env, struct gpio_sub *sub, uint64_t value)
+{
+    struct gpio_reflex *reflex = &sub->reflex;
+    reflex->active = reflex_input_active(sub, value);
+
+    if (reflex->rule == REFLEX_MIRROR)
+        drive_reflex(env, reflex, reflex->active);
+    else if (reflex->rule == REFLEX_INVERT)
+        drive_reflex(env, reflex, !reflex->active);
+}
+
+static void flush_settled(ErlNifEnv *env, ErlNifEnv *msg_env, struct gpio_sub *sub)
+{
+    sub->settle_pending = false;
+    notify_sub(env, msg_env, sub, &sub->pending, true);
+}
+
+// Send a change or hold on to it for the settle window or a mode
+static void deliver_gpio_change(ErlNifEnv *env,
+                                ErlNifEnv *msg_env,
+                                struct gpio_sub *sub,
+                                const struct gpio_change *change)
+{
+    if (sub->reflex.rule != REFLEX_NONE) {
+        run_reflex(env, sub, change);
+        if (sub->dead)
+            return;
+    }
+
+    if (sub->mode) {
+        enif_mutex_lock(sub->lock);
+        sub->mode->update(env, msg_env, sub, change);
+        enif_mutex_unlock(sub->lock);
+        return;
+    }
+
+    if (sub->settle_ns <= 0) {
+        notify_sub(env, msg_env, sub, change, false);
+        return;
+    }
+
+    // The window is fixed from its first edge so that a line that never stops
+    // toggling can't hold back notifications forever.
+    if (sub->settle_pending && change->timestamp - sub->settle_start > sub->settle_ns)
+        flush_settled(env, msg_env, sub);
+
+    if (sub->settle_pending) {
+        sub->pending.timestamp = change->timestamp;
+        sub->pending.seqno = change->seqno;
+        sub->pending.value = change->value;
+        sub->pending.rising |= change->rising;
+        sub->pending.falling |= change->falling;
+    } else if ((change->rising | change->falling) & sub->line_mask) {
+        sub->settle_pending = true;
+        sub->settle_start = change->timestamp;
+        sub->pending = *change;
+    }
+}
+
+// Convert a change to the line request into what a sub-handle's subscriber
+// sees. Returns false if none of its lines changed.
+static bool view_gpio_change(const struct gpio_sub *sub, const struct gpio_change *change, struct gpio_change *view)
+{
+    view->timestamp = change->timestamp;
+    view->seqno = change->seqno;
+    view->value = gather_bits(sub->view_bits, sub->num_view_lines, change->value);
+    view->previous_value = gather_bits(sub->view_bits, sub->num_view_lines, change->previous_value);
+    view->rising = gather_bits(sub->view_bits, sub->num_view_lines, change->rising);
+    view->falling = gather_bits(sub->view_bits, sub->num_view_lines, change->falling);
+    return (view->rising | view->falling) != 0;
+}
+
+static void emit_gpio_change(ErlNifEnv *env,
+                             ErlNifEnv *msg_env,
+                             struct gpio_sub *sub,
+                             const struct gpio_change *change)
+{
+    if (!sub_running(sub))
+        return;
+
+    struct gpio_change view;
+    if (sub->num_view_lines > 0) {
+        if (!view_gpio_change(sub, change, &view))
+            return;
+        change = &view;
+    }
+
+    sub->last_value = change->value;
+
+    uint64_t edges = (change->rising | change->falling) & sub->line_mask;
+    if (edges) {
+        sub->last_activity = change->timestamp;
+        sub->timed_out = false;
+    }
+
+    if (sub->debounce_ns <= 0) {
+        deliver_gpio_change(env, msg_env, sub, change);
+        return;
+    }
+
+    // Every edge restarts its line's debounce time
+    sub->debounce_pending |= edges;
+    while (edges) {
+        int line = __builtin_ctzll(edges);
+        sub->debounce_edges[line] = change->timestamp;
+        edges &= edges - 1;
+    }
+}
+
+// Report lines that have been stable long enough. Their values come from the
+// hardware when it's available so that a missed edge can't leave a line stuck.
+static void flush_debounced(ErlNifEnv *env,
+                            ErlNifEnv *msg_env,
+                            struct gpio_sub *sub,
+                            int64_t now,
+                            const uint64_t *value)
+{
+    uint64_t stable = 0;
+    for (uint64_t pending = sub->debounce_pending; pending; pending &= pending - 1) {
+        int line = __builtin_ctzll(pending);
+        if (sub->debounce_edges[line] + sub->debounce_ns <= now)
+            stable |= (uint64_t) 1 << line;
+    }
+    if (stable == 0)
+        return;
+
+    sub->debounce_pending &= ~stable;
+
+    uint64_t current = value ? *value : sub->last_value;
+    uint64_t debounced = (sub->debounced & ~stable) | (current & stable);
+    uint64_t changed = debounced ^ sub->debounced;
+    if (changed == 0)
+        return;
+
+    // Lines that bounced back to where they started aren't reported
+    struct gpio_change change;
+    memset(&change, 0, sizeof(change));
+    for (uint64_t bits = changed; bits; bits &= bits - 1) {
+        int line = __builtin_ctzll(bits);
+        if (sub->debounce_edges[line] > change.timestamp)
+            change.timestamp = sub->debounce_edges[line];
+    }
+    change.previous_value = (sub->last_value & ~sub->line_mask) | sub->debounced;
+    change.value = (sub->last_value & ~sub->line_mask) | debounced;
+    change.rising = changed & debounced;
+    change.falling = changed & ~debounced;
+
+    sub->debounced = debounced;
+    deliver_gpio_change(env, msg_env, sub, &change);
+}
+
+bool dispatch_gpio_change(ErlNifEnv *env,
+                          ErlNifEnv *msg_env,
+                          struct gpio_sub *const *subs,
+                          int num_subs,
+                          const struct gpio_change *change)
+{
+    bool alive = false;
+    for (int i = 0; i < num_subs; i++) {
+        emit_gpio_change(env, msg_env, subs[i], change);
+        if (sub_running(subs[i]))
+            alive = true;
+    }
+    return alive;
+}
+
+static int64_t sub_deadline(const struct gpio_sub *sub)
+{
+    int64_t deadline = INT64_MAX;
+    if (!sub_running(sub))
+        return deadline;
+
+    if (sub->reflex.pulse_end)
+        deadline = sub->reflex.pulse_end;
+
+    if (sub->settle_pending && sub->settle_start + sub->settle_ns < deadline)
+        deadline = sub->settle_start + sub->settle_ns;
+
+    for (uint64_t pending = sub->debounce_pending; pending; pending &= pending - 1) {
+        int line = __builtin_ctzll(pending);
+        if (sub->debounce_edges[line] + sub->debounce_ns < deadline)
+            deadline = sub->debounce_edges[line] + sub->debounce_ns;
+    }
+
+    if (sub->timeout_ns > 0 && !sub->timed_out && !sub->dead && sub->last_activity + sub->timeout_ns < deadline)
+        deadline = sub->last_activity + sub->timeout_ns;
+
+    struct gpio_merge *merge = sub->merge;
+    if (merge && merge->count > 0 && merge->entries[0].change.timestamp + merge->reorder_ns < deadline)
+        deadline = merge->entries[0].change.timestamp + merge->reorder_ns;
+
+    if (sub->mode && sub->mode->deadline) {
+        enif_mutex_lock(sub->lock);
+        int64_t mode_deadline = sub->mode->deadline(sub);
+        enif_mutex_unlock(sub->lock);
+        if (mode_deadline < deadline)
+            deadline = mode_deadline;
+    }
+
+    return deadline;
+}
+
+void service_gpio_subs(ErlNifEnv *env,
+                       ErlNifEnv *msg_env,
+                       struct gpio_sub *const *subs,
+                       int num_subs,
+                       int64_t now,
+                       const uint64_t *value)
+{
+    for (int i = 0; i < num_subs; i++) {
+        struct gpio_sub *sub = subs[i];
+        if (!sub_running(sub))
+            continue;
+
+        if (sub->reflex.pulse_end && sub->reflex.pulse_end <= now) {
+            sub->reflex.pulse_end = 0;
+            drive_reflex(env, &sub->reflex, false);
+        }
+
+        if (sub->debounce_pending) {
+            uint64_t view_value;
+            const uint64_t *sub_value = value;
+            if (value && sub->num_view_lines > 0) {
+                view_value = gather_bits(sub->view_bits, sub->num_view_lines, *value);
+                sub_value = &view_value;
+            }
+            flush_debounced(env, msg_env, sub, now, sub_value);
+        }
+
+        if (sub->settle_pending && sub->settle_start + sub->settle_ns <= now)
+            flush_settled(env, msg_env, sub);
+
+        // Timeouts are sent once per quiet period. The next edge re-arms them.
+        if (sub->timeout_ns > 0 && !sub->timed_out && !sub->dead && sub->last_activity + sub->timeout_ns <= now) {
+            sub->timed_out = true;
+            if (!send_gpio_timeout(env, msg_env, sub, now))
+                sub->dead = true;
+        }
+
+        if (sub->merge) {
+            flush_merge(env, msg_env, sub->merge, now);
+            if (sub->merge->dead)
+                sub->dead = true;
+        }
+
+        if (sub->mode && sub->mode->service && !sub->dead) {
+            enif_mutex_lock(sub->lock);
+            sub->mode->service(env, msg_env, sub, now);
+            enif_mutex_unlock(sub->lock);
+        }
+    }
+}
+
+int64_t gpio_subs_deadline(struct gpio_sub *const *subs, int num_subs)
+{
+    int64_t deadline = INT64_MAX;
+    for (int i = 0; i < num_subs; i++) {
+        int64_t d = sub_deadline(subs[i]);
+        if (d < deadline)
+            deadline = d;
+    }
+    return deadline;
 }
 
 static int load(ErlNifEnv *env, void **priv_data, ERL_NIF_TERM info)
@@ -239,6 +823,10 @@ static int load(ErlNifEnv *env, void **priv_data, ERL_NIF_TERM info)
     atom_timestamp = enif_make_atom(env, "timestamp");
     atom_value = enif_make_atom(env, "value");
     atom_previous_value = enif_make_atom(env, "previous_value");
+    atom_changed = enif_make_atom(env, "changed");
+    atom_event = enif_make_atom(env, "event");
+    atom_source = enif_make_atom(env, "source");
+    atom_position = enif_make_atom(env, "position");
 
     size_t extra_size = hal_priv_size();
     struct gpio_priv *priv = enif_alloc(sizeof(struct gpio_priv) + extra_size);
@@ -248,6 +836,10 @@ static int load(ErlNifEnv *env, void **priv_data, ERL_NIF_TERM info)
     }
 
     priv->gpio_pin_rt = enif_open_resource_type_x(env, "gpio_pin", &gpio_pin_init, ERL_NIF_RT_CREATE, NULL);
+    priv->gpio_sub_rt = enif_open_resource_type(env, NULL, "gpio_sub", gpio_sub_dtor, ERL_NIF_RT_CREATE, NULL);
+    priv->gpio_merge_rt = enif_open_resource_type(env, NULL, "gpio_merge", gpio_merge_dtor, ERL_NIF_RT_CREATE, NULL);
+    priv->gpio_task_rt = enif_open_resource_type(env, NULL, "gpio_task", gpio_task_dtor, ERL_NIF_RT_CREATE, NULL);
+    priv->gpio_analyzer_rt = enif_open_resource_type(env, NULL, "gpio_analyzer", gpio_analyzer_dtor, ERL_NIF_RT_CREATE, NULL);
     priv->gpio_pins_lock = enif_mutex_create("gpio_pins");
     priv->gpio_pins = NULL;
 
@@ -264,6 +856,8 @@ static int load(ErlNifEnv *env, void **priv_data, ERL_NIF_TERM info)
         return 1;
     }
 
+    init_gpio_api(priv);
+
     *priv_data = (void *) priv;
     return 0;
 }
@@ -280,6 +874,41 @@ static void unload(ErlNifEnv *env, void *priv_data)
     enif_free(priv);
 }
 
+bool get_gpio_pin(ErlNifEnv *env, ERL_NIF_TERM term, struct gpio_pin **pin)
+{
+    struct gpio_priv *priv = enif_priv_data(env);
+    return enif_get_resource(env, term, priv->gpio_pin_rt, (void**) pin);
+}
+
+int read_sub_handle(struct gpio_pin *pin, uint64_t *value)
+{
+    // The parent's owner can close it while this process is using it
+    if (!keep_gpio_fd(pin))
+        return -EBADF;
+
+    uint64_t parent_value;
+    int rc = hal_read_gpio(pin->parent, &parent_value);
+    release_gpio_fd(pin);
+    if (rc < 0)
+        return rc;
+
+    *value = gather_bits(pin->parent_bits, pin->num_lines, parent_value);
+    return 0;
+}
+
+int write_sub_handle(struct gpio_pin *pin, uint64_t mask, uint64_t value, ErlNifEnv *env)
+{
+    if (!keep_gpio_fd(pin))
+        return -EBADF;
+
+    int rc = hal_write_gpio_masked(pin->parent,
+                                   scatter_bits(pin->parent_bits, pin->num_lines, mask),
+                                   scatter_bits(pin->parent_bits, pin->num_lines, value),
+                                   env);
+    release_gpio_fd(pin);
+    return rc;
+}
+
 static ERL_NIF_TERM read_gpio(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 {
     struct gpio_priv *priv = enif_priv_data(env);
@@ -306,7 +935,7 @@ static ERL_NIF_TERM write_gpio(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv
             !enif_get_uint64(env, argv[1], &value))
         return enif_make_badarg(env);
 
-    if (!pin->config.is_output)
+    if (!line_request(pin)->config.is_output)
         return enif_raise_exception(env, enif_make_atom(env, "pin_not_output"));
 
     int rc = hal_write_gpio(pin, value, env);
@@ -439,6 +1068,397 @@ static int get_drive_mode(ErlNifEnv *env, ERL_NIF_TERM term, enum drive_mode *dr
     return true;
 }
 
+static uint64_t all_lines_mask(int num_lines)
+{
+    return (num_lines >= 64) ? ~(uint64_t) 0 : (((uint64_t) 1 << num_lines) - 1);
+}
+
+// Optional subscribe/2 settings
+struct gpio_sub_options {
+    int64_t settle_ns;
+    int64_t debounce_ns;
+    int64_t timeout_ns;
+    int64_t reorder_ns;
+    uint64_t lines;
+    bool has_match;
+    uint64_t match_mask;
+    uint64_t match_pattern;
+    const struct gpio_mode *mode;
+    struct gpio_reflex reflex;
+};
+
+static const struct gpio_sub_options default_sub_options = {
+    .settle_ns = 0,
+    .debounce_ns = 0,
+    .timeout_ns = 0,
+    .reorder_ns = 0,
+    .lines = UINT64_MAX,
+    .has_match = false,
+    .match_mask = 0,
+    .match_pattern = 0,
+    .mode = NULL,
+    .reflex = {.rule = REFLEX_NONE}
+};
+
+static int get_reflex_rule(ErlNifEnv *env, ERL_NIF_TERM term, struct gpio_reflex *reflex)
+{
+    int arity;
+    const ERL_NIF_TERM *tuple;
+    ErlNifSInt64 pulse_us;
+    if (enif_get_tuple(env, term, &arity, &tuple)) {
+        // {:pulse, microseconds}
+        if (arity != 2 ||
+                !enif_is_identical(tuple[0], enif_make_atom(env, "pulse")) ||
+                !enif_get_int64(env, tuple[1], &pulse_us) ||
+                pulse_us <= 0 ||
+                pulse_us > INT64_MAX / 1000)
+            return false;
+
+        reflex->rule = REFLEX_PULSE;
+        reflex->pulse_ns = pulse_us * 1000;
+        return true;
+    }
+
+    char buffer[20];
+    if (!enif_get_atom(env, term, buffer, sizeof(buffer), ERL_NIF_LATIN1))
+        return false;
+
+    if (strcmp("mirror", buffer) == 0) reflex->rule = REFLEX_MIRROR;
+    else if (strcmp("invert", buffer) == 0) reflex->rule = REFLEX_INVERT;
+    else if (strcmp("set_on_rising", buffer) == 0) reflex->rule = REFLEX_SET_ON_RISING;
+    else if (strcmp("set_on_falling", buffer) == 0) reflex->rule = REFLEX_SET_ON_FALLING;
+    else if (strcmp("clear_on_rising", buffer) == 0) reflex->rule = REFLEX_CLEAR_ON_RISING;
+    else if (strcmp("clear_on_falling", buffer) == 0) reflex->rule = REFLEX_CLEAR_ON_FALLING;
+    else return false;
+
+    return true;
+}
+
+// Parse {output, rule} or {output, rule, output_lines}
+static int get_reflex(ErlNifEnv *env, ERL_NIF_TERM term, struct gpio_reflex *reflex)
+{
+    struct gpio_priv *priv = enif_priv_data(env);
+    int arity;
+    const ERL_NIF_TERM *tuple;
+    struct gpio_pin *output;
+
+    if (!enif_get_tuple(env, term, &arity, &tuple) ||
+            (arity != 2 && arity != 3) ||
+            !enif_get_resource(env, tuple[0], priv->gpio_pin_rt, (void**) &output) ||
+            !get_reflex_rule(env, tuple[1], reflex))
+        return false;
+
+    reflex->output = output;
+    reflex->output_mask = all_lines_mask(output->num_lines);
+    if (arity == 3) {
+        ErlNifUInt64 lines;
+        if (!enif_get_uint64(env, tuple[2], &lines) || (lines & reflex->output_mask) == 0)
+            return false;
+        reflex->output_mask &= lines;
+    }
+
+    return true;
+}
+
+static int get_sub_options(ErlNifEnv *env, ERL_NIF_TERM map, struct gpio_sub_options *options)
+{
+    ERL_NIF_TERM value;
+
+    *options = default_sub_options;
+
+    if (enif_get_map_value(env, map, enif_make_atom(env, "settle_ns"), &value)) {
+        ErlNifSInt64 settle_ns;
+        if (!enif_get_int64(env, value, &settle_ns) || settle_ns < 0)
+            return false;
+        options->settle_ns = settle_ns;
+    }
+
+    if (enif_get_map_value(env, map, enif_make_atom(env, "debounce_us"), &value)) {
+        ErlNifSInt64 debounce_us;
+        if (!enif_get_int64(env, value, &debounce_us) || debounce_us < 0 || debounce_us > INT64_MAX / 1000)
+            return false;
+        options->debounce_ns = debounce_us * 1000;
+    }
+
+    if (enif_get_map_value(env, map, enif_make_atom(env, "reorder_ns"), &value)) {
+        ErlNifSInt64 reorder_ns;
+        if (!enif_get_int64(env, value, &reorder_ns) || reorder_ns < 0)
+            return false;
+        options->reorder_ns = reorder_ns;
+    }
+
+    if (enif_get_map_value(env, map, enif_make_atom(env, "timeout_ms"), &value)) {
+        ErlNifSInt64 timeout_ms;
+        if (!enif_get_int64(env, value, &timeout_ms) || timeout_ms < 0 || timeout_ms > INT64_MAX / 1000000)
+            return false;
+        options->timeout_ns = timeout_ms * 1000000;
+    }
+
+    if (enif_get_map_value(env, map, enif_make_atom(env, "lines"), &value)) {
+        ErlNifUInt64 lines;
+        if (!enif_get_uint64(env, value, &lines))
+            return false;
+        options->lines = lines;
+    }
+
+    if (enif_get_map_value(env, map, enif_make_atom(env, "match"), &value)) {
+        const ERL_NIF_TERM *tuple;
+        int arity;
+        ErlNifUInt64 mask;
+        ErlNifUInt64 pattern;
+        if (!enif_get_tuple(env, value, &arity, &tuple) ||
+                arity != 2 ||
+                !enif_get_uint64(env, tuple[0], &mask) ||
+                !enif_get_uint64(env, tuple[1], &pattern) ||
+                (pattern & ~mask) != 0)
+            return false;
+        options->has_match = true;
+        options->match_mask = mask;
+        options->match_pattern = pattern;
+    }
+
+    if (enif_get_map_value(env, map, enif_make_atom(env, "mode"), &value)) {
+        options->mode = find_gpio_mode(env, value);
+        if (!options->mode)
+            return false;
+    }
+
+    if (enif_get_map_value(env, map, enif_make_atom(env, "reflex"), &value) &&
+            !get_reflex(env, value, &options->reflex))
+        return false;
+
+    return true;
+}
+
+static struct gpio_sub *alloc_gpio_sub(struct gpio_priv *priv,
+                                       const ErlNifPid *pid,
+                                       enum trigger_mode emit_trigger,
+                                       uint64_t line_mask,
+                                       bool notify_map,
+                                       ERL_NIF_TERM notify_term,
+                                       const struct gpio_sub_options *options)
+{
+    struct gpio_sub *sub = enif_alloc_resource(priv->gpio_sub_rt, sizeof(struct gpio_sub));
+    memset(sub, 0, sizeof(struct gpio_sub));
+    atomic_init(&sub->pid, *pid);
+    sub->emit_trigger = emit_trigger;
+    sub->line_mask = line_mask;
+    sub->notify_map = notify_map;
+    sub->env = enif_alloc_env();
+    sub->notify_term = enif_make_copy(sub->env, notify_term);
+    sub->has_match = options->has_match;
+    sub->match_mask = options->match_mask;
+    sub->match_pattern = options->match_pattern;
+    sub->settle_ns = options->settle_ns;
+    sub->timeout_ns = options->timeout_ns;
+    sub->last_activity = hal_timestamp();
+    sub->debounce_ns = options->debounce_ns;
+    if (sub->debounce_ns > 0)
+        sub->debounce_edges = enif_alloc(sizeof(int64_t) * GPIO_MAX_LINES);
+    sub->reflex = options->reflex;
+    if (sub->reflex.output)
+        enif_keep_resource(sub->reflex.output);
+    sub->merge = NULL;
+    sub->source = -1;
+    sub->mode = NULL;
+    sub->lock = NULL;
+    sub->state = NULL;
+    return sub;
+}
+
+// Switch a new subscriber to a subscription mode. Mode-specific options are
+// in the subscribe options map. Returns -EINVAL if the mode rejects them.
+static int init_sub_mode(ErlNifEnv *env,
+                         struct gpio_sub *sub,
+                         const struct gpio_mode *mode,
+                         int num_lines,
+                         ERL_NIF_TERM options)
+{
+    sub->lock = enif_mutex_create("gpio_sub");
+    sub->state = enif_alloc(mode->state_size);
+    if (!sub->lock || !sub->state)
+        return -ENOMEM;
+
+    memset(sub->state, 0, mode->state_size);
+
+    sub->mode = mode;
+    return mode->init(env, sub, num_lines, options) ? 0 : -EINVAL;
+}
+
+// Find the handle's subscriber with a subscription mode for notify_id. Pass 0
+// for notify_id to find the first one using mode instead. Call this with the
+// line request's lock held.
+static struct gpio_sub *find_mode_sub(struct gpio_pin *pin, ERL_NIF_TERM notify_id, const struct gpio_mode *mode)
+{
+    struct gpio_pin *request = line_request(pin);
+    for (int i = 0; i < request->num_subs; i++) {
+        struct gpio_sub *sub = request->subs[i];
+        if (sub->owner == pin &&
+                sub->mode &&
+                sub->notify_map &&
+                (notify_id == 0 || enif_is_identical(sub->notify_term, notify_id)) &&
+                (mode == NULL || sub->mode == mode))
+            return sub;
+    }
+    return NULL;
+}
+
+static ERL_NIF_TERM read_mode_sub(ErlNifEnv *env, struct gpio_sub *sub, bool clear)
+{
+    if (!sub)
+        return enif_make_tuple2(env, atom_error, enif_make_atom(env, "not_found"));
+
+    enif_mutex_lock(sub->lock);
+    ERL_NIF_TERM result = sub->mode->read(env, sub, clear);
+    enif_mutex_unlock(sub->lock);
+
+    return make_ok_tuple(env, result);
+}
+
+// Replace a handle's subscribers and hardware trigger.
+//
+// The caller passes one reference for each entry in subs. Subscribers that
+// are staying need an extra enif_keep_resource by the caller. On success, the
+// handle's references to its old subscribers are released. On failure,
+// everything is restored and the passed references are released instead.
+static int replace_gpio_subs(ErlNifEnv *env,
+                             struct gpio_pin *pin,
+                             enum trigger_mode trigger,
+                             struct gpio_sub *const *subs,
+                             int num_subs)
+{
+    struct gpio_config old_config = pin->config;
+    struct gpio_sub *old_subs[MAX_GPIO_SUBSCRIBERS];
+    int old_num_subs = pin->num_subs;
+    memcpy(old_subs, pin->subs, sizeof(struct gpio_sub *) * old_num_subs);
+
+    pin->config.trigger = trigger;
+    memcpy(pin->subs, subs, sizeof(struct gpio_sub *) * num_subs);
+    pin->num_subs = num_subs;
+
+    int rc = hal_apply_interrupts(pin, env);
+    if (rc < 0) {
+        pin->config = old_config;
+        memcpy(pin->subs, old_subs, sizeof(struct gpio_sub *) * old_num_subs);
+        pin->num_subs = old_num_subs;
+        release_gpio_subs(subs, num_subs);
+        return rc;
+    }
+
+    release_gpio_subs(old_subs, old_num_subs);
+    return 0;
+}
+
+// Collect references to a line request's subscribe/2 subscribers except for
+// the ones that owner added for notify_id. Pass 0 for notify_id to leave out
+// all of owner's subscribers and NULL for owner to keep everything.
+static int keep_map_subs(struct gpio_pin *pin, const struct gpio_pin *owner, ERL_NIF_TERM notify_id, struct gpio_sub **subs)
+{
+    int count = 0;
+    for (int i = 0; i < pin->num_subs; i++) {
+        struct gpio_sub *sub = pin->subs[i];
+        if (!sub->notify_map ||
+                (sub->owner == owner &&
+                 (notify_id == 0 || enif_is_identical(sub->notify_term, notify_id))))
+            continue;
+
+        enif_keep_resource(sub);
+        subs[count++] = sub;
+    }
+    return count;
+}
+
+// Subscribers all share the handle's line request, so the hardware needs to
+// report both edges if anyone wants notifications or has a reflex.
+static enum trigger_mode subs_trigger(struct gpio_sub *const *subs, int num_subs)
+{
+    for (int i = 0; i < num_subs; i++) {
+        if (subs[i]->emit_trigger != TRIGGER_NONE || subs[i]->reflex.rule != REFLEX_NONE)
+            return TRIGGER_BOTH;
+    }
+    return TRIGGER_NONE;
+}
+
+// Add subscribe/2 subscribers to a handle. The caller passes one reference to
+// each new subscriber and this takes them over. Subscribers to sub-handles go
+// on the parent since that's what has the line request.
+static int add_gpio_subs(ErlNifEnv *env, struct gpio_pin *pin, struct gpio_sub *const *new_subs, int num_new_subs)
+{
+    struct gpio_pin *request = line_request(pin);
+
+    // Subscribers get the gpio_spec from the handle's env which is freed on close
+    if (!pin->env || !request->env) {
+        release_gpio_subs(new_subs, num_new_subs);
+        return -EBADF;
+    }
+
+    enif_mutex_lock(request->lock);
+
+    // Subscribers accumulate. Existing subscribe/2 subscribers stay and any
+    // legacy set_interrupts subscriber is replaced.
+    struct gpio_sub *subs[MAX_GPIO_SUBSCRIBERS];
+    int num_subs = keep_map_subs(request, NULL, 0, subs);
+    if (num_subs + num_new_subs > MAX_GPIO_SUBSCRIBERS) {
+        enif_mutex_unlock(request->lock);
+        release_gpio_subs(subs, num_subs);
+        release_gpio_subs(new_subs, num_new_subs);
+        return -EMLINK;
+    }
+
+    // Seed the shadow with the current value so the first notification's
+    // previous_value is well defined.
+    uint64_t seed;
+    if (hal_read_gpio(request, &seed) >= 0)
+        request->shadow = seed;
+
+    uint64_t value = request->shadow;
+    if (pin->parent)
+        value = gather_bits(pin->parent_bits, pin->num_lines, value);
+
+    for (int i = 0; i < num_new_subs; i++) {
+        struct gpio_sub *sub = new_subs[i];
+        sub->owner = pin;
+        if (pin->parent) {
+            sub->num_view_lines = pin->num_lines;
+            memcpy(sub->view_bits, pin->parent_bits, pin->num_lines);
+        }
+        sub->last_value = value;
+        sub->debounced = value & sub->line_mask;
+        if (sub->reflex.rule != REFLEX_NONE)
+            start_reflex(env, sub, value);
+        subs[num_subs++] = sub;
+    }
+
+    // The hardware tracks both edges so the shadow stays accurate even when a
+    // subscriber only wants one direction; emit_trigger filters what's sent.
+    int rc = replace_gpio_subs(env, request, subs_trigger(subs, num_subs), subs, num_subs);
+    enif_mutex_unlock(request->lock);
+    return rc;
+}
+
+// Remove the subscribe/2 subscribers that a handle added for notify_id or all
+// of them when notify_id is 0. Other handles sharing the line request keep
+// theirs.
+static int remove_gpio_subs(ErlNifEnv *env, struct gpio_pin *pin, ERL_NIF_TERM notify_id)
+{
+    struct gpio_pin *request = line_request(pin);
+    struct gpio_sub *subs[MAX_GPIO_SUBSCRIBERS];
+
+    enif_mutex_lock(request->lock);
+    int num_subs = keep_map_subs(request, pin, notify_id, subs);
+    int rc = replace_gpio_subs(env, request, subs_trigger(subs, num_subs), subs, num_subs);
+    enif_mutex_unlock(request->lock);
+    return rc;
+}
+
+static ERL_NIF_TERM make_subscribe_error(ErlNifEnv *env, int rc)
+{
+    if (rc == -EMLINK)
+        return enif_make_tuple2(env, atom_error, enif_make_atom(env, "too_many_subscribers"));
+    else
+        return make_errno_error(env, rc);
+}
+
 static ERL_NIF_TERM set_interrupts(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 {
     struct gpio_priv *priv = enif_priv_data(env);
@@ -452,71 +1472,298 @@ static ERL_NIF_TERM set_interrupts(ErlNifEnv *env, int argc, const ERL_NIF_TERM
     if (pin->num_lines != 1)
         return enif_make_tuple2(env, atom_error, enif_make_atom(env, "group_handle"));
 
-    struct gpio_config old_config = pin->config;
-    if (!get_trigger(env, argv[1], &pin->config.trigger) ||
-            !enif_get_boolean(env, argv[2], &pin->config.suppress_glitches) ||
-            !enif_get_local_pid(env, argv[3], &pin->config.pid)) {
-        pin->config = old_config;
+    // Legacy notifications replace every subscriber on the line request
+    if (pin->parent)
+        return enif_make_tuple2(env, atom_error, enif_make_atom(env, "sub_handle"));
+
+    enum trigger_mode trigger;
+    bool suppress_glitches;
+    ErlNifPid pid;
+    if (!get_trigger(env, argv[1], &trigger) ||
+            !enif_get_boolean(env, argv[2], &suppress_glitches) ||
+            !enif_get_local_pid(env, argv[3], &pid))
         return enif_make_badarg(env);
+
+    // The spec is echoed in notifications and is gone once the handle closes
+    if (!pin->env)
+        return make_errno_error(env, -EBADF);
+
+    // Legacy notifications go to exactly one process, emit on exactly the
+    // hardware-detected edge, and use the {:circuits_gpio, spec, ts, value}
+    // tuple format. They replace any subscribe/2 subscribers.
+    struct gpio_sub *subs[1];
+    int num_subs = 0;
+    if (trigger != TRIGGER_NONE) {
+        subs[num_subs] = alloc_gpio_sub(priv, &pid, trigger, all_lines_mask(pin->num_lines), false, pin->gpio_spec, &default_sub_options);
+        subs[num_subs]->owner = pin;
+        num_subs++;
     }
 
-    // Legacy notifications emit on exactly the hardware-detected edge and use
-    // the {:circuits_gpio, spec, ts, value} tuple format.
-    pin->config.emit_trigger = pin->config.trigger;
-    pin->notify_map = false;
+    bool old_suppress_glitches = pin->config.suppress_glitches;
+    pin->config.suppress_glitches = suppress_glitches;
 
-    int rc = hal_apply_interrupts(pin, env);
+    enif_mutex_lock(pin->lock);
+    int rc = replace_gpio_subs(env, pin, trigger, subs, num_subs);
+    enif_mutex_unlock(pin->lock);
     if (rc < 0) {
-        pin->config = old_config;
+        pin->config.suppress_glitches = old_suppress_glitches;
         return make_errno_error(env, rc);
     }
 
     return atom_ok;
 }
 
+// Parse subscriber routes: [{pid, line_mask}, ...]
+static int get_routes(ErlNifEnv *env, ERL_NIF_TERM list, ErlNifPid *pids, uint64_t *masks, int max_routes, int *num_routes)
+{
+    ERL_NIF_TERM head, tail;
+    int count = 0;
+    while (enif_get_list_cell(env, list, &head, &tail)) {
+        int arity;
+        const ERL_NIF_TERM *tuple;
+        ErlNifUInt64 mask;
+
+        if (count >= max_routes ||
+                !enif_get_tuple(env, head, &arity, &tuple) ||
+                arity != 2 ||
+                !enif_get_local_pid(env, tuple[0], &pids[count]) ||
+                !enif_get_uint64(env, tuple[1], &mask))
+            return false;
+
+        masks[count] = mask;
+        count++;
+        list = tail;
+    }
+
+    *num_routes = count;
+    return count > 0;
+}
+
 static ERL_NIF_TERM subscribe(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 {
     struct gpio_priv *priv = enif_priv_data(env);
     struct gpio_pin *pin;
 
-    // subscribe(resource, notify_id, trigger, pid)
-    if (argc != 4 ||
+    // subscribe(resource, notify_id, trigger, [{pid, line_mask}, ...], options)
+    if (argc != 5 ||
             !enif_get_resource(env, argv[0], priv->gpio_pin_rt, (void**) &pin))
         return enif_make_badarg(env);
 
-    struct gpio_config old_config = pin->config;
-    bool old_notify_map = pin->notify_map;
-    ERL_NIF_TERM old_gpio_spec = enif_make_copy(env, pin->gpio_spec);
-    ERL_NIF_TERM old_notify_id = old_notify_map ? enif_make_copy(env, pin->notify_id) : 0;
+    enum trigger_mode emit_trigger;
+    ErlNifPid pids[MAX_GPIO_SUBSCRIBERS];
+    uint64_t masks[MAX_GPIO_SUBSCRIBERS];
+    int num_routes;
+    struct gpio_sub_options options;
+    if (!get_trigger(env, argv[2], &emit_trigger) ||
+            !get_routes(env, argv[3], pids, masks, MAX_GPIO_SUBSCRIBERS, &num_routes) ||
+            !get_sub_options(env, argv[4], &options))
+        return enif_make_badarg(env);
+
+    // Mode and reflex state is per subscription, so it can only go to one place
+    if ((options.mode || options.reflex.rule != REFLEX_NONE) && num_routes != 1)
+        return enif_make_badarg(env);
+
+    // Modes handle each edge themselves, so they can't be filtered or merged
+    if (options.mode && (options.has_match || options.settle_ns > 0))
+        return enif_make_badarg(env);
+
+    if (options.reflex.output && !line_request(options.reflex.output)->config.is_output)
+        return enif_make_tuple2(env, atom_error, enif_make_atom(env, "pin_not_output"));
+
+    struct gpio_sub *new_subs[MAX_GPIO_SUBSCRIBERS];
+    uint64_t group_mask = all_lines_mask(pin->num_lines);
+    for (int i = 0; i < num_routes; i++)
+        new_subs[i] = alloc_gpio_sub(priv, &pids[i], emit_trigger, masks[i] & options.lines & group_mask, true, argv[1], &options);
+
+    if (options.mode) {
+        int rc = init_sub_mode(env, new_subs[0], options.mode, pin->num_lines, argv[4]);
+        if (rc < 0) {
+            release_gpio_subs(new_subs, num_routes);
+            return rc == -EINVAL ? enif_make_badarg(env) : make_errno_error(env, rc);
+        }
+    }
+
+    int rc = add_gpio_subs(env, pin, new_subs, num_routes);
+    if (rc < 0)
+        return make_subscribe_error(env, rc);
+
+    return atom_ok;
+}
+
+static ERL_NIF_TERM subscribe_merged(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+    struct gpio_priv *priv = enif_priv_data(env);
+    struct gpio_pin *pins[MAX_GPIO_LISTENERS];
+    unsigned int num_pins;
+
+    // subscribe_merged([resource, ...], notify_id, trigger, pid, options)
+    if (argc != 5 ||
+            !enif_get_list_length(env, argv[0], &num_pins) ||
+            num_pins == 0 ||
+            num_pins > MAX_GPIO_LISTENERS)
+        return enif_make_badarg(env);
+
+    ERL_NIF_TERM list = argv[0];
+    ERL_NIF_TERM head;
+    for (unsigned int i = 0; i < num_pins; i++) {
+        if (!enif_get_list_cell(env, list, &head, &list) ||
+                !enif_get_resource(env, head, priv->gpio_pin_rt, (void**) &pins[i]))
+            return enif_make_badarg(env);
+
+        for (unsigned int j = 0; j < i; j++) {
+            if (pins[j] == pins[i])
+                return enif_make_badarg(env);
+        }
+    }
+
     enum trigger_mode emit_trigger;
     ErlNifPid pid;
+    struct gpio_sub_options options;
     if (!get_trigger(env, argv[2], &emit_trigger) ||
-            !enif_get_local_pid(env, argv[3], &pid)) {
+            !enif_get_local_pid(env, argv[3], &pid) ||
+            !get_sub_options(env, argv[4], &options) ||
+            options.mode ||
+            options.reflex.rule != REFLEX_NONE)
         return enif_make_badarg(env);
+
+    struct gpio_merge *merge = enif_alloc_resource(priv->gpio_merge_rt, sizeof(struct gpio_merge));
+    memset(merge, 0, sizeof(struct gpio_merge));
+    atomic_init(&merge->pid, pid);
+    atomic_init(&merge->num_sources, 0);
+    merge->env = enif_alloc_env();
+    merge->notify_term = enif_make_copy(merge->env, argv[1]);
+    merge->reorder_ns = options.reorder_ns;
+
+    int rc = 0;
+    unsigned int added;
+    for (added = 0; added < num_pins; added++) {
+        struct gpio_pin *pin = pins[added];
+        struct gpio_sub *sub = alloc_gpio_sub(priv, &pid, emit_trigger, options.lines & all_lines_mask(pin->num_lines), true, argv[1], &options);
+        enif_keep_resource(merge);
+        atomic_fetch_add(&merge->num_sources, 1);
+        sub->merge = merge;
+        sub->source = (int) added;
+
+        rc = add_gpio_subs(env, pin, &sub, 1);
+        if (rc < 0)
+            break;
     }
+    enif_release_resource(merge);
 
-    // Seed the shadow with the current value so the first notification's
-    // previous_value is well defined.
-    uint64_t seed;
-    if (hal_read_gpio(pin, &seed) >= 0)
-        pin->shadow = seed;
+    if (rc < 0) {
+        // Undo the handles that were already subscribed
+        for (unsigned int i = 0; i < added; i++)
+            remove_gpio_subs(env, pins[i], argv[1]);
+        return make_subscribe_error(env, rc);
+    }
 
-    // The hardware tracks both edges so the shadow stays accurate even when the
-    // caller only wants one direction; emit_trigger filters what's sent.
-    pin->config.trigger = (emit_trigger == TRIGGER_NONE) ? TRIGGER_NONE : TRIGGER_BOTH;
-    pin->config.emit_trigger = emit_trigger;
-    pin->config.pid = pid;
-    pin->notify_map = true;
-    set_pin_terms(pin, old_gpio_spec, true, argv[1]);
+    return atom_ok;
+}
+
+static ERL_NIF_TERM capture_start(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+    struct gpio_priv *priv = enif_priv_data(env);
+    struct gpio_pin *pins[MAX_GPIO_LISTENERS];
+    unsigned int num_pins;
+    ErlNifPid pid;
+
+    // capture_start([resource, ...], notify_id, pid, options)
+    if (argc != 4 ||
+            !enif_get_list_length(env, argv[0], &num_pins) ||
+            num_pins == 0 ||
+            num_pins > MAX_GPIO_LISTENERS ||
+            !enif_get_local_pid(env, argv[2], &pid))
+        return enif_make_badarg(env);
+
+    ERL_NIF_TERM list = argv[0];
+    ERL_NIF_TERM head;
+    for (unsigned int i = 0; i < num_pins; i++) {
+        if (!enif_get_list_cell(env, list, &head, &list) ||
+                !enif_get_resource(env, head, priv->gpio_pin_rt, (void**) &pins[i]))
+            return enif_make_badarg(env);
+
+        for (unsigned int j = 0; j < i; j++) {
+            if (pins[j] == pins[i])
+                return enif_make_badarg(env);
+        }
+    }
+
+    struct gpio_analyzer *analyzer = alloc_gpio_analyzer(env, (int) num_pins, argv[3]);
+    if (!analyzer)
+        return enif_make_badarg(env);
+
+    int rc = 0;
+    unsigned int added;
+    for (added = 0; added < num_pins; added++) {
+        struct gpio_pin *pin = pins[added];
+        struct gpio_sub *sub = alloc_gpio_sub(priv, &pid, TRIGGER_BOTH, all_lines_mask(pin->num_lines), true, argv[1], &default_sub_options);
+        rc = init_sub_mode(env, sub, &gpio_analyzer_mode, pin->num_lines, argv[3]);
+        if (rc < 0) {
+            enif_release_resource(sub);
+            break;
+        }
+        attach_gpio_analyzer(sub, analyzer, (int) added, pin);
+
+        rc = add_gpio_subs(env, pin, &sub, 1);
+        if (rc < 0)
+            break;
+    }
 
-    int rc = hal_apply_interrupts(pin, env);
     if (rc < 0) {
-        pin->config = old_config;
-        pin->notify_map = old_notify_map;
-        set_pin_terms(pin, old_gpio_spec, old_notify_map, old_notify_id);
+        // Undo the handles that were already subscribed
+        for (unsigned int i = 0; i < added; i++)
+            remove_gpio_subs(env, pins[i], argv[1]);
+        enif_release_resource(analyzer);
+        return make_subscribe_error(env, rc);
+    }
+
+    ERL_NIF_TERM analyzer_term = enif_make_resource(env, analyzer);
+    enif_release_resource(analyzer);
+
+    return make_ok_tuple(env, analyzer_term);
+}
+
+static ERL_NIF_TERM recorder_start(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+    struct gpio_priv *priv = enif_priv_data(env);
+    struct gpio_pin *pin;
+    ErlNifBinary path_binary;
+    char path[PATH_MAX];
+    unsigned int capacity;
+    ErlNifPid pid;
+
+    // recorder_start(resource, notify_id, path, capacity)
+    if (argc != 4 ||
+            !enif_get_resource(env, argv[0], priv->gpio_pin_rt, (void**) &pin) ||
+            !enif_inspect_binary(env, argv[2], &path_binary) ||
+            path_binary.size + 1 > sizeof(path) ||
+            !enif_get_uint(env, argv[3], &capacity))
+        return enif_make_badarg(env);
+
+    memcpy(path, path_binary.data, path_binary.size);
+    path[path_binary.size] = '\0';
+
+    // The recorder never sends messages, but subscribers need a process
+    enif_self(env, &pid);
+
+    // The recorder has no mode options. The file settings are passed below.
+    struct gpio_sub *sub = alloc_gpio_sub(priv, &pid, TRIGGER_BOTH, all_lines_mask(pin->num_lines), true, argv[1], &default_sub_options);
+    int rc = init_sub_mode(env, sub, &gpio_recorder_mode, pin->num_lines, enif_make_new_map(env));
+    if (rc < 0) {
+        enif_release_resource(sub);
+        return make_errno_error(env, rc);
+    }
+
+    rc = open_gpio_recorder(sub, pin, path, capacity);
+    if (rc < 0) {
+        enif_release_resource(sub);
         return make_errno_error(env, rc);
     }
 
+    rc = add_gpio_subs(env, pin, &sub, 1);
+    if (rc < 0)
+        return make_subscribe_error(env, rc);
+
     return atom_ok;
 }
 
@@ -525,24 +1772,103 @@ static ERL_NIF_TERM unsubscribe(ErlNifEnv *env, int argc, const ERL_NIF_TERM arg
     struct gpio_priv *priv = enif_priv_data(env);
     struct gpio_pin *pin;
 
-    if (argc != 1 ||
+    // unsubscribe(resource) or unsubscribe(resource, notify_id)
+    if (argc < 1 || argc > 2 ||
             !enif_get_resource(env, argv[0], priv->gpio_pin_rt, (void**) &pin))
         return enif_make_badarg(env);
 
-    struct gpio_config old_config = pin->config;
-    pin->config.trigger = TRIGGER_NONE;
-    pin->config.emit_trigger = TRIGGER_NONE;
-
-    int rc = hal_apply_interrupts(pin, env);
-    if (rc < 0) {
-        pin->config = old_config;
+    int rc = remove_gpio_subs(env, pin, (argc == 2) ? argv[1] : 0);
+    if (rc < 0)
         return make_errno_error(env, rc);
+
+    return atom_ok;
+}
+
+static ERL_NIF_TERM transfer(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+    struct gpio_priv *priv = enif_priv_data(env);
+    struct gpio_pin *pin;
+    ErlNifPid pid;
+
+    // transfer(resource, pid)
+    if (argc != 2 ||
+            !enif_get_resource(env, argv[0], priv->gpio_pin_rt, (void**) &pin) ||
+            !enif_get_local_pid(env, argv[1], &pid))
+        return enif_make_badarg(env);
+
+    struct gpio_pin *request = line_request(pin);
+    if (!pin->env || !request->env)
+        return make_errno_error(env, -EBADF);
+
+    // Only the pid changes, so the line request stays as it is and pending
+    // settle windows, debounces and mode state carry over. The poller and the
+    // stub use these same subscribers, so the next change goes to the new
+    // process.
+    //
+    // A merged subscription's stream is shared with its other handles, so
+    // refuse rather than move it out from under them. Nothing changes in that
+    // case.
+    enif_mutex_lock(request->lock);
+    for (int i = 0; i < request->num_subs; i++) {
+        struct gpio_sub *sub = request->subs[i];
+        if (sub->owner == pin && sub->merge && atomic_load(&sub->merge->num_sources) > 1) {
+            enif_mutex_unlock(request->lock);
+            return enif_make_tuple2(env, atom_error, enif_make_atom(env, "merged"));
+        }
     }
 
-    pin->notify_map = false;
+    for (int i = 0; i < request->num_subs; i++) {
+        struct gpio_sub *sub = request->subs[i];
+        if (sub->owner != pin)
+            continue;
+
+        atomic_store(&sub->pid, pid);
+        if (sub->merge)
+            atomic_store(&sub->merge->pid, pid);
+    }
+    enif_mutex_unlock(request->lock);
+
     return atom_ok;
 }
 
+static ERL_NIF_TERM read_subscription(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+    struct gpio_priv *priv = enif_priv_data(env);
+    struct gpio_pin *pin;
+    bool clear;
+
+    // read_subscription(resource, notify_id, clear)
+    if (argc != 3 ||
+            !enif_get_resource(env, argv[0], priv->gpio_pin_rt, (void**) &pin) ||
+            !enif_get_boolean(env, argv[2], &clear))
+        return enif_make_badarg(env);
+
+    struct gpio_pin *request = line_request(pin);
+    enif_mutex_lock(request->lock);
+    ERL_NIF_TERM result = read_mode_sub(env, find_mode_sub(pin, argv[1], NULL), clear);
+    enif_mutex_unlock(request->lock);
+    return result;
+}
+
+static ERL_NIF_TERM read_latched(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+    struct gpio_priv *priv = enif_priv_data(env);
+    struct gpio_pin *pin;
+    bool clear;
+
+    // read_latched(resource, clear)
+    if (argc != 2 ||
+            !enif_get_resource(env, argv[0], priv->gpio_pin_rt, (void**) &pin) ||
+            !enif_get_boolean(env, argv[1], &clear))
+        return enif_make_badarg(env);
+
+    struct gpio_pin *request = line_request(pin);
+    enif_mutex_lock(request->lock);
+    ERL_NIF_TERM result = read_mode_sub(env, find_mode_sub(pin, 0, &gpio_latch_mode), clear);
+    enif_mutex_unlock(request->lock);
+    return result;
+}
+
 static ERL_NIF_TERM set_direction(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 {
     struct gpio_priv *priv = enif_priv_data(env);
@@ -552,6 +1878,10 @@ static ERL_NIF_TERM set_direction(ErlNifEnv *env, int argc, const ERL_NIF_TERM a
             !enif_get_resource(env, argv[0], priv->gpio_pin_rt, (void**) &pin))
         return enif_make_badarg(env);
 
+    // The line request's configuration is shared by all of its sub-handles
+    if (pin->parent)
+        return enif_make_tuple2(env, atom_error, enif_make_atom(env, "sub_handle"));
+
     struct gpio_config old_config = pin->config;
     if (!get_direction(env, argv[1], &pin->config.is_output))
         return enif_make_badarg(env);
@@ -574,6 +1904,10 @@ static ERL_NIF_TERM set_pull_mode(ErlNifEnv *env, int argc, const ERL_NIF_TERM a
             !enif_get_resource(env, argv[0], priv->gpio_pin_rt, (void**) &pin))
         return enif_make_badarg(env);
 
+    // The line request's configuration is shared by all of its sub-handles
+    if (pin->parent)
+        return enif_make_tuple2(env, atom_error, enif_make_atom(env, "sub_handle"));
+
     struct gpio_config old_config = pin->config;
     if (!get_pull_mode(env, argv[1], &pin->config.pull))
         return enif_make_badarg(env);
@@ -596,6 +1930,10 @@ static ERL_NIF_TERM set_drive_mode(ErlNifEnv *env, int argc, const ERL_NIF_TERM
             !enif_get_resource(env, argv[0], priv->gpio_pin_rt, (void**) &pin))
         return enif_make_badarg(env);
 
+    // The line request's configuration is shared by all of its sub-handles
+    if (pin->parent)
+        return enif_make_tuple2(env, atom_error, enif_make_atom(env, "sub_handle"));
+
     struct gpio_config old_config = pin->config;
     if (!get_drive_mode(env, argv[1], &pin->config.drive))
         return enif_make_badarg(env);
@@ -655,18 +1993,24 @@ static ERL_NIF_TERM open_gpio(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[
     pin->shadow = 0;
     pin->env = enif_alloc_env();
     pin->gpio_spec = enif_make_copy(pin->env, argv[0]);
-    pin->notify_id = 0;
-    pin->notify_map = false;
+    pin->num_subs = 0;
     pin->next = NULL;
     pin->registered = false;
     pin->hal_priv = priv->hal_priv;
     pin->config.is_output = is_output;
     pin->config.trigger = TRIGGER_NONE;
-    pin->config.emit_trigger = TRIGGER_NONE;
     pin->config.pull = pull;
     pin->config.drive = drive;
     pin->config.suppress_glitches = false;
     pin->config.initial_value = initial_value;
+    pin->parent = NULL;
+    atomic_init(&pin->fd_users, 0);
+    atomic_init(&pin->closing, false);
+    pin->lock = enif_mutex_create("gpio_pin");
+    if (!pin->lock) {
+        enif_release_resource(pin);
+        return make_errno_error(env, -ENOMEM);
+    }
 
     int rc = hal_open_gpio(pin, env);
     if (rc < 0) {
@@ -683,6 +2027,66 @@ static ERL_NIF_TERM open_gpio(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[
     return make_ok_tuple(env, pin_resource);
 }
 
+static ERL_NIF_TERM open_sub(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+    struct gpio_priv *priv = enif_priv_data(env);
+    struct gpio_pin *pin;
+    unsigned int num_lines;
+
+    // open_sub(resource, [bit, ...])
+    if (argc != 2 ||
+            !enif_get_resource(env, argv[0], priv->gpio_pin_rt, (void**) &pin) ||
+            !enif_get_list_length(env, argv[1], &num_lines) ||
+            num_lines == 0 ||
+            num_lines > (unsigned int) pin->num_lines)
+        return enif_make_badarg(env);
+
+    // Sub-handles of sub-handles use the original line request
+    struct gpio_pin *request = line_request(pin);
+    uint8_t bits[GPIO_MAX_LINES];
+    uint64_t used = 0;
+    ERL_NIF_TERM list = argv[1];
+    ERL_NIF_TERM head;
+    for (unsigned int i = 0; i < num_lines; i++) {
+        int bit;
+        if (!enif_get_list_cell(env, list, &head, &list) ||
+                !enif_get_int(env, head, &bit) ||
+                bit < 0 ||
+                bit >= pin->num_lines ||
+                (used & ((uint64_t) 1 << bit)))
+            return enif_make_badarg(env);
+
+        used |= (uint64_t) 1 << bit;
+        bits[i] = pin->parent ? pin->parent_bits[bit] : (uint8_t) bit;
+    }
+
+    if (pin->fd < 0 || !request->env)
+        return make_errno_error(env, -EBADF);
+
+    struct gpio_pin *sub = enif_alloc_resource(priv->gpio_pin_rt, sizeof(struct gpio_pin));
+    memset(sub, 0, sizeof(struct gpio_pin));
+    memcpy(sub->gpiochip, request->gpiochip, MAX_GPIOCHIP_PATH_LEN);
+    sub->num_lines = (int) num_lines;
+    for (unsigned int i = 0; i < num_lines; i++)
+        sub->offsets[i] = request->offsets[bits[i]];
+    memcpy(sub->parent_bits, bits, num_lines);
+
+    // Sub-handles don't have their own fd. 0 marks them as open.
+    sub->fd = 0;
+    sub->hal_priv = request->hal_priv;
+    sub->config = request->config;
+    sub->config.trigger = TRIGGER_NONE;
+    sub->env = enif_alloc_env();
+    sub->gpio_spec = enif_make_copy(sub->env, request->gpio_spec);
+    sub->parent = request;
+    enif_keep_resource(request);
+
+    ERL_NIF_TERM sub_resource = enif_make_resource(env, sub);
+    enif_release_resource(sub);
+
+    return make_ok_tuple(env, sub_resource);
+}
+
 static ERL_NIF_TERM close_gpio(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 {
     struct gpio_priv *priv = enif_priv_data(env);
@@ -722,7 +2126,9 @@ static ERL_NIF_TERM force_close(ErlNifEnv *env, int argc, const ERL_NIF_TERM arg
     for (struct gpio_pin *pin = priv->gpio_pins; pin; pin = pin->next) {
         if (pin_references_gpio(pin, gpiochip_path, offset)) {
             // Close the GPIO, but don't free up everything until the pin
-            // has been properly closed.
+            // has been properly closed. Only line requests are registered.
+            // Their sub-handles find out through keep_gpio_fd.
+            wait_for_gpio_fd_users(pin);
             hal_close_gpio(pin);
         }
     }
@@ -754,13 +2160,39 @@ static ERL_NIF_TERM gpio_enumerate(ErlNifEnv *env, int argc, const ERL_NIF_TERM
 
 static ErlNifFunc nif_funcs[] = {
     {"open", 6, open_gpio, ERL_NIF_DIRTY_JOB_IO_BOUND},
+    {"open_sub", 2, open_sub, 0},
     {"close", 1, close_gpio, 0},
     {"force_close", 1, force_close, ERL_NIF_DIRTY_JOB_IO_BOUND},
     {"read", 1, read_gpio, 0},
     {"write", 2, write_gpio, 0},
     {"set_interrupts", 4, set_interrupts, 0},
-    {"subscribe", 4, subscribe, 0},
+    {"subscribe", 5, subscribe, 0},
+    {"subscribe_merged", 5, subscribe_merged, 0},
+    {"capture_start", 4, capture_start, 0},
+    {"capture_stop", 1, capture_stop, ERL_NIF_DIRTY_JOB_CPU_BOUND},
+    {"recorder_start", 4, recorder_start, ERL_NIF_DIRTY_JOB_IO_BOUND},
     {"unsubscribe", 1, unsubscribe, 0},
+    {"unsubscribe", 2, unsubscribe, 0},
+    {"transfer", 2, transfer, 0},
+    {"read_subscription", 3, read_subscription, 0},
+    {"read_latched", 2, read_latched, 0},
+    {"task_stop", 1, task_stop, ERL_NIF_DIRTY_JOB_IO_BOUND},
+    {"keypad_start", 5, keypad_start, 0},
+    {"keypad_pressed", 1, keypad_pressed, 0},
+    {"pwm_start", 4, pwm_start, 0},
+    {"pwm_set", 3, pwm_set, 0},
+    {"pwm_get", 2, pwm_get, 0},
+    {"stepper_start", 4, stepper_start, 0},
+    {"stepper_move", 5, stepper_move, 0},
+    {"stepper_halt", 1, stepper_halt, 0},
+    {"stepper_status", 1, stepper_status, 0},
+    {"sequencer_start", 4, sequencer_start, 0},
+    {"shift_transfer", 4, shift_transfer, ERL_NIF_DIRTY_JOB_IO_BOUND},
+    {"onewire_transfer", 4, onewire_transfer, ERL_NIF_DIRTY_JOB_IO_BOUND},
+    {"onewire_search", 2, onewire_search, ERL_NIF_DIRTY_JOB_IO_BOUND},
+    {"heartbeat_start", 4, heartbeat_start, 0},
+    {"heartbeat_feed", 1, heartbeat_feed, 0},
+    {"c_api", 0, c_api, 0},
     {"set_direction", 2, set_direction, 0},
     {"set_pull_mode", 2, set_pull_mode, 0},
     {"set_drive_mode", 2, set_drive_mode, 0},
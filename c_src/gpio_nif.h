@@ -9,6 +9,7 @@
 
 #include "erl_nif.h"
 
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdint.h>
@@ -37,6 +38,19 @@ extern FILE *log_location;
 // group value is carried as a 64-bit integer (one bit per line).
 #define GPIO_MAX_LINES 64
 
+// Maximum number of subscribers on one handle. This is enough to route every
+// line of a full group to its own process.
+#define MAX_GPIO_SUBSCRIBERS 64
+
+// Number of changes a merged subscription can hold for reordering
+#define GPIO_MERGE_BUFFER_LEN 64
+
+// The counter mode's frequency window is split into this many buckets
+#define GPIO_COUNTER_BUCKETS 8
+
+// Maximum number of handles that a background task can use
+#define GPIO_TASK_MAX_PINS 4
+
 enum trigger_mode {
     TRIGGER_NONE = 0,
     TRIGGER_RISING,
@@ -57,8 +71,24 @@ enum drive_mode {
     DRIVE_OPEN_SOURCE
 };
 
+// What a reflex does to its output when the subscriber's input changes
+enum reflex_rule {
+    REFLEX_NONE = 0,
+    REFLEX_MIRROR,
+    REFLEX_INVERT,
+    REFLEX_SET_ON_RISING,
+    REFLEX_SET_ON_FALLING,
+    REFLEX_CLEAR_ON_RISING,
+    REFLEX_CLEAR_ON_FALLING,
+    REFLEX_PULSE
+};
+
 struct gpio_priv {
     ErlNifResourceType *gpio_pin_rt;
+    ErlNifResourceType *gpio_sub_rt;
+    ErlNifResourceType *gpio_merge_rt;
+    ErlNifResourceType *gpio_task_rt;
+    ErlNifResourceType *gpio_analyzer_rt;
     ErlNifMutex *gpio_pins_lock;
     struct gpio_pin *gpio_pins;
 
@@ -70,17 +100,298 @@ struct gpio_config {
 
     // trigger is the edge(s) the hardware is configured to detect. For a
     // subscription this is forced to TRIGGER_BOTH so the shadow value stays
-    // accurate; emit_trigger holds the edge(s) the caller actually wants
-    // notifications for.
+    // accurate; each subscriber's emit_trigger holds the edge(s) it actually
+    // wants notifications for.
     enum trigger_mode trigger;
-    enum trigger_mode emit_trigger;
     enum pull_mode pull;
     enum drive_mode drive;
     bool suppress_glitches;
 
     // Initial output values as an integer. Bit i corresponds to offsets[i].
     uint64_t initial_value;
-    ErlNifPid pid;
+};
+
+// A change to one or more lines of a group
+struct gpio_change {
+    // Timestamp of the (last) edge in nanoseconds
+    int64_t timestamp;
+
+    uint64_t value;
+    uint64_t previous_value;
+
+    // Lines that had rising or falling edges. A line can be in both if it
+    // pulsed while edges were being merged.
+    uint64_t rising;
+    uint64_t falling;
+
+    // Sequence number of the (last) edge in the line request or 0 if the
+    // change didn't come from an edge
+    uint32_t seqno;
+};
+
+// A change waiting in a merged subscription's reorder buffer
+struct gpio_merge_entry {
+    struct gpio_change change;
+    int source;
+    bool merged;
+};
+
+// State shared by the subscribers of a merged subscription (one per handle).
+// Changes are held for reorder_ns so that ones from different line requests
+// can be sent in timestamp order. Like a subscriber's delivery state, this is
+// only touched by whatever delivers changes. The exception is pid, which
+// transfer can change, so it's atomic like the subscriber's.
+struct gpio_merge {
+    _Atomic ErlNifPid pid;
+
+    // Subscribers still using this merge. transfer only moves pid when the
+    // handle being transferred owns the last one.
+    _Atomic int num_sources;
+    ErlNifEnv *env;
+    ERL_NIF_TERM notify_term;
+
+    int64_t reorder_ns;
+
+    // Sorted by timestamp
+    int count;
+    struct gpio_merge_entry entries[GPIO_MERGE_BUFFER_LEN];
+
+    bool dead;
+};
+
+// Quadrature decoder state for the encoder mode
+struct gpio_encoder {
+    int64_t position;
+    uint64_t errors;
+
+    // Rising edges on the optional third (index) line and the position when
+    // the last one happened
+    uint64_t index_count;
+    int64_t index_position;
+
+    // When non-zero, send position notifications at most this often
+    int64_t report_ns;
+    int64_t last_report;
+    bool report_pending;
+};
+
+// Edge counts for one line in the counter mode
+struct gpio_line_count {
+    uint64_t count;
+    int64_t first_timestamp;
+    int64_t last_timestamp;
+
+    // Counts for the frequency window
+    uint32_t buckets[GPIO_COUNTER_BUCKETS];
+};
+
+// Edge counter state for the counter mode. The frequency is the number of
+// edges in the last window_ns. That's tracked in buckets so that nothing
+// needs to be stored per edge.
+struct gpio_counter {
+    int num_lines;
+    bool both_edges;
+
+    // When counting started or was last cleared
+    int64_t start;
+
+    int64_t window_ns;
+    int64_t bucket_start;
+    int bucket;
+
+    // When non-zero, send the counts this often
+    int64_t report_ns;
+    int64_t last_report;
+
+    struct gpio_line_count lines[GPIO_MAX_LINES];
+};
+
+// Minimum, maximum and total of a measurement
+struct gpio_range {
+    uint64_t count;
+    int64_t min;
+    int64_t max;
+    int64_t sum;
+};
+
+// Pulse measurements for one line in the pulse mode
+struct gpio_line_pulses {
+    // Last edges seen or -1
+    int64_t last_rise;
+    int64_t last_fall;
+
+    // Low time and period leading up to the current pulse or -1 if unknown
+    int64_t low_ns;
+    int64_t period_ns;
+
+    struct gpio_range high;
+    struct gpio_range low;
+    struct gpio_range period;
+
+    // Duty cycle in parts per million
+    struct gpio_range duty;
+};
+
+// Pulse width measurement state for the pulse mode. A pulse is measured when
+// it ends (on the falling edge) along with the low time and period before it.
+struct gpio_pulses {
+    int num_lines;
+
+    // Send a message for each pulse
+    bool each_pulse;
+
+    // When non-zero, send and reset the summary this often
+    int64_t report_ns;
+    int64_t last_report;
+
+    struct gpio_line_pulses lines[GPIO_MAX_LINES];
+};
+
+// Lines that had edges since the latch mode was last cleared
+struct gpio_latch {
+    uint64_t rising;
+    uint64_t falling;
+};
+
+struct gpio_pin;
+
+// An output that a subscriber drives from C before it's notified. The input is
+// active when any of the subscriber's lines is high or, with a match, while
+// the pattern matches. Like the settle window, this is only touched by
+// whatever delivers changes.
+struct gpio_reflex {
+    enum reflex_rule rule;
+
+    // The output handle and which of its lines to drive. The subscriber holds
+    // a reference to the output.
+    struct gpio_pin *output;
+    uint64_t output_mask;
+
+    // For REFLEX_PULSE, how long to drive the lines high and when to stop (0
+    // if not pulsing)
+    int64_t pulse_ns;
+    int64_t pulse_end;
+
+    // Whether the input was active after the last change
+    bool active;
+};
+
+struct gpio_sub;
+
+// A subscription mode processes changes in the NIF instead of sending them.
+// Its state is allocated with the subscriber and is guarded by the
+// subscriber's lock since it can be read from a NIF while changes are being
+// delivered.
+struct gpio_mode {
+    const char *name;
+    size_t state_size;
+
+    // Parse mode-specific options. Return false if they're bad.
+    bool (*init)(ErlNifEnv *env, struct gpio_sub *sub, int num_lines, ERL_NIF_TERM options);
+
+    // Handle a change. Called for every change to the group.
+    void (*update)(ErlNifEnv *env, ErlNifEnv *msg_env, struct gpio_sub *sub, const struct gpio_change *change);
+
+    // Optional: when service is next needed and what to do then
+    int64_t (*deadline)(const struct gpio_sub *sub);
+    void (*service)(ErlNifEnv *env, ErlNifEnv *msg_env, struct gpio_sub *sub, int64_t now);
+
+    // Return a map with the mode's state, optionally resetting it
+    ERL_NIF_TERM (*read)(ErlNifEnv *env, struct gpio_sub *sub, bool clear);
+
+    // Optional: free anything that the state points to
+    void (*dtor)(struct gpio_sub *sub);
+};
+
+// One subscriber to a handle's change notifications.
+//
+// Subscribers are reference counted resources. The handle holds one reference
+// and the cdev poller thread holds another while it's listening, so both can
+// use the subscriber without copying it. The configuration is set when the
+// subscriber is created and not changed afterwards. The delivery state (settle
+// window, timeout, `dead`) is only touched by whatever delivers changes: the
+// poller thread for cdev and the stub under its lock.
+struct gpio_sub {
+    // Who gets notifications. This is the one part of the configuration that
+    // can change. transfer swaps it while changes are being delivered, so
+    // it's atomic.
+    _Atomic ErlNifPid pid;
+
+    // Edge(s) to send notifications for
+    enum trigger_mode emit_trigger;
+
+    // Bits of the group whose changes go to this subscriber. Routing each line
+    // of a group to a different process uses one subscriber per destination.
+    uint64_t line_mask;
+
+    // true  -> subscribe map format using notify_term as the ref
+    // false -> legacy set_interrupts tuple format using notify_term as the spec
+    bool notify_map;
+
+    // When has_match is set, only report when (value & match_mask) starts or
+    // stops being match_pattern. emit_trigger then selects entering (rising),
+    // leaving (falling), or both.
+    bool has_match;
+    uint64_t match_mask;
+    uint64_t match_pattern;
+
+    // Environment that owns notify_term
+    ErlNifEnv *env;
+    ERL_NIF_TERM notify_term;
+
+    // For merged subscriptions, the shared reorder buffer (NULL otherwise) and
+    // this handle's index in the merged list. Notifications include a `source`
+    // key when source >= 0.
+    struct gpio_merge *merge;
+    int source;
+
+    // When non-zero, edges within settle_ns of the first one are merged into
+    // one notification. The merged change is held in `pending` until the
+    // window ends. Only the thread delivering changes touches these.
+    int64_t settle_ns;
+    bool settle_pending;
+    int64_t settle_start;
+    struct gpio_change pending;
+
+    // When non-zero, send a timeout notification if no edge happens on
+    // line_mask for timeout_ns. last_value is the most recent group value for
+    // putting in that notification.
+    int64_t timeout_ns;
+    int64_t last_activity;
+    bool timed_out;
+    uint64_t last_value;
+
+    // When non-zero, a line's edges are held until it has been stable for
+    // debounce_ns and then its value is confirmed by re-reading it. debounced
+    // is the last value reported, debounce_pending has the lines waiting, and
+    // debounce_edges has the time of each line's last edge.
+    int64_t debounce_ns;
+    uint64_t debounced;
+    uint64_t debounce_pending;
+    int64_t *debounce_edges;
+
+    // Output to drive on changes. rule is REFLEX_NONE if there isn't one.
+    struct gpio_reflex reflex;
+
+    // Set when a send fails because the receiving process has exited
+    bool dead;
+
+    // Handle that the subscriber was added with. This is only compared, so it
+    // isn't a reference. It's a sub-handle when the subscriber is listed on
+    // its parent.
+    const struct gpio_pin *owner;
+
+    // For subscribers on sub-handles, bit i of what this subscriber sees is
+    // bit view_bits[i] of the line request's value. Changes are converted
+    // before anything else looks at them. num_view_lines is 0 otherwise.
+    int num_view_lines;
+    uint8_t view_bits[GPIO_MAX_LINES];
+
+    // Subscription mode or NULL to send change notifications. The lock is
+    // only created for modes.
+    const struct gpio_mode *mode;
+    ErlNifMutex *lock;
+    void *state;
 };
 
 struct gpio_pin {
@@ -92,7 +403,8 @@ struct gpio_pin {
     int offsets[GPIO_MAX_LINES];
 
     // cdev: the file descriptor for the whole line request. stub: >= 0 marks
-    // the group as open.
+    // the group as open. Sub-handles use their parent's and set this to 0
+    // while they're open.
     int fd;
     void *hal_priv;
     struct gpio_config config;
@@ -107,18 +419,79 @@ struct gpio_pin {
     // Echoed in legacy set_interrupts notifications ({:circuits_gpio, spec, ...})
     ERL_NIF_TERM gpio_spec;
 
-    // Echoed in subscribe notifications ({:circuits_gpio, %{ref: ..., ...}}).
-    // This is the make_ref() (or caller-supplied tag) returned by subscribe/2.
-    ERL_NIF_TERM notify_id;
-
-    // true  -> subscribe map format using notify_id
-    // false -> legacy set_interrupts tuple format using gpio_spec
-    bool notify_map;
+    // Subscribers to change notifications. The handle owns a reference to
+    // each one. A legacy set_interrupts subscriber is always the only one.
+    int num_subs;
+    struct gpio_sub *subs[MAX_GPIO_SUBSCRIBERS];
 
     // Linked into gpio_priv.gpio_pins while the resource is alive. This lets
     // force_close release handles even when their Erlang terms are unavailable.
     struct gpio_pin *next;
     bool registered;
+
+    // Sub-handles share a subset of their parent's line request so that
+    // several processes can use it. They hold a reference to the parent and
+    // have no fd, subscribers or lock of their own. Bit i of a sub-handle's
+    // value is bit parent_bits[i] of the parent's. parent is NULL for handles
+    // that own their line request.
+    struct gpio_pin *parent;
+    uint8_t parent_bits[GPIO_MAX_LINES];
+
+    // Serializes subscriber changes from processes sharing the line request
+    ErlNifMutex *lock;
+
+    // Threads that use the fd without the lock, like capture subscribers,
+    // count themselves here. Closing sets closing and waits for them.
+    atomic_int fd_users;
+    atomic_bool closing;
+};
+
+struct gpio_task;
+
+// A kind of background task. Tasks drive and sample GPIOs from their own
+// thread so that their timing doesn't depend on BEAM scheduling.
+struct gpio_task_type {
+    const char *name;
+    size_t state_size;
+
+    // Runs on the task's thread. Return when gpio_task_wait returns false or
+    // there's an error.
+    void (*run)(struct gpio_task *task);
+
+    // Optional: free anything that the state points to
+    void (*dtor)(struct gpio_task *task);
+};
+
+// A background task. Tasks are resources. The thread doesn't hold a reference
+// so that the task is stopped when Erlang garbage collects it.
+struct gpio_task {
+    const struct gpio_task_type *type;
+
+    // Who gets the task's messages and the ref/tag to put in them. env holds
+    // notify_term and any other terms that the task needs to keep.
+    ErlNifPid pid;
+    ErlNifEnv *env;
+    ERL_NIF_TERM notify_term;
+
+    // Handles used by the task. The task holds a reference to each one.
+    int num_pins;
+    struct gpio_pin *pins[GPIO_TASK_MAX_PINS];
+
+    // Guards the parts of the state that NIFs read or change while the task
+    // is running
+    ErlNifMutex *lock;
+
+    // Written to interrupt gpio_task_wait
+    int wake_fds[2];
+    atomic_bool stopping;
+
+    bool started;
+    ErlNifTid tid;
+
+    // For building messages on the task's thread
+    ErlNifEnv *msg_env;
+
+    void *state;
 };
 
 // Atoms
@@ -134,6 +507,10 @@ extern ERL_NIF_TERM atom_ref;
 extern ERL_NIF_TERM atom_timestamp;
 extern ERL_NIF_TERM atom_value;
 extern ERL_NIF_TERM atom_previous_value;
+extern ERL_NIF_TERM atom_changed;
+extern ERL_NIF_TERM atom_event;
+extern ERL_NIF_TERM atom_source;
+extern ERL_NIF_TERM atom_position;
 
 // HAL
 
@@ -211,6 +588,21 @@ int hal_read_gpio(struct gpio_pin *pin, uint64_t *value);
  */
 int hal_write_gpio(struct gpio_pin *pin, uint64_t value, ErlNifEnv *env);
 
+/**
+ * Change some of the lines of a GPIO group
+ *
+ * Unlike hal_write_gpio, this can also be called while a change is being
+ * delivered, i.e., from service_gpio_subs and dispatch_gpio_change. Reflexes
+ * use this to drive their outputs.
+ *
+ * @param pin which group
+ * @param mask the lines to change (bit i == offsets[i])
+ * @param value the values for those lines
+ * @param env ErlNifEnv if this causes an event to be sent (NULL from a custom thread)
+ * @return 0 on success, -errno on failure
+ */
+int hal_write_gpio_masked(struct gpio_pin *pin, uint64_t mask, uint64_t value, ErlNifEnv *env);
+
 /**
  * Apply GPIO direction settings
  *
@@ -249,6 +641,23 @@ int hal_apply_pull_mode(struct gpio_pin *pin);
  */
 int hal_apply_drive_mode(struct gpio_pin *pin);
 
+/**
+ * Return the current time on the clock used for event timestamps
+ *
+ * @return nanoseconds
+ */
+int64_t hal_timestamp(void);
+
+/**
+ * Sleep until a time on the event timestamp clock
+ *
+ * This is for background tasks that need to time their writes and reads more
+ * accurately than poll(2)'s millisecond timeouts allow.
+ *
+ * @param deadline when to return (see hal_timestamp)
+ */
+void hal_sleep_until(int64_t deadline);
+
 /**
  * Return a map that has runtime information about a GPIO
  *
@@ -267,6 +676,86 @@ ERL_NIF_TERM make_errno_error(ErlNifEnv *env, int errno_value);
 ERL_NIF_TERM make_string_binary(ErlNifEnv *env, const char *str);
 int enif_get_boolean(ErlNifEnv *env, ERL_NIF_TERM term, bool *v);
 
+/**
+ * Get an optional integer from an options map
+ *
+ * @param env the environment of the map
+ * @param map the options map
+ * @param key the option's name
+ * @param min the smallest allowed value
+ * @param max the largest allowed value
+ * @param value where to store the value. It's left alone if the option isn't set.
+ * @return false if the option is set to something invalid
+ */
+bool get_option_int64(ErlNifEnv *env, ERL_NIF_TERM map, const char *key, int64_t min, int64_t max, int64_t *value);
+
+/**
+ * Get a handle from its resource term
+ *
+ * @param env the environment of the term
+ * @param term the term
+ * @param pin where to store the handle
+ * @return true on success
+ */
+bool get_gpio_pin(ErlNifEnv *env, ERL_NIF_TERM term, struct gpio_pin **pin);
+
+/**
+ * Get the handle that owns a handle's line request
+ *
+ * This is the parent for sub-handles and the handle itself otherwise. Check
+ * its config rather than a sub-handle's since that's a copy from when the
+ * sub-handle was opened.
+ *
+ * @param pin the handle
+ * @return the handle with the line request
+ */
+struct gpio_pin *line_request(struct gpio_pin *pin);
+
+/**
+ * Read a sub-handle's lines from its parent's line request
+ *
+ * The HALs call this from hal_read_gpio for handles with a parent.
+ *
+ * @param pin the sub-handle
+ * @param value where to store the value (bit i == offsets[i])
+ * @return 0 on success, -errno on failure
+ */
+int read_sub_handle(struct gpio_pin *pin, uint64_t *value);
+
+/**
+ * Keep a handle's line request from being closed while using it
+ *
+ * This is for threads that read or write a handle that they didn't get from
+ * a NIF call, so close can run at the same time. Call release_gpio_fd when
+ * done. Don't block while holding it since close waits.
+ *
+ * @param pin the handle
+ * @return false if the handle is closed or closing
+ */
+bool keep_gpio_fd(struct gpio_pin *pin);
+
+/**
+ * Let a handle kept with keep_gpio_fd be closed again
+ *
+ * @param pin the handle
+ */
+void release_gpio_fd(struct gpio_pin *pin);
+
+/**
+ * Change some of a sub-handle's lines with a masked write to its parent
+ *
+ * The kernel only changes the lines in the mask, so processes writing to
+ * different sub-handles don't need to coordinate. The HALs call this from
+ * hal_write_gpio and hal_write_gpio_masked for handles with a parent.
+ *
+ * @param pin the sub-handle
+ * @param mask the lines to change (bit i == offsets[i])
+ * @param value the values for those lines
+ * @param env ErlNifEnv if this causes an event to be sent (NULL from a custom thread)
+ * @return 0 on success, -errno on failure
+ */
+int write_sub_handle(struct gpio_pin *pin, uint64_t mask, uint64_t value, ErlNifEnv *env);
+
 /**
  * Send a GPIO interrupt message to a process
  *
@@ -292,7 +781,8 @@ int send_gpio_message(ErlNifEnv *env,
  * Send a GPIO change notification (subscribe/2 map format) to a process
  *
  * Builds {:circuits_gpio, %{ref: notify_id, timestamp: ts, value: value,
- * previous_value: previous_value}}.
+ * previous_value: previous_value}}. Merged changes also include a `changed`
+ * key with the lines that had edges.
  *
  * @param env the caller's environment: the process bound environment when
  *            called from a NIF or NULL when called from a custom thread
@@ -301,48 +791,302 @@ int send_gpio_message(ErlNifEnv *env,
  *                reused.
  * @param notify_id the ref/tag term to echo (may be from another environment)
  * @param pid who to notify
- * @param timestamp event timestamp in nanoseconds
- * @param value the new group value
- * @param previous_value the group value before this change
+ * @param change what changed
+ * @param merged true to include the changed lines
+ * @param source index of the handle for merged subscriptions or -1
  * @return true on success (see enif_send)
  */
 int send_gpio_change(ErlNifEnv *env,
                      ErlNifEnv *msg_env,
                      ERL_NIF_TERM notify_id,
                      ErlNifPid *pid,
-                     int64_t timestamp,
-                     uint64_t value,
-                     uint64_t previous_value);
+                     const struct gpio_change *change,
+                     bool merged,
+                     int source);
 
 /**
- * Decide whether a single-line edge should produce a notification and, if so,
- * send it in the right format.
+ * Send a mode event notification to a subscriber
+ *
+ * Builds {:circuits_gpio, %{ref: notify_term, event: event, timestamp: ts}}
+ * plus any keys already in `map`. Marks the subscriber dead if the send
+ * fails.
+ *
+ * @param env caller env (NULL from a custom thread)
+ * @param msg_env reusable message environment. It's cleared before this
+ *                returns.
+ * @param sub the subscriber
+ * @param event an atom for the event type
+ * @param timestamp when it happened
+ * @param map a map made in msg_env with event-specific keys
+ * @return true on success (see enif_send)
+ */
+int send_gpio_event(ErlNifEnv *env,
+                    ErlNifEnv *msg_env,
+                    struct gpio_sub *sub,
+                    ERL_NIF_TERM event,
+                    int64_t timestamp,
+                    ERL_NIF_TERM map);
+
+// gpio_modes.c
+
+/**
+ * Look up a subscription mode by name
+ *
+ * @param env the environment for the name
+ * @param name an atom
+ * @return the mode or NULL if unknown
+ */
+const struct gpio_mode *find_gpio_mode(ErlNifEnv *env, ERL_NIF_TERM name);
+
+extern const struct gpio_mode gpio_latch_mode;
+
+// gpio_decoders.c
+extern const struct gpio_mode gpio_wiegand_mode;
+extern const struct gpio_mode gpio_nec_mode;
+extern const struct gpio_mode gpio_dht_mode;
+
+/**
+ * Notify every interested subscriber of a change
  *
  * Shared by the stub HAL (which has the gpio_pin) and the cdev poller thread
- * (which has copied monitor state). The caller is responsible for tracking the
- * shadow value and passing new/previous values.
+ * (which holds its own references to the subscribers). The caller is
+ * responsible for tracking the shadow value and filling in the change.
+ * Subscribers whose process has exited are marked dead and skipped from then
+ * on. Subscribers with a settle time hold on to the change until
+ * service_gpio_subs is called after their window ends.
  *
  * @param env caller env (NULL from a custom thread)
  * @param msg_env reusable message environment
- * @param notify_map true => subscribe map format; false => legacy tuple format
- * @param notify_term gpio_spec (legacy) or ref/tag (map) to echo
- * @param pid who to notify
- * @param emit_trigger which edge(s) the caller wants notifications for
- * @param timestamp event timestamp in nanoseconds
- * @param new_value the new group value
- * @param previous_value the group value before this change
- * @param changed_bit index of the bit that changed
- * @return true on success or when no message was needed; false on send failure
+ * @param subs the subscribers
+ * @param num_subs how many subscribers
+ * @param change what changed
+ * @return true if at least one subscriber is still alive
  */
-bool emit_gpio_change(ErlNifEnv *env,
-                      ErlNifEnv *msg_env,
-                      bool notify_map,
-                      ERL_NIF_TERM notify_term,
-                      ErlNifPid *pid,
-                      enum trigger_mode emit_trigger,
-                      int64_t timestamp,
-                      uint64_t new_value,
-                      uint64_t previous_value,
-                      int changed_bit);
+bool dispatch_gpio_change(ErlNifEnv *env,
+                          ErlNifEnv *msg_env,
+                          struct gpio_sub *const *subs,
+                          int num_subs,
+                          const struct gpio_change *change);
+
+/**
+ * Run subscriber timers that are due
+ *
+ * This reports debounced edges, sends merged changes whose settle windows
+ * have ended, ends reflex pulses, and sends inactivity timeouts.
+ *
+ * @param env caller env (NULL from a custom thread)
+ * @param msg_env reusable message environment
+ * @param subs the subscribers
+ * @param num_subs how many subscribers
+ * @param now the current time on the event timestamp clock (see hal_timestamp)
+ * @param value the group's value read from the hardware to confirm debounced
+ *              edges or NULL to use the value from the edges seen
+ */
+void service_gpio_subs(ErlNifEnv *env,
+                       ErlNifEnv *msg_env,
+                       struct gpio_sub *const *subs,
+                       int num_subs,
+                       int64_t now,
+                       const uint64_t *value);
+
+/**
+ * Return when service_gpio_subs next needs to be called
+ *
+ * @param subs the subscribers
+ * @param num_subs how many subscribers
+ * @return a time on the event timestamp clock or INT64_MAX if nothing's pending
+ */
+int64_t gpio_subs_deadline(struct gpio_sub *const *subs, int num_subs);
+
+// gpio_analyzer.c
+
+struct gpio_analyzer;
+
+void gpio_analyzer_dtor(ErlNifEnv *env, void *obj);
+
+/**
+ * Allocate a logic analyzer capture
+ *
+ * @param env the caller's environment
+ * @param num_sources how many handles will be attached
+ * @param options map with max_edges, pre_trigger, and trigger
+ * @return the capture or NULL if the options are bad or memory ran out
+ */
+struct gpio_analyzer *alloc_gpio_analyzer(ErlNifEnv *env, int num_sources, ERL_NIF_TERM options);
+
+/**
+ * Connect a subscriber in gpio_analyzer_mode to a capture
+ *
+ * The subscriber keeps a reference to the capture. The handle is read to get
+ * its value at the start.
+ *
+ * @param sub the subscriber
+ * @param analyzer the capture
+ * @param source the handle's index in the capture
+ * @param pin the handle
+ */
+void attach_gpio_analyzer(struct gpio_sub *sub, struct gpio_analyzer *analyzer, int source, struct gpio_pin *pin);
+
+extern const struct gpio_mode gpio_analyzer_mode;
+
+ERL_NIF_TERM capture_stop(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+// gpio_recorder.c
+
+/**
+ * Create a flight recorder file for a subscriber in gpio_recorder_mode
+ *
+ * @param sub the subscriber
+ * @param pin the handle whose edges are recorded
+ * @param path where to create the file. It's replaced if it exists.
+ * @param capacity how many edges the ring holds
+ * @return 0 on success, -errno on failure
+ */
+int open_gpio_recorder(struct gpio_sub *sub, const struct gpio_pin *pin, const char *path, uint32_t capacity);
+
+extern const struct gpio_mode gpio_recorder_mode;
+
+// gpio_tasks.c
+
+void gpio_task_dtor(ErlNifEnv *env, void *obj);
+
+/**
+ * Allocate a background task
+ *
+ * The task's state is zeroed. Add handles with add_gpio_task_pin, fill in the
+ * state, and then call start_gpio_task.
+ *
+ * @param env the caller's environment
+ * @param type what kind of task
+ * @param pid who gets the task's messages
+ * @param notify_term the ref/tag to put in messages
+ * @return the task or NULL if out of resources
+ */
+struct gpio_task *alloc_gpio_task(ErlNifEnv *env,
+                                  const struct gpio_task_type *type,
+                                  const ErlNifPid *pid,
+                                  ERL_NIF_TERM notify_term);
+
+/**
+ * Let a task use a handle
+ *
+ * @return false if the task already has GPIO_TASK_MAX_PINS handles
+ */
+bool add_gpio_task_pin(struct gpio_task *task, struct gpio_pin *pin);
+
+/**
+ * Start the task's thread
+ *
+ * @return 0 on success, -errno on failure
+ */
+int start_gpio_task(struct gpio_task *task);
+
+/**
+ * Stop the task's thread and wait for it to exit
+ *
+ * This can be called more than once.
+ */
+void stop_gpio_task(struct gpio_task *task);
+
+/**
+ * Wake up a task that's in gpio_task_wait
+ *
+ * Call this after changing the task's state from a NIF.
+ */
+void wake_gpio_task(struct gpio_task *task);
+
+/**
+ * Wait until a deadline or until the task is woken up
+ *
+ * Call this from the task's thread. Waking up early is normal, so callers
+ * should check the time if it matters.
+ *
+ * @param task the task
+ * @param deadline a time on the event timestamp clock or INT64_MAX to wait
+ *                 until woken up
+ * @return false if the task should stop
+ */
+bool gpio_task_wait(struct gpio_task *task, int64_t deadline);
+
+/**
+ * Read a handle from the task's thread
+ *
+ * The handle's owner can close it while the task is running. This keeps it
+ * open during the read and returns -EBADF once it's closed so that the task
+ * stops with an error.
+ *
+ * @return 0 on success, -errno on failure
+ */
+int task_read_gpio(struct gpio_pin *pin, uint64_t *value);
+
+/**
+ * Write some of a handle's lines from the task's thread
+ *
+ * See task_read_gpio for what happens when the handle is closed.
+ *
+ * @return 0 on success, -errno on failure
+ */
+int task_write_gpio_masked(struct gpio_pin *pin, uint64_t mask, uint64_t value);
+
+/**
+ * Send a message from the task's thread
+ *
+ * Builds {:circuits_gpio, %{ref: notify_term, event: event, timestamp: ts}}
+ * plus the keys in `map`, which must be made in task->msg_env.
+ *
+ * @return true on success (see enif_send)
+ */
+int send_task_event(struct gpio_task *task, ERL_NIF_TERM event, int64_t timestamp, ERL_NIF_TERM map);
+
+/**
+ * Send an error message from the task's thread
+ *
+ * The message is an `:error` event with a `reason`.
+ *
+ * @param rc a -errno value
+ */
+void send_task_error(struct gpio_task *task, int rc);
+
+/**
+ * Get a task of a particular type from its resource term
+ *
+ * @return true on success
+ */
+bool get_gpio_task(ErlNifEnv *env, ERL_NIF_TERM term, const struct gpio_task_type *type, struct gpio_task **task);
+
+ERL_NIF_TERM task_stop(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+// gpio_keypad.c
+ERL_NIF_TERM keypad_start(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM keypad_pressed(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+// gpio_pwm.c
+ERL_NIF_TERM pwm_start(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM pwm_set(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM pwm_get(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+// gpio_stepper.c
+ERL_NIF_TERM stepper_start(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM stepper_move(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM stepper_halt(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM stepper_status(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+// gpio_sequencer.c
+ERL_NIF_TERM sequencer_start(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+// gpio_shift.c
+ERL_NIF_TERM shift_transfer(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+// gpio_onewire.c
+ERL_NIF_TERM onewire_transfer(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM onewire_search(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+// gpio_heartbeat.c
+ERL_NIF_TERM heartbeat_start(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM heartbeat_feed(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+// gpio_api.c
+void init_gpio_api(struct gpio_priv *priv);
+ERL_NIF_TERM c_api(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
 
 #endif // GPIO_NIF_H
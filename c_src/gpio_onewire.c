@@ -0,0 +1,347 @@
+// SPDX-FileCopyrightText: 2026 Frank Hunleth
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Bit-banged 1-Wire bus master
+//
+// The bus is the first line of an open-drain output handle. Writing 1
+// releases the bus so that the pull-up or a device can set its level.
+// Slot timings are the standard speed values from Maxim's application note
+// 126. Each slot is timed from when it started with a spin loop.
+
+#include "gpio_nif.h"
+
+#include <errno.h>
+#include <string.h>
+
+#define OW_A_NS 6000
+#define OW_B_NS 64000
+#define OW_C_NS 60000
+#define OW_D_NS 10000
+#define OW_E_NS 9000
+#define OW_F_NS 55000
+#define OW_H_NS 480000
+#define OW_I_NS 70000
+#define OW_J_NS 410000
+
+#define OW_SEARCH_ROM 0xf0
+#define OW_ALARM_SEARCH 0xec
+
+#define OW_MAX_DEVICES 128
+
+// A slot that's stretched by preemption corrupts a bit, so search steps that
+// fail are retried
+#define OW_SEARCH_RETRIES 3
+
+// Returned when no device answers a reset or when the bus is stuck low
+#define OW_NO_PRESENCE 1
+#define OW_BUS_LOW 2
+
+struct onewire {
+    struct gpio_pin *pin;
+    ErlNifEnv *env;
+};
+
+static void ow_spin_until(int64_t deadline)
+{
+    while (hal_timestamp() < deadline)
+        ;
+}
+
+static int ow_drive(const struct onewire *ow, int level)
+{
+    return hal_write_gpio_masked(ow->pin, 1, level, ow->env);
+}
+
+static int ow_sample(const struct onewire *ow, int *level)
+{
+    uint64_t value;
+    int rc = hal_read_gpio(ow->pin, &value);
+    *level = (int) (value & 1);
+    return rc;
+}
+
+// Returns 0 if a device answered, OW_NO_PRESENCE if not, OW_BUS_LOW if the
+// bus is shorted or missing its pull-up, or -errno
+static int ow_reset(const struct onewire *ow)
+{
+    int presence;
+    int rc;
+
+    if ((rc = ow_drive(ow, 1)) < 0 || (rc = ow_sample(ow, &presence)) < 0)
+        return rc;
+    if (!presence)
+        return OW_BUS_LOW;
+
+    int64_t start = hal_timestamp();
+    if ((rc = ow_drive(ow, 0)) < 0)
+        return rc;
+    ow_spin_until(start + OW_H_NS);
+    if ((rc = ow_drive(ow, 1)) < 0)
+        return rc;
+    ow_spin_until(start + OW_H_NS + OW_I_NS);
+    if ((rc = ow_sample(ow, &presence)) < 0)
+        return rc;
+    ow_spin_until(start + OW_H_NS + OW_I_NS + OW_J_NS);
+
+    // Devices pull the bus low to show that they're there
+    return presence ? OW_NO_PRESENCE : 0;
+}
+
+static int ow_write_bit(const struct onewire *ow, int bit)
+{
+    int64_t start = hal_timestamp();
+    int64_t low_ns = bit ? OW_A_NS : OW_C_NS;
+    int64_t high_ns = bit ? OW_B_NS : OW_D_NS;
+    int rc;
+
+    if ((rc = ow_drive(ow, 0)) < 0)
+        return rc;
+    ow_spin_until(start + low_ns);
+    if ((rc = ow_drive(ow, 1)) < 0)
+        return rc;
+    ow_spin_until(start + low_ns + high_ns);
+    return 0;
+}
+
+static int ow_read_bit(const struct onewire *ow, int *bit)
+{
+    int64_t start = hal_timestamp();
+    int rc;
+
+    if ((rc = ow_drive(ow, 0)) < 0)
+        return rc;
+    ow_spin_until(start + OW_A_NS);
+    if ((rc = ow_drive(ow, 1)) < 0)
+        return rc;
+    ow_spin_until(start + OW_A_NS + OW_E_NS);
+    if ((rc = ow_sample(ow, bit)) < 0)
+        return rc;
+    ow_spin_until(start + OW_A_NS + OW_E_NS + OW_F_NS);
+    return 0;
+}
+
+// Bytes go least significant bit first
+static int ow_write_byte(const struct onewire *ow, uint8_t byte)
+{
+    for (int i = 0; i < 8; i++) {
+        int rc = ow_write_bit(ow, (byte >> i) & 1);
+        if (rc < 0)
+            return rc;
+    }
+    return 0;
+}
+
+static int ow_read_byte(const struct onewire *ow, uint8_t *byte)
+{
+    uint8_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        int bit;
+        int rc = ow_read_bit(ow, &bit);
+        if (rc < 0)
+            return rc;
+        value |= (uint8_t) (bit << i);
+    }
+    *byte = value;
+    return 0;
+}
+
+// Dallas/Maxim CRC-8 (x^8 + x^5 + x^4 + 1). A block that ends with its CRC
+// has a CRC of 0.
+static uint8_t onewire_crc8(const uint8_t *data, size_t len)
+{
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        uint8_t byte = data[i];
+        for (int j = 0; j < 8; j++) {
+            uint8_t mix = (crc ^ byte) & 1;
+            crc >>= 1;
+            if (mix)
+                crc ^= 0x8c;
+            byte >>= 1;
+        }
+    }
+    return crc;
+}
+
+// Find the next ROM in a search. See Maxim's application note 187.
+//
+// Returns 0 when rom has the next ROM, OW_NO_PRESENCE when there aren't any
+// more, -EIO if the devices stop answering, -EBADMSG on a CRC error, or
+// -errno.
+static int ow_search_next(const struct onewire *ow, uint8_t command, uint8_t rom[8], int *last_discrepancy)
+{
+    int last_zero = 0;
+    int rc;
+
+    if (*last_discrepancy < 0)
+        return OW_NO_PRESENCE;
+
+    if ((rc = ow_reset(ow)) != 0)
+        return rc;
+    if ((rc = ow_write_byte(ow, command)) < 0)
+        return rc;
+
+    for (int n = 1; n <= 64; n++) {
+        int byte = (n - 1) / 8;
+        uint8_t mask = (uint8_t) (1 << ((n - 1) % 8));
+        int id_bit;
+        int cmp_bit;
+        int direction;
+
+        if ((rc = ow_read_bit(ow, &id_bit)) < 0 || (rc = ow_read_bit(ow, &cmp_bit)) < 0)
+            return rc;
+
+        if (id_bit && cmp_bit) {
+            // Nobody answered. Either the devices went away or it's an
+            // alarm search and none are alarming.
+            return n == 1 ? OW_NO_PRESENCE : -EIO;
+        } else if (id_bit != cmp_bit) {
+            direction = id_bit;
+        } else {
+            // Devices disagree. Retrace the previous path up to the last
+            // discrepancy and then take the 1 branch there.
+            if (n < *last_discrepancy)
+                direction = (rom[byte] & mask) != 0;
+            else
+                direction = (n == *last_discrepancy);
+
+            if (!direction)
+                last_zero = n;
+        }
+
+        if (direction)
+            rom[byte] |= mask;
+        else
+            rom[byte] &= (uint8_t) ~mask;
+
+        if ((rc = ow_write_bit(ow, direction)) < 0)
+            return rc;
+    }
+
+    if (onewire_crc8(rom, 8) != 0)
+        return -EBADMSG;
+
+    // -1 marks that this was the last device
+    *last_discrepancy = last_zero ? last_zero : -1;
+    return 0;
+}
+
+// Same as ow_search_next, but retry bus errors
+static int ow_search_retry(const struct onewire *ow, uint8_t command, uint8_t rom[8], int *last_discrepancy)
+{
+    uint8_t next_rom[8];
+    int next_discrepancy;
+    int rc;
+
+    for (int attempt = 0; attempt < OW_SEARCH_RETRIES; attempt++) {
+        memcpy(next_rom, rom, sizeof(next_rom));
+        next_discrepancy = *last_discrepancy;
+        rc = ow_search_next(ow, command, next_rom, &next_discrepancy);
+        if (rc != -EIO && rc != -EBADMSG)
+            break;
+    }
+
+    memcpy(rom, next_rom, sizeof(next_rom));
+    *last_discrepancy = next_discrepancy;
+    return rc;
+}
+
+static bool get_onewire(ErlNifEnv *env, ERL_NIF_TERM term, struct onewire *ow)
+{
+    if (!get_gpio_pin(env, term, &ow->pin) || ow->pin->num_lines != 1)
+        return false;
+
+    ow->env = env;
+    return true;
+}
+
+static ERL_NIF_TERM make_onewire_error(ErlNifEnv *env, int rc)
+{
+    if (rc == OW_NO_PRESENCE)
+        return enif_make_tuple2(env, atom_error, enif_make_atom(env, "no_presence"));
+    else if (rc == OW_BUS_LOW)
+        return enif_make_tuple2(env, atom_error, enif_make_atom(env, "bus_low"));
+    else if (rc == -EBADMSG)
+        return enif_make_tuple2(env, atom_error, enif_make_atom(env, "crc"));
+    else
+        return make_errno_error(env, rc);
+}
+
+static bool is_open_drain(const struct onewire *ow)
+{
+    const struct gpio_config *config = &line_request(ow->pin)->config;
+    return config->is_output && config->drive == DRIVE_OPEN_DRAIN;
+}
+
+ERL_NIF_TERM onewire_transfer(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+    struct onewire ow;
+    ErlNifBinary tx;
+    unsigned int read_count;
+    bool check_crc;
+
+    // onewire_transfer(gpio, write_data, read_count, check_crc)
+    if (argc != 4 ||
+            !get_onewire(env, argv[0], &ow) ||
+            !enif_inspect_binary(env, argv[1], &tx) ||
+            !enif_get_uint(env, argv[2], &read_count) ||
+            !enif_get_boolean(env, argv[3], &check_crc) ||
+            read_count > 65536)
+        return enif_make_badarg(env);
+
+    if (!is_open_drain(&ow))
+        return enif_make_tuple2(env, atom_error, enif_make_atom(env, "not_open_drain"));
+
+    ERL_NIF_TERM result;
+    uint8_t *rx = enif_make_new_binary(env, read_count, &result);
+
+    int rc = ow_reset(&ow);
+    for (size_t i = 0; rc == 0 && i < tx.size; i++)
+        rc = ow_write_byte(&ow, tx.data[i]);
+    for (unsigned int i = 0; rc == 0 && i < read_count; i++)
+        rc = ow_read_byte(&ow, &rx[i]);
+
+    if (rc == 0 && check_crc && read_count > 0 && onewire_crc8(rx, read_count) != 0)
+        rc = -EBADMSG;
+
+    if (rc != 0)
+        return make_onewire_error(env, rc);
+
+    return make_ok_tuple(env, result);
+}
+
+ERL_NIF_TERM onewire_search(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+    struct onewire ow;
+    bool alarm;
+
+    // onewire_search(gpio, alarm)
+    if (argc != 2 ||
+            !get_onewire(env, argv[0], &ow) ||
+            !enif_get_boolean(env, argv[1], &alarm))
+        return enif_make_badarg(env);
+
+    if (!is_open_drain(&ow))
+        return enif_make_tuple2(env, atom_error, enif_make_atom(env, "not_open_drain"));
+
+    uint8_t command = alarm ? OW_ALARM_SEARCH : OW_SEARCH_ROM;
+    uint8_t rom[8];
+    int last_discrepancy = 0;
+    ERL_NIF_TERM roms[OW_MAX_DEVICES];
+    int count = 0;
+
+    memset(rom, 0, sizeof(rom));
+    while (count < OW_MAX_DEVICES) {
+        int rc = ow_search_retry(&ow, command, rom, &last_discrepancy);
+        if (rc == OW_NO_PRESENCE)
+            break;
+        else if (rc != 0)
+            return make_onewire_error(env, rc);
+
+        memcpy(enif_make_new_binary(env, sizeof(rom), &roms[count]), rom, sizeof(rom));
+        count++;
+    }
+
+    return make_ok_tuple(env, enif_make_list_from_array(env, roms, count));
+}
@@ -0,0 +1,243 @@
+// SPDX-FileCopyrightText: 2026 Frank Hunleth
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Software PWM
+//
+// Each line in an output handle is a channel with its own period and duty
+// cycle. One thread computes the next edge for every channel and applies all
+// edges that are due together with one masked write. Channels that share a
+// period start together, so their rising edges always merge.
+
+#include "gpio_nif.h"
+
+#include <errno.h>
+
+// Edges due within this long of the current one are applied with it
+#define PWM_MERGE_NS 20000LL
+
+#define PWM_MIN_PERIOD_NS 100000LL
+#define PWM_MAX_PERIOD_NS 10000000000LL
+#define PWM_DUTY_SCALE 1000000LL
+
+struct pwm_channel {
+    int64_t period_ns;
+    int64_t high_ns;
+
+    int64_t period_start;
+    int64_t next_edge;
+    bool high;
+    bool falling;
+
+    // Requested settings. These are applied at the start of the next period
+    // so that changes never make runt pulses. Guarded by the task lock.
+    int64_t new_period_ns;
+    int64_t new_duty;
+};
+
+struct gpio_pwm {
+    int num_channels;
+    struct pwm_channel channels[GPIO_MAX_LINES];
+};
+
+static void start_period(struct gpio_task *task, struct pwm_channel *channel, int64_t start)
+{
+    enif_mutex_lock(task->lock);
+    channel->period_ns = channel->new_period_ns;
+    channel->high_ns = channel->period_ns * channel->new_duty / PWM_DUTY_SCALE;
+    enif_mutex_unlock(task->lock);
+
+    channel->period_start = start;
+    channel->high = channel->high_ns > 0;
+    channel->falling = channel->high && channel->high_ns < channel->period_ns;
+    channel->next_edge = start + (channel->falling ? channel->high_ns : channel->period_ns);
+}
+
+// Move a channel past its next edge
+static void pwm_edge(struct gpio_task *task, struct pwm_channel *channel, int64_t now)
+{
+    if (channel->falling) {
+        channel->high = false;
+        channel->falling = false;
+        channel->next_edge = channel->period_start + channel->period_ns;
+        return;
+    }
+
+    // If the thread fell a whole period behind, start over from now rather
+    // than running periods back to back to catch up
+    int64_t start = channel->next_edge;
+    if (now - start >= channel->period_ns)
+        start = now;
+
+    start_period(task, channel, start);
+}
+
+static void pwm_run(struct gpio_task *task)
+{
+    struct gpio_pwm *pwm = task->state;
+    struct gpio_pin *pin = task->pins[0];
+    uint64_t all = (pwm->num_channels >= 64) ? ~(uint64_t) 0 : (((uint64_t) 1 << pwm->num_channels) - 1);
+    int64_t next = hal_timestamp();
+
+    // Start every channel low and at the same time
+    int rc = task_write_gpio_masked(pin, all, 0);
+    for (int i = 0; i < pwm->num_channels; i++) {
+        pwm->channels[i].high = false;
+        pwm->channels[i].falling = false;
+        pwm->channels[i].next_edge = next;
+    }
+
+    while (rc >= 0 && gpio_task_wait(task, next)) {
+        int64_t now = hal_timestamp();
+        uint64_t mask = 0;
+        uint64_t value = 0;
+
+        next = INT64_MAX;
+        for (int i = 0; i < pwm->num_channels; i++) {
+            struct pwm_channel *channel = &pwm->channels[i];
+
+            // Only one edge per channel per write so that short pulses
+            // aren't merged away
+            if (channel->next_edge <= now + PWM_MERGE_NS) {
+                bool was_high = channel->high;
+                pwm_edge(task, channel, now);
+                if (channel->high != was_high) {
+                    mask |= (uint64_t) 1 << i;
+                    if (channel->high)
+                        value |= (uint64_t) 1 << i;
+                }
+            }
+            if (channel->next_edge < next)
+                next = channel->next_edge;
+        }
+
+        if (mask)
+            rc = task_write_gpio_masked(pin, mask, value);
+    }
+
+    if (rc < 0)
+        send_task_error(task, rc);
+    else
+        task_write_gpio_masked(pin, all, 0);
+}
+
+static const struct gpio_task_type gpio_pwm_task = {
+    .name = "gpio_pwm",
+    .state_size = sizeof(struct gpio_pwm),
+    .run = pwm_run
+};
+
+static bool get_pwm_settings(ErlNifEnv *env, ERL_NIF_TERM term, int64_t *period_ns, int64_t *duty)
+{
+    const ERL_NIF_TERM *tuple;
+    int arity;
+    ErlNifSInt64 p;
+    ErlNifSInt64 d;
+
+    if (!enif_get_tuple(env, term, &arity, &tuple) || arity != 2 ||
+            !enif_get_int64(env, tuple[0], &p) ||
+            !enif_get_int64(env, tuple[1], &d) ||
+            p < PWM_MIN_PERIOD_NS || p > PWM_MAX_PERIOD_NS ||
+            d < 0 || d > PWM_DUTY_SCALE)
+        return false;
+
+    *period_ns = p;
+    *duty = d;
+    return true;
+}
+
+ERL_NIF_TERM pwm_start(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+    struct gpio_pin *pin;
+    ErlNifPid pid;
+    unsigned int num_channels;
+
+    // pwm_start(gpio, notify_id, pid, [{period_ns, duty}])
+    if (argc != 4 ||
+            !get_gpio_pin(env, argv[0], &pin) ||
+            !enif_get_local_pid(env, argv[2], &pid) ||
+            !enif_get_list_length(env, argv[3], &num_channels) ||
+            num_channels != (unsigned int) pin->num_lines)
+        return enif_make_badarg(env);
+
+    if (!line_request(pin)->config.is_output)
+        return enif_make_tuple2(env, atom_error, enif_make_atom(env, "pin_not_output"));
+
+    struct gpio_task *task = alloc_gpio_task(env, &gpio_pwm_task, &pid, argv[1]);
+    if (!task)
+        return make_errno_error(env, -ENOMEM);
+
+    struct gpio_pwm *pwm = task->state;
+    pwm->num_channels = num_channels;
+    add_gpio_task_pin(task, pin);
+
+    ERL_NIF_TERM list = argv[3];
+    ERL_NIF_TERM head;
+    for (int i = 0; enif_get_list_cell(env, list, &head, &list); i++) {
+        struct pwm_channel *channel = &pwm->channels[i];
+        if (!get_pwm_settings(env, head, &channel->new_period_ns, &channel->new_duty)) {
+            enif_release_resource(task);
+            return enif_make_badarg(env);
+        }
+    }
+
+    int rc = start_gpio_task(task);
+    if (rc < 0) {
+        enif_release_resource(task);
+        return make_errno_error(env, rc);
+    }
+
+    ERL_NIF_TERM task_term = enif_make_resource(env, task);
+    enif_release_resource(task);
+
+    return make_ok_tuple(env, task_term);
+}
+
+ERL_NIF_TERM pwm_set(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+    struct gpio_task *task;
+    int channel;
+    int64_t period_ns;
+    int64_t duty;
+
+    // pwm_set(task, channel, {period_ns, duty})
+    if (argc != 3 ||
+            !get_gpio_task(env, argv[0], &gpio_pwm_task, &task) ||
+            !enif_get_int(env, argv[1], &channel) ||
+            !get_pwm_settings(env, argv[2], &period_ns, &duty))
+        return enif_make_badarg(env);
+
+    struct gpio_pwm *pwm = task->state;
+    if (channel < 0 || channel >= pwm->num_channels)
+        return enif_make_badarg(env);
+
+    enif_mutex_lock(task->lock);
+    pwm->channels[channel].new_period_ns = period_ns;
+    pwm->channels[channel].new_duty = duty;
+    enif_mutex_unlock(task->lock);
+
+    return atom_ok;
+}
+
+ERL_NIF_TERM pwm_get(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+    struct gpio_task *task;
+    int channel;
+
+    // pwm_get(task, channel)
+    if (argc != 2 ||
+            !get_gpio_task(env, argv[0], &gpio_pwm_task, &task) ||
+            !enif_get_int(env, argv[1], &channel))
+        return enif_make_badarg(env);
+
+    struct gpio_pwm *pwm = task->state;
+    if (channel < 0 || channel >= pwm->num_channels)
+        return enif_make_badarg(env);
+
+    enif_mutex_lock(task->lock);
+    int64_t period_ns = pwm->channels[channel].new_period_ns;
+    int64_t duty = pwm->channels[channel].new_duty;
+    enif_mutex_unlock(task->lock);
+
+    return enif_make_tuple2(env, enif_make_int64(env, period_ns), enif_make_int64(env, duty));
+}
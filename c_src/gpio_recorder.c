@@ -0,0 +1,215 @@
+// SPDX-FileCopyrightText: 2026 Frank Hunleth
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Flight recorder
+//
+// A recorder writes every edge on a handle to a ring in a memory-mapped file.
+// Writes only touch memory, so it's cheap enough to leave on, and the kernel
+// keeps the file's pages when the BEAM crashes so that they can be read
+// afterwards. It's a subscriber in the recorder mode that never sends
+// messages.
+//
+// The file is a header followed by the ring. All integers are little endian.
+//
+// Header (128 bytes):
+//   0  magic "GPIOFR01"
+//   8  u32 version (1)
+//  12  u32 header size
+//  16  u32 record size
+//  20  u32 capacity (records in the ring)
+//  24  u64 write count (records ever written; the next goes in slot
+//      write_count % capacity)
+//  32  i64 CLOCK_REALTIME - CLOCK_MONOTONIC in nanoseconds when the recorder
+//      started
+//  40  u32 number of lines
+//  44  u32 reserved
+//  48  gpiochip path, NUL terminated (64 bytes)
+//  112 reserved
+//
+// Record (32 bytes):
+//   0  i64 timestamp (CLOCK_MONOTONIC nanoseconds)
+//   8  u64 group value after the edge
+//  16  u32 line request sequence number
+//  20  u32 line offset
+//  24  u8  1 for rising, 2 for falling
+//  25  reserved
+//
+// A record is written before the write count is updated, so records up to
+// the write count are always complete.
+
+#include "gpio_nif.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RECORDER_MAGIC "GPIOFR01"
+#define RECORDER_VERSION 1
+#define RECORDER_HEADER_SIZE 128
+#define RECORDER_RECORD_SIZE 32
+#define RECORDER_MAX_RECORDS (1 << 24)
+
+#define RECORDER_RISING 1
+#define RECORDER_FALLING 2
+
+struct gpio_recorder {
+    uint8_t *map;
+    size_t map_size;
+
+    uint32_t capacity;
+    uint64_t write_count;
+
+    int num_lines;
+    int offsets[GPIO_MAX_LINES];
+};
+
+static void put_le32(uint8_t *p, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        p[i] = (uint8_t) (value >> (8 * i));
+}
+
+static void put_le64(uint8_t *p, uint64_t value)
+{
+    for (int i = 0; i < 8; i++)
+        p[i] = (uint8_t) (value >> (8 * i));
+}
+
+static int64_t realtime_offset(void)
+{
+    struct timespec mono, real;
+    clock_gettime(CLOCK_MONOTONIC, &mono);
+    clock_gettime(CLOCK_REALTIME, &real);
+    return (real.tv_sec - mono.tv_sec) * 1000000000LL + (real.tv_nsec - mono.tv_nsec);
+}
+
+static void write_header(struct gpio_recorder *recorder, const struct gpio_pin *pin)
+{
+    uint8_t *h = recorder->map;
+
+    memset(h, 0, RECORDER_HEADER_SIZE);
+    memcpy(h, RECORDER_MAGIC, 8);
+    put_le32(h + 8, RECORDER_VERSION);
+    put_le32(h + 12, RECORDER_HEADER_SIZE);
+    put_le32(h + 16, RECORDER_RECORD_SIZE);
+    put_le32(h + 20, recorder->capacity);
+    put_le64(h + 24, 0);
+    put_le64(h + 32, (uint64_t) realtime_offset());
+    put_le32(h + 40, (uint32_t) pin->num_lines);
+    strncpy((char *) h + 48, pin->gpiochip, 63);
+}
+
+int open_gpio_recorder(struct gpio_sub *sub, const struct gpio_pin *pin, const char *path, uint32_t capacity)
+{
+    struct gpio_recorder *recorder = sub->state;
+
+    if (capacity == 0 || capacity > RECORDER_MAX_RECORDS)
+        return -EINVAL;
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return -errno;
+
+    size_t size = RECORDER_HEADER_SIZE + (size_t) capacity * RECORDER_RECORD_SIZE;
+    if (ftruncate(fd, (off_t) size) < 0) {
+        int rc = -errno;
+        close(fd);
+        return rc;
+    }
+
+    // The mapping keeps the file open
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return -errno;
+
+    recorder->map = map;
+    recorder->map_size = size;
+    recorder->capacity = capacity;
+    recorder->num_lines = pin->num_lines;
+    memcpy(recorder->offsets, pin->offsets, sizeof(recorder->offsets));
+
+    write_header(recorder, pin);
+    return 0;
+}
+
+static bool recorder_init(ErlNifEnv *env, struct gpio_sub *sub, int num_lines, ERL_NIF_TERM options)
+{
+    // The file is opened by recorder_start
+    return true;
+}
+
+static void record_edge(struct gpio_recorder *recorder, const struct gpio_change *change, int line, uint8_t edge)
+{
+    uint8_t *r = recorder->map + RECORDER_HEADER_SIZE +
+                 (recorder->write_count % recorder->capacity) * RECORDER_RECORD_SIZE;
+
+    put_le64(r, (uint64_t) change->timestamp);
+    put_le64(r + 8, change->value);
+    put_le32(r + 16, change->seqno);
+    put_le32(r + 20, (uint32_t) recorder->offsets[line]);
+    r[24] = edge;
+    memset(r + 25, 0, RECORDER_RECORD_SIZE - 25);
+
+    // Publish the record after it's written so that a reader never sees a
+    // partial one
+    recorder->write_count++;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    put_le64(recorder->map + 24, recorder->write_count);
+}
+
+static void recorder_update(ErlNifEnv *env, ErlNifEnv *msg_env, struct gpio_sub *sub, const struct gpio_change *change)
+{
+    struct gpio_recorder *recorder = sub->state;
+
+    if (!recorder->map)
+        return;
+
+    for (uint64_t bits = change->rising | change->falling; bits; bits &= bits - 1) {
+        int line = __builtin_ctzll(bits);
+        uint64_t bit = (uint64_t) 1 << line;
+
+        // A line that pulsed while edges were merged has both
+        if (change->rising & change->falling & bit) {
+            bool high = (change->value & bit) != 0;
+            record_edge(recorder, change, line, high ? RECORDER_FALLING : RECORDER_RISING);
+            record_edge(recorder, change, line, high ? RECORDER_RISING : RECORDER_FALLING);
+        } else {
+            record_edge(recorder, change, line, (change->rising & bit) ? RECORDER_RISING : RECORDER_FALLING);
+        }
+    }
+}
+
+static ERL_NIF_TERM recorder_read(ErlNifEnv *env, struct gpio_sub *sub, bool clear)
+{
+    struct gpio_recorder *recorder = sub->state;
+
+    ERL_NIF_TERM map = enif_make_new_map(env);
+    enif_make_map_put(env, map, enif_make_atom(env, "records"), enif_make_uint64(env, recorder->write_count), &map);
+    enif_make_map_put(env, map, enif_make_atom(env, "capacity"), enif_make_uint(env, recorder->capacity), &map);
+    return map;
+}
+
+static void recorder_dtor(struct gpio_sub *sub)
+{
+    struct gpio_recorder *recorder = sub->state;
+
+    if (recorder->map) {
+        msync(recorder->map, recorder->map_size, MS_ASYNC);
+        munmap(recorder->map, recorder->map_size);
+    }
+}
+
+// Not in the list of modes that subscribe/2 can use
+const struct gpio_mode gpio_recorder_mode = {
+    .name = "recorder",
+    .state_size = sizeof(struct gpio_recorder),
+    .init = recorder_init,
+    .update = recorder_update,
+    .read = recorder_read,
+    .dtor = recorder_dtor
+};
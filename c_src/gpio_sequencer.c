@@ -0,0 +1,350 @@
+// SPDX-FileCopyrightText: 2026 Frank Hunleth
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Bytecode sequencer
+//
+// Runs a short program of GPIO operations on its own thread so that
+// bit-banged transactions have consistent timing. Programs are checked
+// completely before they run. Values that are read are appended to one
+// result binary that's sent when the program finishes.
+//
+// Ops (all integers are little endian):
+//
+//   SEQ_WRITE       handle:u8 mask:u64 value:u64
+//   SEQ_READ        handle:u8
+//   SEQ_WAIT        ns:u32
+//   SEQ_WAIT_LEVEL  handle:u8 mask:u64 value:u64 timeout_ns:u32
+//   SEQ_LOOP        count:u32
+//   SEQ_END_LOOP
+//
+// Reads append (num_lines + 7) / 8 bytes for the handle. Waits are measured
+// from the end of the previous wait (or from when the level was seen for
+// SEQ_WAIT_LEVEL) so that the time spent writing and reading doesn't add up.
+
+#include "gpio_nif.h"
+
+#include <errno.h>
+#include <string.h>
+
+#define SEQ_WRITE 1
+#define SEQ_READ 2
+#define SEQ_WAIT 3
+#define SEQ_WAIT_LEVEL 4
+#define SEQ_LOOP 5
+#define SEQ_END_LOOP 6
+
+#define SEQ_MAX_LOOP_DEPTH 8
+#define SEQ_MAX_RESULT_SIZE (1024 * 1024)
+
+// Waits shorter than this spin since sleeping isn't that precise
+#define SEQ_SPIN_NS 100000LL
+
+struct seq_loop {
+    size_t start;
+    uint32_t remaining;
+};
+
+struct gpio_sequencer {
+    unsigned char *program;
+    size_t program_size;
+
+    unsigned char *result;
+    size_t result_size;
+    size_t result_len;
+};
+
+static uint32_t get_u32(const unsigned char *p)
+{
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint64_t get_u64(const unsigned char *p)
+{
+    return (uint64_t) get_u32(p) | ((uint64_t) get_u32(p + 4) << 32);
+}
+
+static size_t read_size(const struct gpio_pin *pin)
+{
+    return (pin->num_lines + 7) / 8;
+}
+
+static size_t op_size(unsigned char op)
+{
+    switch (op) {
+    case SEQ_WRITE: return 18;
+    case SEQ_READ: return 2;
+    case SEQ_WAIT: return 5;
+    case SEQ_WAIT_LEVEL: return 22;
+    case SEQ_LOOP: return 5;
+    case SEQ_END_LOOP: return 1;
+    default: return 0;
+    }
+}
+
+// Check a program and compute how big its result will be
+//
+// Returns 0 if ok, -EINVAL if malformed, -EPERM if it writes to an input
+static int check_program(const struct gpio_task *task, const unsigned char *program, size_t size, size_t *result_size)
+{
+    uint64_t multiplier[SEQ_MAX_LOOP_DEPTH + 1];
+    uint64_t total = 0;
+    int depth = 0;
+
+    multiplier[0] = 1;
+    for (size_t pc = 0; pc < size;) {
+        unsigned char op = program[pc];
+        size_t len = op_size(op);
+        if (len == 0 || pc + len > size)
+            return -EINVAL;
+
+        struct gpio_pin *pin = NULL;
+        if (op == SEQ_WRITE || op == SEQ_READ || op == SEQ_WAIT_LEVEL) {
+            if (program[pc + 1] >= task->num_pins)
+                return -EINVAL;
+            pin = task->pins[program[pc + 1]];
+        }
+
+        switch (op) {
+        case SEQ_WRITE:
+            if (!line_request(pin)->config.is_output)
+                return -EPERM;
+            break;
+
+        case SEQ_READ:
+            total += multiplier[depth] * read_size(pin);
+            if (total > SEQ_MAX_RESULT_SIZE)
+                return -EINVAL;
+            break;
+
+        case SEQ_LOOP:
+            if (depth == SEQ_MAX_LOOP_DEPTH)
+                return -EINVAL;
+            multiplier[depth + 1] = multiplier[depth] * get_u32(&program[pc + 1]);
+            if (multiplier[depth + 1] > UINT32_MAX)
+                multiplier[depth + 1] = UINT32_MAX;
+            depth++;
+            break;
+
+        case SEQ_END_LOOP:
+            if (depth == 0)
+                return -EINVAL;
+            depth--;
+            break;
+
+        default:
+            break;
+        }
+        pc += len;
+    }
+
+    if (depth != 0)
+        return -EINVAL;
+
+    *result_size = (size_t) total;
+    return 0;
+}
+
+// Wait until the deadline. Returns false if the task is stopping.
+static bool seq_wait(struct gpio_task *task, int64_t deadline)
+{
+    if (deadline - hal_timestamp() > SEQ_SPIN_NS)
+        return gpio_task_wait(task, deadline - SEQ_SPIN_NS / 2) && seq_wait(task, deadline);
+
+    while (hal_timestamp() < deadline)
+        ;
+    return !atomic_load(&task->stopping);
+}
+
+// Run the program. Returns 0 on success, 1 if stopped, or -errno.
+static int run_program(struct gpio_task *task)
+{
+    struct gpio_sequencer *seq = task->state;
+    const unsigned char *program = seq->program;
+    struct seq_loop loops[SEQ_MAX_LOOP_DEPTH];
+    int depth = 0;
+    int64_t mark = hal_timestamp();
+    uint64_t value;
+    int rc;
+
+    for (size_t pc = 0; pc < seq->program_size;) {
+        const unsigned char *args = &program[pc + 1];
+        struct gpio_pin *pin = NULL;
+
+        switch (program[pc]) {
+        case SEQ_WRITE:
+            pin = task->pins[args[0]];
+            rc = task_write_gpio_masked(pin, get_u64(&args[1]), get_u64(&args[9]));
+            if (rc < 0)
+                return rc;
+            break;
+
+        case SEQ_READ:
+            pin = task->pins[args[0]];
+            rc = task_read_gpio(pin, &value);
+            if (rc < 0)
+                return rc;
+            for (size_t i = 0; i < read_size(pin); i++)
+                seq->result[seq->result_len++] = (unsigned char) (value >> (8 * i));
+            break;
+
+        case SEQ_WAIT:
+            mark += get_u32(args);
+            if (!seq_wait(task, mark))
+                return 1;
+            break;
+
+        case SEQ_WAIT_LEVEL: {
+            pin = task->pins[args[0]];
+            uint64_t mask = get_u64(&args[1]);
+            uint64_t level = get_u64(&args[9]);
+            int64_t timeout = hal_timestamp() + get_u32(&args[17]);
+            for (;;) {
+                rc = task_read_gpio(pin, &value);
+                if (rc < 0)
+                    return rc;
+                mark = hal_timestamp();
+                if ((value & mask) == level)
+                    break;
+                if (mark >= timeout)
+                    return -ETIMEDOUT;
+                if (atomic_load(&task->stopping))
+                    return 1;
+            }
+            break;
+        }
+
+        case SEQ_LOOP:
+            loops[depth].start = pc + 5;
+            loops[depth].remaining = get_u32(args);
+            if (loops[depth].remaining == 0) {
+                // Skip to the matching SEQ_END_LOOP
+                int nesting = 0;
+                for (pc += 5;; pc += op_size(program[pc])) {
+                    if (program[pc] == SEQ_LOOP)
+                        nesting++;
+                    else if (program[pc] == SEQ_END_LOOP && nesting-- == 0)
+                        break;
+                }
+                break;
+            }
+            depth++;
+            break;
+
+        case SEQ_END_LOOP:
+            if (--loops[depth - 1].remaining > 0) {
+                if (atomic_load(&task->stopping))
+                    return 1;
+                pc = loops[depth - 1].start;
+                continue;
+            }
+            depth--;
+            break;
+        }
+        pc += op_size(program[pc]);
+    }
+    return 0;
+}
+
+static void sequencer_run(struct gpio_task *task)
+{
+    struct gpio_sequencer *seq = task->state;
+    ErlNifEnv *msg_env = task->msg_env;
+
+    int rc = run_program(task);
+    if (rc == 1)
+        return;
+
+    ERL_NIF_TERM data;
+    unsigned char *bytes = enif_make_new_binary(msg_env, seq->result_len, &data);
+    if (seq->result_len > 0)
+        memcpy(bytes, seq->result, seq->result_len);
+
+    ERL_NIF_TERM map = enif_make_new_map(msg_env);
+    enif_make_map_put(msg_env, map, enif_make_atom(msg_env, "data"), data, &map);
+    if (rc < 0) {
+        enif_make_map_put(msg_env, map, enif_make_atom(msg_env, "reason"),
+                          rc == -ETIMEDOUT ? enif_make_atom(msg_env, "timeout") : make_errno_atom(msg_env, rc), &map);
+        send_task_event(task, atom_error, hal_timestamp(), map);
+    } else {
+        send_task_event(task, enif_make_atom(msg_env, "sequence_done"), hal_timestamp(), map);
+    }
+}
+
+static void sequencer_dtor(struct gpio_task *task)
+{
+    struct gpio_sequencer *seq = task->state;
+
+    if (seq->program)
+        enif_free(seq->program);
+    if (seq->result)
+        enif_free(seq->result);
+}
+
+static const struct gpio_task_type gpio_sequencer_task = {
+    .name = "gpio_sequencer",
+    .state_size = sizeof(struct gpio_sequencer),
+    .run = sequencer_run,
+    .dtor = sequencer_dtor
+};
+
+ERL_NIF_TERM sequencer_start(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+    ErlNifPid pid;
+    ErlNifBinary program;
+    unsigned int num_pins;
+
+    // sequencer_start([gpio], notify_id, pid, program)
+    if (argc != 4 ||
+            !enif_get_list_length(env, argv[0], &num_pins) ||
+            num_pins == 0 || num_pins > GPIO_TASK_MAX_PINS ||
+            !enif_get_local_pid(env, argv[2], &pid) ||
+            !enif_inspect_binary(env, argv[3], &program))
+        return enif_make_badarg(env);
+
+    struct gpio_task *task = alloc_gpio_task(env, &gpio_sequencer_task, &pid, argv[1]);
+    if (!task)
+        return make_errno_error(env, -ENOMEM);
+
+    ERL_NIF_TERM list = argv[0];
+    ERL_NIF_TERM head;
+    while (enif_get_list_cell(env, list, &head, &list)) {
+        struct gpio_pin *pin;
+        if (!get_gpio_pin(env, head, &pin)) {
+            enif_release_resource(task);
+            return enif_make_badarg(env);
+        }
+        add_gpio_task_pin(task, pin);
+    }
+
+    struct gpio_sequencer *seq = task->state;
+    int rc = check_program(task, program.data, program.size, &seq->result_size);
+    if (rc == -EPERM) {
+        enif_release_resource(task);
+        return enif_make_tuple2(env, atom_error, enif_make_atom(env, "pin_not_output"));
+    } else if (rc < 0) {
+        enif_release_resource(task);
+        return enif_make_badarg(env);
+    }
+
+    seq->program = enif_alloc(program.size);
+    if (seq->result_size > 0)
+        seq->result = enif_alloc(seq->result_size);
+    if (!seq->program || (seq->result_size > 0 && !seq->result)) {
+        enif_release_resource(task);
+        return make_errno_error(env, -ENOMEM);
+    }
+    memcpy(seq->program, program.data, program.size);
+    seq->program_size = program.size;
+
+    rc = start_gpio_task(task);
+    if (rc < 0) {
+        enif_release_resource(task);
+        return make_errno_error(env, rc);
+    }
+
+    ERL_NIF_TERM task_term = enif_make_resource(env, task);
+    enif_release_resource(task);
+
+    return make_ok_tuple(env, task_term);
+}
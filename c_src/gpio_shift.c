@@ -0,0 +1,212 @@
+// SPDX-FileCopyrightText: 2026 Frank Hunleth
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Bit-banged shift registers and SPI
+//
+// Clocks bytes out of and into GPIOs with one loop in C. The clock, data out
+// and select lines are in one output handle so that the data and clock edges
+// that happen together are one write. Data in is the first line of an
+// optional input handle.
+
+#include "gpio_nif.h"
+
+#include <errno.h>
+#include <string.h>
+
+enum shift_select {
+    SELECT_NONE = 0,
+    SELECT_LATCH, // Pulse high after shifting (74HC595 RCLK)
+    SELECT_LOAD,  // Pulse low before shifting (74HC165 SH/LD)
+    SELECT_CS     // Low while shifting (SPI chip select)
+};
+
+struct shift_config {
+    uint64_t clock;
+    uint64_t data_out;
+    uint64_t select;
+    enum shift_select select_mode;
+
+    bool cpol;
+    bool cpha;
+    bool lsb_first;
+    int64_t delay_ns;
+};
+
+static void shift_delay(const struct shift_config *config)
+{
+    if (config->delay_ns > 0) {
+        int64_t deadline = hal_timestamp() + config->delay_ns;
+        while (hal_timestamp() < deadline)
+            ;
+    }
+}
+
+static int shift_write(struct gpio_pin *out, const struct shift_config *config, uint64_t mask, uint64_t value, ErlNifEnv *env)
+{
+    int rc = hal_write_gpio_masked(out, mask, value, env);
+    shift_delay(config);
+    return rc;
+}
+
+static int shift_byte(struct gpio_pin *out, struct gpio_pin *in, const struct shift_config *config,
+                      uint8_t tx, uint8_t *rx, ErlNifEnv *env)
+{
+    uint64_t idle = config->cpol ? config->clock : 0;
+    uint64_t active = idle ^ config->clock;
+    uint64_t mask = config->clock | config->data_out;
+    uint8_t value = 0;
+
+    for (int i = 0; i < 8; i++) {
+        int bit = config->lsb_first ? i : 7 - i;
+        uint64_t data = ((tx >> bit) & 1) ? config->data_out : 0;
+        int rc;
+
+        // Data changes on the first clock edge for CPHA=1 and before it for
+        // CPHA=0. It's sampled just before the other edge.
+        rc = shift_write(out, config, mask, data | (config->cpha ? active : idle), env);
+        if (rc < 0)
+            return rc;
+
+        if (in) {
+            uint64_t input;
+            rc = hal_read_gpio(in, &input);
+            if (rc < 0)
+                return rc;
+            value |= (input & 1) << bit;
+        }
+
+        rc = shift_write(out, config, config->clock, config->cpha ? idle : active, env);
+        if (rc < 0)
+            return rc;
+    }
+
+    if (rx)
+        *rx = value;
+    return 0;
+}
+
+static int shift_transfer_bytes(struct gpio_pin *out, struct gpio_pin *in, const struct shift_config *config,
+                                const uint8_t *tx, uint8_t *rx, size_t len, ErlNifEnv *env)
+{
+    uint64_t idle = config->cpol ? config->clock : 0;
+    int rc;
+
+    // Start with the clock idle and select asserted or pulsed
+    switch (config->select_mode) {
+    case SELECT_LOAD:
+        rc = shift_write(out, config, config->clock | config->select, idle, env);
+        if (rc == 0)
+            rc = shift_write(out, config, config->select, config->select, env);
+        break;
+    case SELECT_CS:
+        rc = shift_write(out, config, config->clock | config->select, idle, env);
+        break;
+    default:
+        rc = shift_write(out, config, config->clock, idle, env);
+        break;
+    }
+
+    for (size_t i = 0; rc == 0 && i < len; i++)
+        rc = shift_byte(out, in, config, tx[i], rx ? &rx[i] : NULL, env);
+
+    // Finish with the clock idle. This is the last edge for CPHA=0.
+    if (rc == 0 && !config->cpha)
+        rc = shift_write(out, config, config->clock, idle, env);
+
+    switch (config->select_mode) {
+    case SELECT_LATCH:
+        if (rc == 0)
+            rc = shift_write(out, config, config->select, config->select, env);
+        if (rc == 0)
+            rc = shift_write(out, config, config->select, 0, env);
+        break;
+    case SELECT_CS: {
+        // Always release chip select
+        int rc2 = shift_write(out, config, config->select, config->select, env);
+        if (rc == 0)
+            rc = rc2;
+        break;
+    }
+    default:
+        break;
+    }
+
+    return rc;
+}
+
+static bool get_line_option(ErlNifEnv *env, ERL_NIF_TERM options, const char *key, const struct gpio_pin *pin, uint64_t *mask)
+{
+    int64_t index = -1;
+    if (!get_option_int64(env, options, key, 0, pin->num_lines - 1, &index))
+        return false;
+
+    *mask = index >= 0 ? (uint64_t) 1 << index : 0;
+    return true;
+}
+
+static bool get_shift_config(ErlNifEnv *env, ERL_NIF_TERM options, const struct gpio_pin *out, struct shift_config *config)
+{
+    ERL_NIF_TERM value;
+    int64_t mode = 0;
+
+    memset(config, 0, sizeof(struct shift_config));
+    if (!get_line_option(env, options, "clock", out, &config->clock) ||
+            !get_line_option(env, options, "data_out", out, &config->data_out) ||
+            !get_line_option(env, options, "select", out, &config->select) ||
+            !get_option_int64(env, options, "mode", 0, 3, &mode) ||
+            !get_option_int64(env, options, "delay_ns", 0, 1000000, &config->delay_ns) ||
+            config->clock == 0 ||
+            (config->clock & (config->data_out | config->select)) ||
+            (config->data_out & config->select))
+        return false;
+
+    config->cpol = (mode & 2) != 0;
+    config->cpha = (mode & 1) != 0;
+
+    if (enif_get_map_value(env, options, enif_make_atom(env, "lsb_first"), &value) &&
+            !enif_get_boolean(env, value, &config->lsb_first))
+        return false;
+
+    if (enif_get_map_value(env, options, enif_make_atom(env, "select_mode"), &value)) {
+        if (enif_is_identical(value, enif_make_atom(env, "latch")))
+            config->select_mode = SELECT_LATCH;
+        else if (enif_is_identical(value, enif_make_atom(env, "load")))
+            config->select_mode = SELECT_LOAD;
+        else if (enif_is_identical(value, enif_make_atom(env, "cs")))
+            config->select_mode = SELECT_CS;
+        else
+            return false;
+    }
+
+    // Select lines and modes go together
+    return (config->select == 0) == (config->select_mode == SELECT_NONE);
+}
+
+ERL_NIF_TERM shift_transfer(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+    struct gpio_pin *out;
+    struct gpio_pin *in = NULL;
+    ErlNifBinary tx;
+    struct shift_config config;
+
+    // shift_transfer(out, in | nil, data, options)
+    if (argc != 4 ||
+            !get_gpio_pin(env, argv[0], &out) ||
+            (!enif_is_identical(argv[1], enif_make_atom(env, "nil")) && !get_gpio_pin(env, argv[1], &in)) ||
+            !enif_inspect_binary(env, argv[2], &tx) ||
+            !get_shift_config(env, argv[3], out, &config))
+        return enif_make_badarg(env);
+
+    if (!line_request(out)->config.is_output)
+        return enif_raise_exception(env, enif_make_atom(env, "pin_not_output"));
+
+    ERL_NIF_TERM result = atom_ok;
+    uint8_t *rx = in ? enif_make_new_binary(env, tx.size, &result) : NULL;
+
+    int rc = shift_transfer_bytes(out, in, &config, tx.data, rx, tx.size, env);
+    if (rc < 0)
+        return enif_raise_exception(env, make_errno_atom(env, rc));
+
+    return result;
+}
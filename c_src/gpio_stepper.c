@@ -0,0 +1,310 @@
+// SPDX-FileCopyrightText: 2026 Frank Hunleth
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Stepper motor step/dir pulse generator
+//
+// The handle's first line is the driver's step input and the second is its
+// direction input. Moves follow a trapezoidal velocity profile: constant
+// acceleration up to the maximum speed, a cruise, and then a symmetric
+// deceleration. Each step's time is computed from the start of the move and
+// slept to with an absolute deadline so that timing errors don't accumulate.
+
+#include "gpio_nif.h"
+
+#include <errno.h>
+#include <math.h>
+
+#define STEP_LINE 1
+#define DIR_LINE 2
+
+struct stepper_profile {
+    double steps;
+    double accel;
+
+    // Steps spent accelerating (and decelerating), the time that takes, the
+    // top speed, and the total time. All in steps and seconds.
+    double accel_steps;
+    double accel_time;
+    double peak_speed;
+    double total_time;
+};
+
+struct gpio_stepper {
+    bool invert_dir;
+    int64_t pulse_ns;
+    int64_t dir_setup_ns;
+
+    // Guarded by the task lock
+    int64_t position;
+    bool moving;
+    bool halt;
+
+    // The requested move. Guarded by the task lock.
+    int64_t steps;
+    double max_speed;
+    double accel;
+};
+
+static void init_profile(struct stepper_profile *profile, int64_t steps, double max_speed, double accel)
+{
+    profile->steps = (double) steps;
+    profile->accel = accel;
+
+    // Short moves never reach max_speed and are triangular
+    profile->accel_steps = max_speed * max_speed / (2.0 * accel);
+    if (profile->accel_steps > profile->steps / 2.0)
+        profile->accel_steps = profile->steps / 2.0;
+
+    profile->accel_time = sqrt(2.0 * profile->accel_steps / accel);
+    profile->peak_speed = accel * profile->accel_time;
+    profile->total_time = 2.0 * profile->accel_time +
+                          (profile->steps - 2.0 * profile->accel_steps) / profile->peak_speed;
+}
+
+// Time in seconds from the start of the move when the motor is at position s
+static double profile_time(const struct stepper_profile *profile, double s)
+{
+    if (s <= profile->accel_steps)
+        return sqrt(2.0 * s / profile->accel);
+    else if (s <= profile->steps - profile->accel_steps)
+        return profile->accel_time + (s - profile->accel_steps) / profile->peak_speed;
+    else
+        return profile->total_time - sqrt(2.0 * (profile->steps - s) / profile->accel);
+}
+
+static void send_move_done(struct gpio_task *task, int64_t position, bool halted)
+{
+    ErlNifEnv *msg_env = task->msg_env;
+
+    ERL_NIF_TERM map = enif_make_new_map(msg_env);
+    enif_make_map_put(msg_env, map, atom_position, enif_make_int64(msg_env, position), &map);
+    enif_make_map_put(msg_env, map, enif_make_atom(msg_env, "halted"), enif_make_atom(msg_env, halted ? "true" : "false"), &map);
+    send_task_event(task, enif_make_atom(msg_env, "move_done"), hal_timestamp(), map);
+}
+
+// Wait for a step's time. Returns false if the task is stopping.
+static bool wait_for_step(struct gpio_task *task, int64_t deadline)
+{
+    // gpio_task_wait returns early when woken by halt
+    while (hal_timestamp() < deadline) {
+        if (!gpio_task_wait(task, deadline))
+            return false;
+
+        struct gpio_stepper *stepper = task->state;
+        enif_mutex_lock(task->lock);
+        bool halt = stepper->halt;
+        enif_mutex_unlock(task->lock);
+        if (halt)
+            break;
+    }
+    return true;
+}
+
+static int run_move(struct gpio_task *task, int64_t steps, double max_speed, double accel)
+{
+    struct gpio_stepper *stepper = task->state;
+    struct gpio_pin *pin = task->pins[0];
+    int direction = steps < 0 ? -1 : 1;
+    bool dir_level = (steps < 0) != stepper->invert_dir;
+    struct stepper_profile profile;
+    bool halted = false;
+
+    init_profile(&profile, steps * direction, max_speed, accel);
+
+    int rc = task_write_gpio_masked(pin, DIR_LINE, dir_level ? DIR_LINE : 0);
+    if (rc < 0)
+        return rc;
+
+    int64_t start = hal_timestamp() + stepper->dir_setup_ns;
+    int64_t position;
+    for (int64_t i = 0; i < steps * direction; i++) {
+        // Step in the middle of each step's time slot so that the profile is
+        // symmetric
+        int64_t deadline = start + (int64_t) (profile_time(&profile, (double) i + 0.5) * 1e9);
+        if (!wait_for_step(task, deadline))
+            return 0;
+
+        enif_mutex_lock(task->lock);
+        halted = stepper->halt;
+        enif_mutex_unlock(task->lock);
+        if (halted)
+            break;
+
+        rc = task_write_gpio_masked(pin, STEP_LINE, STEP_LINE);
+        if (rc < 0)
+            return rc;
+        hal_sleep_until(hal_timestamp() + stepper->pulse_ns);
+        rc = task_write_gpio_masked(pin, STEP_LINE, 0);
+        if (rc < 0)
+            return rc;
+
+        enif_mutex_lock(task->lock);
+        stepper->position += direction;
+        enif_mutex_unlock(task->lock);
+    }
+
+    enif_mutex_lock(task->lock);
+    position = stepper->position;
+    stepper->moving = false;
+    stepper->halt = false;
+    enif_mutex_unlock(task->lock);
+
+    send_move_done(task, position, halted);
+    return 0;
+}
+
+static void stepper_run(struct gpio_task *task)
+{
+    struct gpio_stepper *stepper = task->state;
+
+    while (gpio_task_wait(task, INT64_MAX)) {
+        enif_mutex_lock(task->lock);
+        bool moving = stepper->moving;
+        int64_t steps = stepper->steps;
+        double max_speed = stepper->max_speed;
+        double accel = stepper->accel;
+        enif_mutex_unlock(task->lock);
+
+        if (!moving)
+            continue;
+
+        int rc = run_move(task, steps, max_speed, accel);
+        if (rc < 0) {
+            send_task_error(task, rc);
+            return;
+        }
+    }
+}
+
+static const struct gpio_task_type gpio_stepper_task = {
+    .name = "gpio_stepper",
+    .state_size = sizeof(struct gpio_stepper),
+    .run = stepper_run
+};
+
+ERL_NIF_TERM stepper_start(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+    struct gpio_pin *pin;
+    ErlNifPid pid;
+    int64_t pulse_us = 5;
+    int64_t dir_setup_us = 5;
+    ERL_NIF_TERM value;
+
+    // stepper_start(gpio, notify_id, pid, options)
+    if (argc != 4 ||
+            !get_gpio_pin(env, argv[0], &pin) ||
+            !enif_get_local_pid(env, argv[2], &pid) ||
+            pin->num_lines != 2)
+        return enif_make_badarg(env);
+
+    if (!line_request(pin)->config.is_output)
+        return enif_make_tuple2(env, atom_error, enif_make_atom(env, "pin_not_output"));
+
+    struct gpio_task *task = alloc_gpio_task(env, &gpio_stepper_task, &pid, argv[1]);
+    if (!task)
+        return make_errno_error(env, -ENOMEM);
+
+    struct gpio_stepper *stepper = task->state;
+    add_gpio_task_pin(task, pin);
+
+    if (!get_option_int64(env, argv[3], "pulse_us", 1, 1000, &pulse_us) ||
+            !get_option_int64(env, argv[3], "dir_setup_us", 0, 100000, &dir_setup_us) ||
+            !get_option_int64(env, argv[3], "position", INT64_MIN, INT64_MAX, &stepper->position) ||
+            (enif_get_map_value(env, argv[3], enif_make_atom(env, "invert_dir"), &value) &&
+             !enif_get_boolean(env, value, &stepper->invert_dir))) {
+        enif_release_resource(task);
+        return enif_make_badarg(env);
+    }
+    stepper->pulse_ns = pulse_us * 1000;
+    stepper->dir_setup_ns = dir_setup_us * 1000;
+
+    int rc = start_gpio_task(task);
+    if (rc < 0) {
+        enif_release_resource(task);
+        return make_errno_error(env, rc);
+    }
+
+    ERL_NIF_TERM task_term = enif_make_resource(env, task);
+    enif_release_resource(task);
+
+    return make_ok_tuple(env, task_term);
+}
+
+ERL_NIF_TERM stepper_move(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+    struct gpio_task *task;
+    ErlNifSInt64 steps;
+    double max_speed;
+    double accel;
+    bool absolute;
+
+    // stepper_move(task, steps, absolute, max_speed, accel)
+    if (argc != 5 ||
+            !get_gpio_task(env, argv[0], &gpio_stepper_task, &task) ||
+            !enif_get_int64(env, argv[1], &steps) ||
+            !enif_get_boolean(env, argv[2], &absolute) ||
+            !enif_get_double(env, argv[3], &max_speed) ||
+            !enif_get_double(env, argv[4], &accel) ||
+            max_speed <= 0.0 || max_speed > 1000000.0 ||
+            accel <= 0.0 || accel > 100000000.0)
+        return enif_make_badarg(env);
+
+    struct gpio_stepper *stepper = task->state;
+    ERL_NIF_TERM result = atom_ok;
+
+    enif_mutex_lock(task->lock);
+    if (stepper->moving) {
+        result = enif_make_tuple2(env, atom_error, enif_make_atom(env, "busy"));
+    } else {
+        stepper->steps = absolute ? steps - stepper->position : steps;
+        stepper->max_speed = max_speed;
+        stepper->accel = accel;
+        stepper->moving = true;
+        stepper->halt = false;
+    }
+    enif_mutex_unlock(task->lock);
+
+    if (result == atom_ok)
+        wake_gpio_task(task);
+
+    return result;
+}
+
+ERL_NIF_TERM stepper_halt(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+    struct gpio_task *task;
+
+    if (argc != 1 || !get_gpio_task(env, argv[0], &gpio_stepper_task, &task))
+        return enif_make_badarg(env);
+
+    struct gpio_stepper *stepper = task->state;
+
+    enif_mutex_lock(task->lock);
+    if (stepper->moving)
+        stepper->halt = true;
+    enif_mutex_unlock(task->lock);
+
+    wake_gpio_task(task);
+    return atom_ok;
+}
+
+ERL_NIF_TERM stepper_status(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+    struct gpio_task *task;
+
+    if (argc != 1 || !get_gpio_task(env, argv[0], &gpio_stepper_task, &task))
+        return enif_make_badarg(env);
+
+    struct gpio_stepper *stepper = task->state;
+
+    enif_mutex_lock(task->lock);
+    int64_t position = stepper->position;
+    bool moving = stepper->moving;
+    enif_mutex_unlock(task->lock);
+
+    ERL_NIF_TERM map = enif_make_new_map(env);
+    enif_make_map_put(env, map, atom_position, enif_make_int64(env, position), &map);
+    enif_make_map_put(env, map, enif_make_atom(env, "moving"), enif_make_atom(env, moving ? "true" : "false"), &map);
+    return map;
+}
@@ -0,0 +1,237 @@
+// SPDX-FileCopyrightText: 2026 Frank Hunleth
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Background tasks
+//
+// A task is a thread that drives or samples GPIOs on its own schedule, like
+// a keypad scanner. The task type supplies the thread's loop. Everything
+// else (the resource, stopping, waiting, and sending messages) is here.
+
+#include "gpio_nif.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
+// Waits closer than this to the deadline are slept with hal_sleep_until
+// instead of polled so that they're accurate. Stopping can be delayed by up
+// to this long.
+#define TASK_SLEEP_NS 2000000LL
+
+static void release_task_pins(struct gpio_task *task)
+{
+    for (int i = 0; i < task->num_pins; i++)
+        enif_release_resource(task->pins[i]);
+    task->num_pins = 0;
+}
+
+void gpio_task_dtor(ErlNifEnv *env, void *obj)
+{
+    (void) env;
+    struct gpio_task *task = (struct gpio_task *) obj;
+
+    // This can run on a normal scheduler. Task loops only wait with
+    // gpio_task_wait, so the join takes at most about TASK_SLEEP_NS.
+    stop_gpio_task(task);
+    release_task_pins(task);
+
+    if (task->wake_fds[0] >= 0) {
+        close(task->wake_fds[0]);
+        close(task->wake_fds[1]);
+    }
+    if (task->lock)
+        enif_mutex_destroy(task->lock);
+    if (task->env)
+        enif_free_env(task->env);
+    if (task->msg_env)
+        enif_free_env(task->msg_env);
+    if (task->state) {
+        if (task->type->dtor)
+            task->type->dtor(task);
+        enif_free(task->state);
+    }
+}
+
+struct gpio_task *alloc_gpio_task(ErlNifEnv *env,
+                                  const struct gpio_task_type *type,
+                                  const ErlNifPid *pid,
+                                  ERL_NIF_TERM notify_term)
+{
+    struct gpio_priv *priv = enif_priv_data(env);
+    struct gpio_task *task = enif_alloc_resource(priv->gpio_task_rt, sizeof(struct gpio_task));
+    memset(task, 0, sizeof(struct gpio_task));
+    task->type = type;
+    task->pid = *pid;
+    task->wake_fds[0] = -1;
+    task->wake_fds[1] = -1;
+    atomic_init(&task->stopping, false);
+
+    task->env = enif_alloc_env();
+    task->msg_env = enif_alloc_env();
+    task->lock = enif_mutex_create("gpio_task");
+    task->state = enif_alloc(type->state_size);
+    if (!task->env || !task->msg_env || !task->lock || !task->state || pipe(task->wake_fds) < 0) {
+        enif_release_resource(task);
+        return NULL;
+    }
+
+    // Waking the task should never block the caller
+    fcntl(task->wake_fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(task->wake_fds[1], F_SETFL, O_NONBLOCK);
+
+    task->notify_term = enif_make_copy(task->env, notify_term);
+    memset(task->state, 0, type->state_size);
+    return task;
+}
+
+bool add_gpio_task_pin(struct gpio_task *task, struct gpio_pin *pin)
+{
+    if (task->num_pins >= GPIO_TASK_MAX_PINS)
+        return false;
+
+    enif_keep_resource(pin);
+    task->pins[task->num_pins++] = pin;
+    return true;
+}
+
+static void *gpio_task_thread(void *arg)
+{
+    struct gpio_task *task = arg;
+
+    debug("%s task started", task->type->name);
+    task->type->run(task);
+    debug("%s task ended", task->type->name);
+    return NULL;
+}
+
+int start_gpio_task(struct gpio_task *task)
+{
+    if (enif_thread_create((char *) task->type->name, &task->tid, gpio_task_thread, task, NULL) != 0)
+        return -EAGAIN;
+
+    task->started = true;
+    return 0;
+}
+
+void stop_gpio_task(struct gpio_task *task)
+{
+    // Only the first caller joins the thread
+    if (!task->started || atomic_exchange(&task->stopping, true))
+        return;
+
+    wake_gpio_task(task);
+    enif_thread_join(task->tid, NULL);
+}
+
+void wake_gpio_task(struct gpio_task *task)
+{
+    char c = 0;
+    ssize_t rc = write(task->wake_fds[1], &c, 1);
+    (void) rc;
+}
+
+bool gpio_task_wait(struct gpio_task *task, int64_t deadline)
+{
+    for (;;) {
+        if (atomic_load(&task->stopping))
+            return false;
+
+        int timeout_ms;
+        if (deadline == INT64_MAX) {
+            timeout_ms = -1;
+        } else {
+            int64_t remaining = deadline - hal_timestamp();
+            if (remaining <= TASK_SLEEP_NS)
+                break;
+
+            // Leave the last bit to hal_sleep_until
+            int64_t poll_ns = remaining - TASK_SLEEP_NS / 2;
+            timeout_ms = poll_ns >= 1000000000LL ? 1000 : (int) (poll_ns / 1000000);
+        }
+
+        struct pollfd fdset;
+        fdset.fd = task->wake_fds[0];
+        fdset.events = POLLIN;
+        fdset.revents = 0;
+        if (poll(&fdset, 1, timeout_ms) > 0) {
+            char buffer[32];
+            while (read(task->wake_fds[0], buffer, sizeof(buffer)) > 0)
+                ;
+            return !atomic_load(&task->stopping);
+        }
+    }
+
+    hal_sleep_until(deadline);
+    return !atomic_load(&task->stopping);
+}
+
+int task_read_gpio(struct gpio_pin *pin, uint64_t *value)
+{
+    if (!keep_gpio_fd(pin))
+        return -EBADF;
+
+    int rc = hal_read_gpio(pin, value);
+    release_gpio_fd(pin);
+    return rc;
+}
+
+int task_write_gpio_masked(struct gpio_pin *pin, uint64_t mask, uint64_t value)
+{
+    if (!keep_gpio_fd(pin))
+        return -EBADF;
+
+    int rc = hal_write_gpio_masked(pin, mask, value, NULL);
+    release_gpio_fd(pin);
+    return rc;
+}
+
+int send_task_event(struct gpio_task *task, ERL_NIF_TERM event, int64_t timestamp, ERL_NIF_TERM map)
+{
+    ErlNifEnv *msg_env = task->msg_env;
+
+    enif_make_map_put(msg_env, map, atom_ref, enif_make_copy(msg_env, task->notify_term), &map);
+    enif_make_map_put(msg_env, map, atom_event, event, &map);
+    enif_make_map_put(msg_env, map, atom_timestamp, enif_make_int64(msg_env, timestamp), &map);
+
+    ERL_NIF_TERM msg = enif_make_tuple2(msg_env, atom_circuits_gpio, map);
+
+    int rc = enif_send(NULL, &task->pid, msg_env, msg);
+
+    enif_clear_env(msg_env);
+
+    return rc;
+}
+
+void send_task_error(struct gpio_task *task, int rc)
+{
+    ErlNifEnv *msg_env = task->msg_env;
+
+    error("%s task failed: %d", task->type->name, rc);
+
+    ERL_NIF_TERM map = enif_make_new_map(msg_env);
+    enif_make_map_put(msg_env, map, enif_make_atom(msg_env, "reason"), make_errno_atom(msg_env, rc), &map);
+    send_task_event(task, atom_error, hal_timestamp(), map);
+}
+
+bool get_gpio_task(ErlNifEnv *env, ERL_NIF_TERM term, const struct gpio_task_type *type, struct gpio_task **task)
+{
+    struct gpio_priv *priv = enif_priv_data(env);
+    return enif_get_resource(env, term, priv->gpio_task_rt, (void**) task) &&
+           (*task)->type == type;
+}
+
+ERL_NIF_TERM task_stop(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+    struct gpio_priv *priv = enif_priv_data(env);
+    struct gpio_task *task;
+
+    if (argc != 1 ||
+            !enif_get_resource(env, argv[0], priv->gpio_task_rt, (void**) &task))
+        return enif_make_badarg(env);
+
+    stop_gpio_task(task);
+    return atom_ok;
+}
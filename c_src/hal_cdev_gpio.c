@@ -12,6 +12,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <time.h>
 
 #include <sys/ioctl.h>
 #include "linux/gpio.h"
@@ -78,7 +79,7 @@ static uint64_t lines_mask(int num_lines)
     return (num_lines >= 64) ? ~(uint64_t) 0 : (((uint64_t) 1 << num_lines) - 1);
 }
 
-static int get_values_v2(int fd, int num_lines, uint64_t *value)
+int get_values_v2(int fd, int num_lines, uint64_t *value)
 {
     struct gpio_v2_line_values vals;
     memset(&vals, 0, sizeof(vals));
@@ -92,10 +93,9 @@ static int get_values_v2(int fd, int num_lines, uint64_t *value)
     return 0;
 }
 
-static int set_values_v2(int fd, int num_lines, uint64_t value)
+static int set_values_v2(int fd, uint64_t mask, uint64_t value)
 {
     struct gpio_v2_line_values vals;
-    uint64_t mask = lines_mask(num_lines);
     vals.bits = value & mask;
     vals.mask = mask;
 
@@ -135,6 +135,12 @@ static uint64_t config_to_flags(const struct gpio_pin *pin)
         break;
     }
 
+    // The kernel rejects edge detection on outputs. Leave it off while the
+    // line is an output, like for the DHT start pulse, and switching back to
+    // an input turns it back on.
+    if (pin->config.is_output)
+        return flags;
+
     switch (pin->config.trigger) {
     case TRIGGER_RISING:
         flags |= GPIO_V2_LINE_FLAG_EDGE_RISING;
@@ -224,6 +230,25 @@ int hal_load(void *hal_priv)
     return 0;
 }
 
+int64_t hal_timestamp(void)
+{
+    // Line events are timestamped with CLOCK_MONOTONIC by default
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void hal_sleep_until(int64_t deadline)
+{
+    struct timespec ts;
+    ts.tv_sec = deadline / 1000000000LL;
+    ts.tv_nsec = deadline % 1000000000LL;
+
+    // Absolute sleeps don't drift when interrupted
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+}
+
 void hal_unload(void *hal_priv)
 {
     debug("hal_unload");
@@ -293,15 +318,38 @@ void hal_close_gpio(struct gpio_pin *pin)
 
 int hal_read_gpio(struct gpio_pin *pin, uint64_t *value)
 {
+    if (pin->parent)
+        return read_sub_handle(pin, value);
+
     debug("hal_read_gpio %s:%d (%d lines)", pin->gpiochip, pin->offsets[0], pin->num_lines);
     return get_values_v2(pin->fd, pin->num_lines, value);
 }
 
 int hal_write_gpio(struct gpio_pin *pin, uint64_t value, ErlNifEnv *env)
 {
+    if (pin->parent)
+        return write_sub_handle(pin, UINT64_MAX, value, env);
+
     (void) env;
     debug("hal_write_gpio %s:%d (%d lines) -> 0x%llx", pin->gpiochip, pin->offsets[0], pin->num_lines, (unsigned long long) value);
-    return set_values_v2(pin->fd, pin->num_lines, value);
+    return set_values_v2(pin->fd, lines_mask(pin->num_lines), value);
+}
+
+int hal_write_gpio_masked(struct gpio_pin *pin, uint64_t mask, uint64_t value, ErlNifEnv *env)
+{
+    if (pin->parent)
+        return write_sub_handle(pin, mask, value, env);
+
+    (void) env;
+    debug("hal_write_gpio_masked %s:%d (%d lines) -> 0x%llx/0x%llx", pin->gpiochip, pin->offsets[0], pin->num_lines, (unsigned long long) value, (unsigned long long) mask);
+
+    // The kernel only changes the lines in the mask, so this doesn't need to
+    // know what the others are.
+    int fd = pin->fd;
+    if (fd < 0)
+        return -EBADF;
+
+    return set_values_v2(fd, mask & lines_mask(pin->num_lines), value);
 }
 
 static int refresh_config(const struct gpio_pin *pin)
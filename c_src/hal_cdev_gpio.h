@@ -18,5 +18,6 @@ struct gpio_pin;
 
 void *gpio_poller_thread(void *arg);
 int update_polling_thread(struct gpio_pin *pin);
+int get_values_v2(int fd, int num_lines, uint64_t *value);
 
 #endif // HAL_CDEV_GPIO_H
@@ -9,6 +9,7 @@
 #include <string.h>
 
 #include <errno.h>
+#include <limits.h>
 #include <poll.h>
 #include <time.h>
 #include <stdint.h>
@@ -17,6 +18,7 @@
 #include <unistd.h>
 
 #include <sys/ioctl.h>
+#include <sys/timerfd.h>
 #include "linux/gpio.h"
 
 #include "hal_cdev_gpio.h"
@@ -27,30 +29,36 @@
 
 struct gpio_monitor_info {
     enum trigger_mode trigger;
-    enum trigger_mode emit_trigger;
     int fd;
     int num_lines;
     int offsets[GPIO_MAX_LINES];
     uint64_t shadow;
-    bool notify_map;
-    ErlNifEnv *env;
-    ErlNifPid pid;
-    ERL_NIF_TERM gpio_spec;
-    ERL_NIF_TERM notify_id;
+
+    // The poller holds its own reference to each subscriber so that it never
+    // needs to touch the gpio_pin.
+    int num_subs;
+    struct gpio_sub *subs[MAX_GPIO_SUBSCRIBERS];
 };
 
+// Listener updates are sent through a pipe by value. Writes up to PIPE_BUF are
+// atomic, so updates from different NIF calls can't get interleaved.
+_Static_assert(sizeof(struct gpio_monitor_info) <= PIPE_BUF, "gpio_monitor_info too big for the pipe");
+
 static void init_listeners(struct gpio_monitor_info *infos)
 {
     memset(infos, 0, MAX_GPIO_LISTENERS * sizeof(struct gpio_monitor_info));
 }
 
-static void clear_listener(struct gpio_monitor_info *info)
+static void release_subs(struct gpio_monitor_info *info)
 {
-    if (info->env) {
-        enif_free_env(info->env);
-        info->env = NULL;
-    }
+    for (int i = 0; i < info->num_subs; i++)
+        enif_release_resource(info->subs[i]);
+    info->num_subs = 0;
+}
 
+static void clear_listener(struct gpio_monitor_info *info)
+{
+    release_subs(info);
     memset(info, 0, sizeof(struct gpio_monitor_info));
 }
 
@@ -74,7 +82,8 @@ static int handle_gpio_update(ErlNifEnv *msg_env,
                               struct gpio_monitor_info *info,
                               uint64_t timestamp,
                               int event_id,
-                              unsigned int offset)
+                              unsigned int offset,
+                              uint32_t seqno)
 {
     debug("handle_gpio_update offset %u", offset);
 
@@ -90,29 +99,48 @@ static int handle_gpio_update(ErlNifEnv *msg_env,
         return 0;
 
     // Update the shadow value from the edge direction. The hardware tracks both
-    // edges so the aggregate stays accurate; emit_trigger decides what's sent.
-    uint64_t previous = info->shadow;
-    uint64_t new_value = previous;
-    if (event_id == GPIO_V2_LINE_EVENT_RISING_EDGE)
-        new_value |= ((uint64_t) 1 << changed_bit);
-    else
-        new_value &= ~((uint64_t) 1 << changed_bit);
-    info->shadow = new_value;
-
-    ERL_NIF_TERM notify_term = info->notify_map ? info->notify_id : info->gpio_spec;
+    // edges so the aggregate stays accurate; each subscriber's emit_trigger
+    // decides what's sent to it.
+    uint64_t bit = (uint64_t) 1 << changed_bit;
+    struct gpio_change change;
+    memset(&change, 0, sizeof(change));
+    change.timestamp = (int64_t) timestamp;
+    change.seqno = seqno;
+    change.previous_value = info->shadow;
+    if (event_id == GPIO_V2_LINE_EVENT_RISING_EDGE) {
+        change.value = info->shadow | bit;
+        change.rising = bit;
+    } else {
+        change.value = info->shadow & ~bit;
+        change.falling = bit;
+    }
+    info->shadow = change.value;
 
-    // Convert true/false return to the typical 0/negative returns of this file
-    if (emit_gpio_change(NULL, msg_env, info->notify_map, notify_term, &info->pid,
-                         info->emit_trigger, (int64_t) timestamp, new_value, previous, changed_bit))
+    // Convert true/false return to the typical 0/negative returns of this
+    // file. It's only an error when nobody is left to notify.
+    if (dispatch_gpio_change(NULL, msg_env, info->subs, info->num_subs, &change))
         return 0;
     else
         return -1;
 }
 
-static int process_gpio_events(ErlNifEnv *msg_env,
-                               struct gpio_monitor_info *info)
+#define MAX_EVENTS_PER_READ 16
+#define MAX_BATCH_EVENTS (MAX_EVENTS_PER_READ * MAX_GPIO_LISTENERS)
+
+// Events from every ready line request are collected and handled in timestamp
+// order so that subscribers see edges on different handles (and gpiochips) in
+// the order that they happened rather than in poll order.
+struct gpio_batch_event {
+    struct gpio_v2_line_event event;
+    int listener;
+};
+
+static int read_gpio_events(struct gpio_monitor_info *info,
+                            int listener,
+                            struct gpio_batch_event *batch,
+                            int *batch_count)
 {
-    struct gpio_v2_line_event events[16];
+    struct gpio_v2_line_event events[MAX_EVENTS_PER_READ];
     ssize_t amount_read = read(info->fd, events, sizeof(events));
     if (amount_read < 0) {
         error("Unexpected return from reading gpio events: %d, errno=%d", amount_read, errno);
@@ -121,23 +149,63 @@ static int process_gpio_events(ErlNifEnv *msg_env,
 
     int num_events = amount_read / sizeof(struct gpio_v2_line_event);
     for (int i = 0; i < num_events; i++) {
-        if (handle_gpio_update(msg_env,
-                               info,
-                               events[i].timestamp_ns,
-                               events[i].id,
-                               events[i].offset) < 0) {
-            error("send for gpio fd %d failed, so not listening to it any more", info->fd);
-            return -1;
+        // Insertion sort since each line request's events are already in order
+        int j = *batch_count;
+        while (j > 0 && batch[j - 1].event.timestamp_ns > events[i].timestamp_ns) {
+            batch[j] = batch[j - 1];
+            j--;
         }
+        batch[j].event = events[i];
+        batch[j].listener = listener;
+        (*batch_count)++;
     }
     return 0;
 }
 
+static void arm_sub_timer(int timer_fd, const struct gpio_monitor_info *infos)
+{
+    int64_t deadline = INT64_MAX;
+    for (int i = 0; i < MAX_GPIO_LISTENERS && infos[i].trigger != TRIGGER_NONE; i++) {
+        int64_t d = gpio_subs_deadline(infos[i].subs, infos[i].num_subs);
+        if (d < deadline)
+            deadline = d;
+    }
+
+    // An all-zero it_value disarms the timer. Event timestamps are
+    // CLOCK_MONOTONIC so the deadline can be used as an absolute time.
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    if (deadline != INT64_MAX) {
+        if (deadline <= 0)
+            deadline = 1;
+        its.it_value.tv_sec = deadline / 1000000000LL;
+        its.it_value.tv_nsec = deadline % 1000000000LL;
+    }
+    if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &its, NULL) < 0)
+        error("timerfd_settime failed. errno=%d", errno);
+}
+
+static void service_listeners(ErlNifEnv *msg_env, struct gpio_monitor_info *infos, int64_t now)
+{
+    for (int i = 0; i < MAX_GPIO_LISTENERS && infos[i].trigger != TRIGGER_NONE; i++) {
+        struct gpio_monitor_info *info = &infos[i];
+        if (gpio_subs_deadline(info->subs, info->num_subs) > now)
+            continue;
+
+        // Debounced lines are confirmed with the hardware. Edges that are
+        // still queued make this disagree with the shadow, but they'll be
+        // handled and debounced next.
+        uint64_t value;
+        bool have_value = get_values_v2(info->fd, info->num_lines, &value) >= 0;
+        service_gpio_subs(NULL, msg_env, info->subs, info->num_subs, now, have_value ? &value : NULL);
+    }
+}
+
 static void add_listener(struct gpio_monitor_info *infos, const struct gpio_monitor_info *to_add)
 {
-    // The message owns its term environment (see update_polling_thread). Taking
-    // the message by value transfers that ownership to the listener slot, so the
-    // poller never dereferences the pin's environment.
+    // The message owns references to its subscribers (see
+    // update_polling_thread). Taking the message by value transfers them to
+    // the listener slot, so the poller never dereferences the pin.
     for (int i = 0; i < MAX_GPIO_LISTENERS; i++) {
         if (infos[i].trigger == TRIGGER_NONE || infos[i].fd == to_add->fd) {
             clear_listener(&infos[i]);
@@ -147,9 +215,9 @@ static void add_listener(struct gpio_monitor_info *infos, const struct gpio_moni
     }
     error("Too many gpio listeners. Max is %d", MAX_GPIO_LISTENERS);
 
-    // No slot available, so free the environment that would have been adopted.
-    if (to_add->env)
-        enif_free_env(to_add->env);
+    // No slot available, so drop the references that would have been adopted.
+    for (int i = 0; i < to_add->num_subs; i++)
+        enif_release_resource(to_add->subs[i]);
 }
 
 static void remove_listener(struct gpio_monitor_info *infos, int fd)
@@ -169,14 +237,25 @@ static void remove_listener(struct gpio_monitor_info *infos, int fd)
 void *gpio_poller_thread(void *arg)
 {
     struct gpio_monitor_info monitor_info[MAX_GPIO_LISTENERS];
-    struct pollfd fdset[MAX_GPIO_LISTENERS + 1];
+    struct pollfd fdset[MAX_GPIO_LISTENERS + 2];
     int *pipefd = arg;
     debug("gpio_poller_thread started");
 
+    // Settle windows and inactivity timeouts need a wakeup even if no more
+    // edges arrive. One timer covers all subscriptions. If it can't be
+    // created, merged notifications go out on the next edge and timeouts
+    // aren't sent.
+    int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (timer_fd < 0)
+        error("timerfd_create failed. errno=%d", errno);
+
     // Environment for building messages. It's cleared after each send so it
     // can be allocated once and reused for the life of the thread.
     ErlNifEnv *msg_env = enif_alloc_env();
 
+    // Too big for the stack, so allocate once
+    struct gpio_batch_event *batch = enif_alloc(MAX_BATCH_EVENTS * sizeof(struct gpio_batch_event));
+
     init_listeners(monitor_info);
     for (;;) {
         struct pollfd *fds = &fdset[0];
@@ -193,6 +272,16 @@ void *gpio_poller_thread(void *arg)
             count++;
         }
 
+        nfds_t num_listeners = count;
+        if (timer_fd >= 0) {
+            arm_sub_timer(timer_fd, monitor_info);
+            fds->fd = timer_fd;
+            fds->events = POLLIN;
+            fds->revents = 0;
+            fds++;
+            count++;
+        }
+
         fds->fd = *pipefd;
         fds->events = POLLIN;
         fds->revents = 0;
@@ -217,10 +306,11 @@ void *gpio_poller_thread(void *arg)
         }
 
         bool cleanup = false;
-        for (nfds_t i = 0; i < count - 1; i++) {
+        int batch_count = 0;
+        for (nfds_t i = 0; i < num_listeners; i++) {
             short gpio_revents = fdset[i].revents;
             if (gpio_revents & POLLIN) {
-                if (process_gpio_events(msg_env, &monitor_info[i]) < 0) {
+                if (read_gpio_events(&monitor_info[i], i, batch, &batch_count) < 0) {
                     error("error processing gpio events for fd %d", monitor_info[i].fd);
                     clear_listener(&monitor_info[i]);
                     cleanup = true;
@@ -232,6 +322,32 @@ void *gpio_poller_thread(void *arg)
             }
         }
 
+        // Cleared listeners keep their slots until compaction below, so the
+        // batch's listener indices stay valid.
+        for (int i = 0; i < batch_count; i++) {
+            struct gpio_monitor_info *info = &monitor_info[batch[i].listener];
+            if (info->trigger == TRIGGER_NONE)
+                continue;
+
+            if (handle_gpio_update(msg_env,
+                                   info,
+                                   batch[i].event.timestamp_ns,
+                                   batch[i].event.id,
+                                   batch[i].event.offset,
+                                   batch[i].event.seqno) < 0) {
+                error("no subscribers left for gpio fd %d, so not listening to it any more", info->fd);
+                clear_listener(info);
+                cleanup = true;
+            }
+        }
+
+        if (timer_fd >= 0 && (fdset[num_listeners].revents & POLLIN)) {
+            uint64_t expirations;
+            if (read(timer_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+                error("timerfd read failed. errno=%d", errno);
+            service_listeners(msg_env, monitor_info, hal_timestamp());
+        }
+
         if (revents & (POLLIN | POLLHUP)) {
             struct gpio_monitor_info message;
             ssize_t amount_read = read(*pipefd, &message, sizeof(message));
@@ -254,6 +370,9 @@ void *gpio_poller_thread(void *arg)
     for (int i = 0; i < MAX_GPIO_LISTENERS; i++)
         clear_listener(&monitor_info[i]);
 
+    if (timer_fd >= 0)
+        close(timer_fd);
+    enif_free(batch);
     enif_free_env(msg_env);
     debug("gpio_poller_thread ended");
     return NULL;
@@ -266,30 +385,26 @@ int update_polling_thread(struct gpio_pin *pin)
     struct gpio_monitor_info message;
     memset(&message, 0, sizeof(message));
     message.trigger = pin->config.trigger;
-    message.emit_trigger = pin->config.emit_trigger;
     message.fd = pin->fd;
     message.num_lines = pin->num_lines;
     memcpy(message.offsets, pin->offsets, sizeof(int) * pin->num_lines);
     message.shadow = pin->shadow;
-    message.notify_map = pin->notify_map;
-    message.pid = pin->config.pid;
 
-    // For an active subscription, copy the term the poller will echo into an
-    // environment owned by the message. This happens on the caller's thread
-    // while pin->env is valid, so the poller never has to dereference pin->env
-    // (which this thread may clear on re-subscribe or free on close).
+    // For an active subscription, take a reference to each subscriber for the
+    // poller. This happens on the caller's thread while the pin's references
+    // are valid, so the poller never has to look at pin->subs (which this
+    // thread may change on re-subscribe or release on close).
     if (pin->config.trigger != TRIGGER_NONE) {
-        message.env = enif_alloc_env();
-        if (pin->notify_map)
-            message.notify_id = enif_make_copy(message.env, pin->notify_id);
-        else
-            message.gpio_spec = enif_make_copy(message.env, pin->gpio_spec);
+        message.num_subs = pin->num_subs;
+        for (int i = 0; i < pin->num_subs; i++) {
+            enif_keep_resource(pin->subs[i]);
+            message.subs[i] = pin->subs[i];
+        }
     }
 
     if (write(priv->pipe_fds[1], &message, sizeof(message)) != sizeof(message)) {
         error("Error writing polling thread!");
-        if (message.env)
-            enif_free_env(message.env);
+        release_subs(&message);
         return -EIO;
     }
     return 0;
@@ -6,8 +6,12 @@
 
 #include "gpio_nif.h"
 #include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <stdatomic.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #define NUM_GPIOS 64
 
@@ -20,13 +24,40 @@
  * GPIOs can be opened individually or as a group. The state for each line is
  * tracked globally (indexed by the combined chip+offset) so that loopback and
  * notifications work regardless of how the lines were grouped at open time.
+ *
+ * Like the cdev backend, a thread services subscriber timers (settle windows
+ * and timeouts). It shares all of the state below, so every entry point takes
+ * the lock.
  */
 
+// Reflexes write outputs while changes are being delivered, and that happens
+// with the lock held. The lock can be taken again by the thread holding it to
+// allow this. This is how many times the calling thread has taken it.
+static _Thread_local int stub_lock_depth = 0;
+
+// Writes that cause changes that cause writes are cut off at this depth. On
+// real hardware, a reflex that inverts its own input would oscillate.
+#define MAX_STUB_LOCK_DEPTH 8
+
+// Like the cdev poller, the stub keeps its own references to subscribers so
+// that it doesn't depend on the NIF not changing pin->subs underneath it.
+struct stub_listener {
+    struct gpio_pin *pin;
+    uint32_t seqno;
+    int num_subs;
+    struct gpio_sub *subs[MAX_GPIO_SUBSCRIBERS];
+};
+
 struct stub_priv {
     atomic_int pins_open;
     int in_use[NUM_GPIOS]; // 0=no; >0=yes
     int value[NUM_GPIOS]; // -1, 0, 1 -> -1=hiZ
     struct gpio_pin *owner[NUM_GPIOS]; // group that opened this line, or NULL
+    struct stub_listener listeners[MAX_GPIO_LISTENERS];
+
+    ErlNifMutex *lock;
+    ErlNifTid timer_tid;
+    int wake_fds[2];
 };
 
 ERL_NIF_TERM hal_info(ErlNifEnv *env, void *hal_priv, ERL_NIF_TERM info)
@@ -50,6 +81,126 @@ size_t hal_priv_size(void)
     return sizeof(struct stub_priv);
 }
 
+int64_t hal_timestamp(void)
+{
+    return enif_monotonic_time(ERL_NIF_NSEC);
+}
+
+void hal_sleep_until(int64_t deadline)
+{
+    int64_t ns = deadline - hal_timestamp();
+    if (ns <= 0)
+        return;
+
+    struct timespec ts;
+    ts.tv_sec = ns / 1000000000LL;
+    ts.tv_nsec = ns % 1000000000LL;
+    nanosleep(&ts, NULL);
+}
+
+static int read_group(struct gpio_pin *pin, uint64_t *value);
+
+static void stub_lock(struct stub_priv *stub_priv)
+{
+    if (stub_lock_depth++ == 0)
+        enif_mutex_lock(stub_priv->lock);
+}
+
+static void stub_unlock(struct stub_priv *stub_priv)
+{
+    if (--stub_lock_depth == 0)
+        enif_mutex_unlock(stub_priv->lock);
+}
+
+static struct stub_listener *find_listener(struct stub_priv *stub_priv, const struct gpio_pin *pin)
+{
+    for (int i = 0; i < MAX_GPIO_LISTENERS; i++) {
+        if (stub_priv->listeners[i].pin == pin)
+            return &stub_priv->listeners[i];
+    }
+    return NULL;
+}
+
+static void clear_listener(struct stub_listener *listener)
+{
+    for (int i = 0; i < listener->num_subs; i++)
+        enif_release_resource(listener->subs[i]);
+    memset(listener, 0, sizeof(struct stub_listener));
+}
+
+static int64_t listeners_deadline(struct stub_priv *stub_priv)
+{
+    int64_t deadline = INT64_MAX;
+    for (int i = 0; i < MAX_GPIO_LISTENERS; i++) {
+        struct stub_listener *listener = &stub_priv->listeners[i];
+        int64_t d = gpio_subs_deadline(listener->subs, listener->num_subs);
+        if (d < deadline)
+            deadline = d;
+    }
+    return deadline;
+}
+
+// Let the timer thread know that the deadline may have changed
+static void wake_timer(struct stub_priv *stub_priv)
+{
+    char c = 0;
+    ssize_t rc = write(stub_priv->wake_fds[1], &c, 1);
+    (void) rc;
+}
+
+static void *stub_timer_thread(void *arg)
+{
+    struct stub_priv *stub_priv = arg;
+    ErlNifEnv *msg_env = enif_alloc_env();
+
+    for (;;) {
+        stub_lock(stub_priv);
+        int64_t deadline = listeners_deadline(stub_priv);
+        stub_unlock(stub_priv);
+
+        int timeout_ms = -1;
+        if (deadline != INT64_MAX) {
+            int64_t wait_ns = deadline - hal_timestamp();
+            if (wait_ns <= 0)
+                timeout_ms = 0;
+            else if (wait_ns >= 60000000000LL)
+                timeout_ms = 60000;
+            else
+                timeout_ms = (int) ((wait_ns + 999999) / 1000000);
+        }
+
+        struct pollfd fdset;
+        fdset.fd = stub_priv->wake_fds[0];
+        fdset.events = POLLIN;
+        fdset.revents = 0;
+        int rc = poll(&fdset, 1, timeout_ms);
+        if (rc < 0 && errno != EINTR)
+            break;
+
+        if (fdset.revents & POLLIN) {
+            char buffer[32];
+            // The write side is closed on unload
+            if (read(stub_priv->wake_fds[0], buffer, sizeof(buffer)) <= 0)
+                break;
+        } else if (fdset.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+            break;
+        }
+
+        stub_lock(stub_priv);
+        int64_t now = hal_timestamp();
+        for (int i = 0; i < MAX_GPIO_LISTENERS; i++) {
+            struct stub_listener *listener = &stub_priv->listeners[i];
+            uint64_t value;
+            bool have_value = listener->pin && read_group(listener->pin, &value) >= 0;
+            service_gpio_subs(NULL, msg_env, listener->subs, listener->num_subs, now, have_value ? &value : NULL);
+        }
+        stub_unlock(stub_priv);
+    }
+
+    enif_free_env(msg_env);
+    return NULL;
+}
+
 int hal_load(void *hal_priv)
 {
     struct stub_priv *stub_priv = (struct stub_priv *) hal_priv;
@@ -57,12 +208,34 @@ int hal_load(void *hal_priv)
     memset(stub_priv, 0, sizeof(struct stub_priv));
     stub_priv->pins_open = 0;
 
+    stub_priv->lock = enif_mutex_create("gpio_stub");
+    if (!stub_priv->lock)
+        return 1;
+
+    if (pipe(stub_priv->wake_fds) < 0)
+        return 1;
+
+    // Waking the timer thread should never block the caller
+    fcntl(stub_priv->wake_fds[1], F_SETFL, O_NONBLOCK);
+
+    if (enif_thread_create("gpio_stub_timer", &stub_priv->timer_tid, stub_timer_thread, stub_priv, NULL) != 0)
+        return 1;
+
     return 0;
 }
 
 void hal_unload(void *hal_priv)
 {
-    (void) hal_priv;
+    struct stub_priv *stub_priv = (struct stub_priv *) hal_priv;
+
+    close(stub_priv->wake_fds[1]);
+    enif_thread_join(stub_priv->timer_tid, NULL);
+    close(stub_priv->wake_fds[0]);
+
+    for (int i = 0; i < MAX_GPIO_LISTENERS; i++)
+        clear_listener(&stub_priv->listeners[i]);
+
+    enif_mutex_destroy(stub_priv->lock);
 }
 
 // Return the global line index base for a gpiochip, or -1 if unknown.
@@ -102,7 +275,7 @@ static int read_line_value(struct stub_priv *stub_priv, struct gpio_pin *pin, in
     return 0;
 }
 
-int hal_read_gpio(struct gpio_pin *pin, uint64_t *value)
+static int read_group(struct gpio_pin *pin, uint64_t *value)
 {
     if (pin->fd < 0)
         return -EBADF;
@@ -122,12 +295,30 @@ int hal_read_gpio(struct gpio_pin *pin, uint64_t *value)
     return 0;
 }
 
+int hal_read_gpio(struct gpio_pin *pin, uint64_t *value)
+{
+    if (pin->parent)
+        return read_sub_handle(pin, value);
+
+    struct stub_priv *stub_priv = pin->hal_priv;
+
+    stub_lock(stub_priv);
+    int rc = read_group(pin, value);
+    stub_unlock(stub_priv);
+    return rc;
+}
+
 // A single global line changed. Notify the group that owns it (if any and if
-// it's listening), updating that group's shadow value and emitting one message.
+// it's listening), updating that group's shadow value and emitting one message
+// per interested subscriber.
 static void notify_line_change(ErlNifEnv *env, struct stub_priv *stub_priv, int gidx)
 {
     struct gpio_pin *owner = stub_priv->owner[gidx];
-    if (!owner || owner->config.trigger == TRIGGER_NONE)
+    if (!owner)
+        return;
+
+    struct stub_listener *listener = find_listener(stub_priv, owner);
+    if (!listener)
         return;
 
     int base = chip_base(owner->gpiochip);
@@ -146,26 +337,32 @@ static void notify_line_change(ErlNifEnv *env, struct stub_priv *stub_priv, int
         return;
 
     uint64_t new_value;
-    if (hal_read_gpio(owner, &new_value) < 0)
+    if (read_group(owner, &new_value) < 0)
         return;
 
-    uint64_t previous_value = owner->shadow;
+    uint64_t bit = (uint64_t) 1 << changed_bit;
+    struct gpio_change change;
+    change.timestamp = enif_monotonic_time(ERL_NIF_NSEC);
+    change.seqno = ++listener->seqno;
+    change.value = new_value;
+    change.previous_value = owner->shadow;
+    change.rising = new_value & ~owner->shadow & bit;
+    change.falling = ~new_value & owner->shadow & bit;
     owner->shadow = new_value;
 
-    ErlNifTime now = enif_monotonic_time(ERL_NIF_NSEC);
     ErlNifEnv *msg_env = enif_alloc_env();
-    ERL_NIF_TERM notify_term = owner->notify_map ? owner->notify_id : owner->gpio_spec;
-    emit_gpio_change(env, msg_env, owner->notify_map, notify_term,
-                     &owner->config.pid, owner->config.emit_trigger,
-                     now, new_value, previous_value, changed_bit);
+    dispatch_gpio_change(env, msg_env, listener->subs, listener->num_subs, &change);
     enif_free_env(msg_env);
 }
 
-int hal_write_gpio(struct gpio_pin *pin, uint64_t value, ErlNifEnv *env)
+static int write_group(struct gpio_pin *pin, uint64_t mask, uint64_t value, ErlNifEnv *env)
 {
     if (pin->fd < 0)
         return -EBADF;
 
+    if (stub_lock_depth > MAX_STUB_LOCK_DEPTH)
+        return -ELOOP;
+
     struct stub_priv *stub_priv = pin->hal_priv;
     int base = chip_base(pin->gpiochip);
     if (base < 0)
@@ -177,6 +374,9 @@ int hal_write_gpio(struct gpio_pin *pin, uint64_t value, ErlNifEnv *env)
     bool is_open_source = pin->config.drive == DRIVE_OPEN_SOURCE;
 
     for (int i = 0; i < pin->num_lines; i++) {
+        if (!((mask >> i) & 1))
+            continue;
+
         int gidx = base + pin->offsets[i];
         int bitval = (int) ((value >> i) & 1);
 
@@ -200,8 +400,41 @@ int hal_write_gpio(struct gpio_pin *pin, uint64_t value, ErlNifEnv *env)
     return 0;
 }
 
-int hal_open_gpio(struct gpio_pin *pin,
-                  ErlNifEnv *env)
+int hal_write_gpio(struct gpio_pin *pin, uint64_t value, ErlNifEnv *env)
+{
+    if (pin->parent)
+        return write_sub_handle(pin, UINT64_MAX, value, env);
+
+    struct stub_priv *stub_priv = pin->hal_priv;
+
+    stub_lock(stub_priv);
+    int rc = write_group(pin, UINT64_MAX, value, env);
+    bool has_deadline = listeners_deadline(stub_priv) != INT64_MAX;
+    stub_unlock(stub_priv);
+
+    if (has_deadline)
+        wake_timer(stub_priv);
+    return rc;
+}
+
+int hal_write_gpio_masked(struct gpio_pin *pin, uint64_t mask, uint64_t value, ErlNifEnv *env)
+{
+    if (pin->parent)
+        return write_sub_handle(pin, mask, value, env);
+
+    struct stub_priv *stub_priv = pin->hal_priv;
+
+    stub_lock(stub_priv);
+    int rc = write_group(pin, mask, value, env);
+    bool has_deadline = listeners_deadline(stub_priv) != INT64_MAX;
+    stub_unlock(stub_priv);
+
+    if (has_deadline)
+        wake_timer(stub_priv);
+    return rc;
+}
+
+static int open_group(struct gpio_pin *pin, ErlNifEnv *env)
 {
     struct stub_priv *stub_priv = pin->hal_priv;
     int base = chip_base(pin->gpiochip);
@@ -226,17 +459,34 @@ int hal_open_gpio(struct gpio_pin *pin,
     pin->fd = base + pin->offsets[0];
 
     if (pin->config.is_output)
-        hal_write_gpio(pin, pin->config.initial_value, env);
+        write_group(pin, UINT64_MAX, pin->config.initial_value, env);
 
     return 0;
 }
 
+int hal_open_gpio(struct gpio_pin *pin,
+                  ErlNifEnv *env)
+{
+    struct stub_priv *stub_priv = pin->hal_priv;
+
+    stub_lock(stub_priv);
+    int rc = open_group(pin, env);
+    stub_unlock(stub_priv);
+    return rc;
+}
+
 void hal_close_gpio(struct gpio_pin *pin)
 {
     if (pin->fd < 0)
         return;
 
     struct stub_priv *stub_priv = pin->hal_priv;
+    stub_lock(stub_priv);
+
+    struct stub_listener *listener = find_listener(stub_priv, pin);
+    if (listener)
+        clear_listener(listener);
+
     int base = chip_base(pin->gpiochip);
     if (base >= 0) {
         for (int i = 0; i < pin->num_lines; i++) {
@@ -251,6 +501,7 @@ void hal_close_gpio(struct gpio_pin *pin)
 
     pin->config.trigger = TRIGGER_NONE;
     pin->fd = -1;
+    stub_unlock(stub_priv);
 }
 
 int hal_apply_interrupts(struct gpio_pin *pin, ErlNifEnv *env)
@@ -261,12 +512,34 @@ int hal_apply_interrupts(struct gpio_pin *pin, ErlNifEnv *env)
     if (base < 0)
         return -ENOENT;
 
-    // Notification settings live on pin->config and are read live when a line
-    // changes; just (re)assert ownership of the lines.
+    stub_lock(stub_priv);
+
+    // (Re)assert ownership of the lines
     for (int i = 0; i < pin->num_lines; i++)
         stub_priv->owner[base + pin->offsets[i]] = pin;
 
-    return 0;
+    struct stub_listener *listener = find_listener(stub_priv, pin);
+    if (listener)
+        clear_listener(listener);
+
+    int rc = 0;
+    if (pin->config.trigger != TRIGGER_NONE) {
+        listener = find_listener(stub_priv, NULL);
+        if (listener) {
+            listener->pin = pin;
+            listener->num_subs = pin->num_subs;
+            for (int i = 0; i < pin->num_subs; i++) {
+                enif_keep_resource(pin->subs[i]);
+                listener->subs[i] = pin->subs[i];
+            }
+        } else {
+            rc = -ENOSPC;
+        }
+    }
+    stub_unlock(stub_priv);
+
+    wake_timer(stub_priv);
+    return rc;
 }
 
 int hal_apply_direction(struct gpio_pin *pin)
@@ -276,6 +549,8 @@ int hal_apply_direction(struct gpio_pin *pin)
     if (base < 0)
         return -ENOENT;
 
+    stub_lock(stub_priv);
+
     for (int i = 0; i < pin->num_lines; i++) {
         int gidx = base + pin->offsets[i];
         if (pin->config.is_output) {
@@ -286,6 +561,7 @@ int hal_apply_direction(struct gpio_pin *pin)
         }
     }
 
+    stub_unlock(stub_priv);
     return 0;
 }
 
@@ -345,6 +621,7 @@ int hal_get_status(void *hal_priv, ErlNifEnv *env, const char *gpiochip, int off
 
     ERL_NIF_TERM map = enif_make_new_map(env);
 
+    stub_lock(stub_priv);
     int in_use = stub_priv->in_use[pin_index];
     ERL_NIF_TERM consumer = make_string_binary(env, in_use > 0 ? "stub" : "");
 
@@ -383,6 +660,7 @@ int hal_get_status(void *hal_priv, ErlNifEnv *env, const char *gpiochip, int off
         pull_mode_str = "none";
         drive_mode_str = "push_pull";
     }
+    stub_unlock(stub_priv);
 
     enif_make_map_put(env, map, atom_consumer, consumer, &map);
     enif_make_map_put(env, map, enif_make_atom(env, "direction"), enif_make_atom(env, is_output ? "output" : "input"), &map);
@@ -58,3 +58,17 @@ int enif_get_boolean(ErlNifEnv *env, ERL_NIF_TERM term, bool *v)
 
     return true;
 }
+
+bool get_option_int64(ErlNifEnv *env, ERL_NIF_TERM map, const char *key, int64_t min, int64_t max, int64_t *value)
+{
+    ERL_NIF_TERM term;
+    if (!enif_get_map_value(env, map, enif_make_atom(env, key), &term))
+        return true;
+
+    ErlNifSInt64 v;
+    if (!enif_get_int64(env, term, &v) || v < min || v > max)
+        return false;
+
+    *value = v;
+    return true;
+}
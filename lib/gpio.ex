@@ -194,14 +194,127 @@ defmodule Circuits.GPIO do
   Options for `subscribe/2`
 
   * `:receiver` - process that should receive notifications. Defaults to the
-    calling process (`self()`).
+    calling process (`self()`). For a group, this may also be a list with one
+    process per GPIO (first GPIO first) to route each line's changes to a
+    different process. Use `nil` for lines that shouldn't be reported.
+  * `:lines` - bitmask of the group's lines to report changes on. Defaults to
+    all lines.
+  * `:match` - `{mask, pattern}` to only report when `value &&& mask` starts
+    or stops being `pattern`
+  * `:mode` - process changes in the NIF instead of reporting them. See
+    `t:subscription_mode/0`.
+  * `:each_pulse` - for `mode: :pulse`, send a notification for every pulse.
+    Defaults to `false`.
+  * `:frame_gap_us` - for `mode: :wiegand`, how long without bits ends a
+    frame. Defaults to `25_000`.
+  * `:data` - for `mode: :capture`, the handle to read on each strobe edge
+  * `:batch` - for `mode: :capture`, how many records to send in each
+    notification (1 to 4096). Defaults to `64`.
+  * `:flush_ms` - for `mode: :capture`, send a partial batch this long after
+    its first record. `0` only sends full batches. Defaults to `10`.
+  * `:reflex` - `{output_handle, rule}` or `{output_handle, rule, lines}` to
+    drive an output from C when the input changes. See `t:reflex_rule/0`.
+  * `:report_ms` - for `mode: :encoder`, the minimum time between position
+    notifications. For `mode: :counter` and `mode: :pulse`, how often to send
+    the counts or measurements. Defaults to `0` (no notifications).
+  * `:window_ms` - for `mode: :counter`, how far back the frequency is
+    measured. Defaults to `1000`.
+  * `:settle_ns` - merge edges that arrive within this many nanoseconds of the
+    first one into a single notification. Defaults to `0` (no merging).
+  * `:debounce_us` - only report a line's change after it has been stable for
+    this many microseconds. Defaults to `0` (no debouncing).
+  * `:timeout_ms` - send a timeout notification if no edge happens for this
+    long. Defaults to `0` (no timeouts).
   * `:tag` - a term echoed in the `:ref` field of every notification instead of
     the auto-generated reference. Use this to route messages with a
     domain-specific label.
   * `:trigger` - send notifications on the `:rising` edges, `:falling` edges, or
     `:both`. Defaults to `:both`.
   """
-  @type subscribe_options() :: [trigger: trigger(), receiver: pid() | atom(), tag: term()]
+  @type subscribe_options() :: [
+          trigger: trigger(),
+          receiver: pid() | atom() | [pid() | atom() | nil],
+          lines: non_neg_integer(),
+          match: {non_neg_integer(), non_neg_integer()},
+          mode: subscription_mode(),
+          each_pulse: boolean(),
+          frame_gap_us: pos_integer(),
+          data: Handle.t(),
+          batch: pos_integer(),
+          flush_ms: non_neg_integer(),
+          reflex: {Handle.t(), reflex_rule()} | {Handle.t(), reflex_rule(), non_neg_integer()},
+          report_ms: non_neg_integer(),
+          window_ms: pos_integer(),
+          settle_ns: non_neg_integer(),
+          debounce_us: non_neg_integer(),
+          timeout_ms: non_neg_integer(),
+          tag: term()
+        ]
+
+  @typedoc """
+  What a reflex does to its output
+
+  The input is active while any of the subscription's `:lines` is high or,
+  with `:match`, while the pattern matches. Rising and falling refer to the
+  input becoming active and inactive.
+
+  * `:mirror` - drive the output high while the input is active
+  * `:invert` - drive the output low while the input is active
+  * `:set_on_rising`, `:set_on_falling` - drive the output high
+  * `:clear_on_rising`, `:clear_on_falling` - drive the output low
+  * `{:pulse, microseconds}` - drive the output high when the input becomes
+    active and low again after this long. Another activation restarts the
+    pulse.
+  """
+  @type reflex_rule() ::
+          :mirror
+          | :invert
+          | :set_on_rising
+          | :set_on_falling
+          | :clear_on_rising
+          | :clear_on_falling
+          | {:pulse, pos_integer()}
+
+  @typedoc """
+  Subscription modes
+
+  * `:encoder` - decode a quadrature (rotary) encoder on a 2-line group (`A`
+    is bit 0, `B` is bit 1) or 3-line group (bit 2 is the index line). See
+    `read_counter/3`.
+  * `:counter` - count edges and measure their frequency on each line. See
+    `read_counter/3`.
+  * `:pulse` - measure pulse widths, periods, and duty cycles on each line. See
+    `read_pulses/3`.
+  * `:latch` - remember which lines had edges. See `read_latched/2`.
+  * `:capture` - read another handle on each strobe edge. See `subscribe/2`.
+  * `:wiegand`, `:nec`, `:dht` - protocol decoders. See `subscribe/2`.
+  """
+  @type subscription_mode() :: :encoder | :counter | :pulse | :latch | :capture | :wiegand | :nec | :dht
+
+  @typedoc """
+  Options for `subscribe_merged/2`
+
+  * `:receiver` - process that should receive notifications. Defaults to the
+    calling process (`self()`).
+  * `:reorder_ns` - how long to hold notifications so that ones from different
+    handles can be sent in timestamp order. Defaults to `0`.
+  * `:settle_ns` - see `t:subscribe_options/0`. Applies to each handle.
+  * `:debounce_us` - see `t:subscribe_options/0`. Applies to each handle.
+  * `:timeout_ms` - see `t:subscribe_options/0`. Applies to each handle.
+  * `:tag` - a term echoed in the `:ref` field instead of the auto-generated
+    reference.
+  * `:trigger` - send notifications on the `:rising`, `:falling`, or `:both`
+    edges. Defaults to `:both`.
+  """
+  @type subscribe_merged_options() :: [
+          trigger: trigger(),
+          receiver: pid() | atom(),
+          reorder_ns: non_neg_integer(),
+          settle_ns: non_neg_integer(),
+          debounce_us: non_neg_integer(),
+          timeout_ms: non_neg_integer(),
+          tag: term()
+        ]
 
   @doc """
   Guard version of `gpio_spec?/1`
@@ -291,6 +404,10 @@ defmodule Circuits.GPIO do
   experimenting at the IEx prompt when you lose a reference. The `:on_busy`
   option only works for handles known to the running BEAM instance.
 
+  To share GPIOs between processes without funneling everything through one
+  of them, open them together as a group and give each process a sub-handle
+  from `open_sub/2`.
+
   ## Troubleshooting
 
   The most common issue is figuring out the names or labels on GPIOs. See
@@ -448,6 +565,37 @@ defmodule Circuits.GPIO do
     check_options!(rest)
   end
 
+  @doc """
+  Open a sub-handle onto some of a group handle's GPIOs
+
+  Sub-handles share the group's line request, so they work when the GPIOs
+  are already open. This lets several processes use different GPIOs from
+  the same group without coordinating. `lines` are bit positions in the
+  group's value, and the first one is bit 0 of the sub-handle's value:
+
+  ```elixir
+  iex> {:ok, port} = Circuits.GPIO.open([{"gpiochip0", 2}, {"gpiochip0", 3}, {"gpiochip0", 4}], :output)
+  iex> {:ok, led} = Circuits.GPIO.open_sub(port, [2])
+  iex> Circuits.GPIO.write(led, 1)   # GPIO 4 -> 1. GPIOs 2 and 3 aren't touched.
+  :ok
+  ```
+
+  Writes only change the sub-handle's GPIOs and are done in one call to the
+  kernel, so writes from other processes can't be undone. Reads and
+  subscriptions work like they do on any other handle, but only include the
+  sub-handle's GPIOs. Each sub-handle's subscriptions are separate from the
+  group's and count towards the group's subscriber limit. The direction,
+  pull mode and drive mode are shared with the group, so those can only be
+  changed on the group handle. `set_interrupts/3` isn't supported.
+
+  Sub-handles keep the group's GPIOs open until they're all closed or garbage
+  collected. Closing the group handle closes them too.
+  """
+  @spec open_sub(Handle.t(), [non_neg_integer()]) :: {:ok, Handle.t()} | {:error, atom()}
+  def open_sub(handle, lines) when is_list(lines) and lines != [] do
+    Handle.open_sub(handle, lines)
+  end
+
   @doc """
   Release the resources associated with a GPIO
 
@@ -594,10 +742,48 @@ defmodule Circuits.GPIO do
   returns `{:ok, ref}` where `ref` is a reference echoed in every notification
   so you can match messages to this subscription.
 
+  A handle can have more than one subscription. Each call adds a subscription
+  with its own receiver, trigger, and ref, and every subscription gets its own
+  copy of each notification. This is cheaper than relaying messages from one
+  process to others. Calling `set_interrupts/3` replaces all subscriptions.
+
   Available options:
 
   * `:receiver` - process that should receive notifications. Defaults to the
-    calling process (`self()`).
+    calling process (`self()`). For a group, pass a list with one entry per GPIO
+    to send each line's changes to a different process. Lines with a `nil`
+    entry aren't reported. Notifications still carry the whole group's value.
+  * `:lines` - bitmask of lines to report changes on (bit 0 is the first GPIO).
+    Changes on other lines are dropped in the NIF and don't cost a message.
+    Their current state is still included in `value`. Defaults to all lines.
+  * `:match` - `{mask, pattern}` to only report when the masked group value
+    enters or leaves `pattern`, i.e., when `(value &&& mask) == pattern`
+    changes. With this option, `:trigger` selects entering (`:rising`),
+    leaving (`:falling`), or `:both`. Every bit set in `pattern` must also be
+    set in `mask`.
+  * `:settle_ns` - wait this long after an edge and report everything that
+    changed in that window as one notification. This is useful for parallel
+    buses and switches where several lines change at nearly the same time.
+    The window starts at the first edge and doesn't get extended. Defaults to
+    `0`, which reports every edge separately.
+  * `:debounce_us` - software debounce for switches, buttons, and relay
+    contacts. A line's edges are held until it has stayed the same for this
+    many microseconds. Then its value is re-read and reported if it's
+    different from the last one reported. A press that bounces is one
+    notification and a glitch that goes back to where it started isn't
+    reported at all. The timestamp is from the line's last edge. This works
+    on any GPIO controller and applies before `:settle_ns` and modes.
+    Defaults to `0` (off).
+  * `:timeout_ms` - watchdog for inactive or stuck lines. If no edge happens on
+    the subscribed lines for this many milliseconds, a timeout notification is
+    sent. It's sent once per quiet period and the next edge restarts the
+    timer. The timer starts when this function is called. Defaults to `0` (off).
+  * `:mode` - handle changes in the NIF instead of sending them. See below.
+  * `:reflex` - drive an output directly from the NIF. See below.
+  * `:each_pulse` - see below.
+  * `:frame_gap_us` - see below.
+  * `:report_ms` - see below.
+  * `:window_ms` - see below.
   * `:tag` - a term echoed in the `:ref` field instead of the auto-generated
     reference.
   * `:trigger` - send notifications on the `:rising`, `:falling`, or `:both`
@@ -616,6 +802,167 @@ defmodule Circuits.GPIO do
   the changed bits. It's possible to receive reports with no changes due to
   transients.
 
+  When `:settle_ns` is set, the notification has the value at the end of the
+  window, the value from before its first edge, and a `changed` key with a bit
+  set for each line that had an edge in the window. `changed` catches lines that
+  toggled and came back, which `Bitwise.bxor/2` wouldn't show.
+
+  Timeout notifications from `:timeout_ms` look like:
+
+  ```
+  {:circuits_gpio, %{ref: ref, event: :timeout, timestamp: timestamp, value: value}}
+  ```
+
+  Where `value` is the last value seen by the subscription.
+
+  ## Reflexes
+
+  Interlocks and emergency stops shouldn't wait for a process to be scheduled.
+  A reflex drives an output from the notification thread as soon as the edge
+  is seen and before the notification is sent:
+
+  ```elixir
+  {:ok, estop} = Circuits.GPIO.open("ESTOP", :input)
+  {:ok, enable} = Circuits.GPIO.open("MOTOR_ENABLE", :output, initial_value: 1)
+  {:ok, _ref} = Circuits.GPIO.subscribe(estop, reflex: {enable, :clear_on_rising})
+  ```
+
+  Pass `{output_handle, rule, lines}` to only drive some lines of an output
+  group. `:mirror` and `:invert` set the output right away. The input goes
+  through `:debounce_us` first, and `:match` and `:lines` select what makes
+  it active. See `t:reflex_rule/0` for the rules. Pass `trigger: :none` if
+  you don't want notifications.
+
+  The reflex keeps running if the receiver exits. It stops when the
+  subscription is removed or either handle is closed. It needs a single
+  receiver and can't be used with `subscribe_merged/2`.
+
+  ## Modes
+
+  Signals that change too quickly for a message per edge can be processed by
+  the NIF instead. Pass `:mode` to pick what to do with the changes and read
+  the results with the function for that mode. Modes need a single receiver.
+  They handle each edge themselves, so passing `:match` or `:settle_ns` with a
+  mode raises an `ArgumentError`. `:lines` picks the lines to use for
+  `:counter`, `:pulse`, `:latch`, and `:capture` and is ignored by the other
+  modes.
+
+  `mode: :encoder` decodes a quadrature encoder. The handle needs 2 lines, `A`
+  and `B`, with an optional third index line. Every state change counts, so
+  the position changes by 4 for each full cycle of `A` and `B`. Transitions
+  that skip a state are counted as errors. Read the position with
+  `read_counter/3`. To also get notifications when the position changes, set
+  `:report_ms` to the minimum time between them:
+
+  ```
+  {:circuits_gpio, %{ref: ref, event: :position, timestamp: timestamp, position: position, errors: errors}}
+  ```
+
+  `mode: :counter` counts the edges selected by `:trigger` on each line in
+  `:lines` and measures their frequency. This is for flow meters,
+  anemometers, tachometers, and other sensors that produce many pulses. The
+  frequency is in cycles per second over the last `:window_ms` milliseconds.
+  With `trigger: :both`, it counts two edges as one cycle. Read the counts
+  with `read_counter/3`. To get them periodically instead, set `:report_ms`:
+
+  ```
+  {:circuits_gpio, %{ref: ref, event: :count, timestamp: timestamp, lines: lines}}
+  ```
+
+  `lines` is the same as in `read_counter/3`.
+
+  `mode: :pulse` measures pulses on each line in `:lines` using the edge
+  timestamps. It's for PWM feedback, ultrasonic echoes, RC receivers, and
+  other signals where the timing between edges matters. A pulse is the time
+  from a rising edge to the next falling edge. It's measured when it ends
+  along with the low time and period before it. The measurements are
+  summarized. Read the summary with `read_pulses/3` or set `:report_ms` to
+  get it and start a new one periodically:
+
+  ```
+  {:circuits_gpio, %{ref: ref, event: :pulses, timestamp: timestamp, lines: lines}}
+  ```
+
+  To get every pulse instead, set `each_pulse: true`:
+
+  ```
+  {:circuits_gpio, %{ref: ref, event: :pulse, timestamp: timestamp, line: line, high_ns: high_ns, low_ns: low_ns, period_ns: period_ns}}
+  ```
+
+  `line` is the line's bit number. `low_ns` and `period_ns` are `nil` for the
+  first pulse.
+
+  `mode: :latch` records which lines in `:lines` had rising and falling edges
+  so that a control loop that calls `read_latched/2` now and then doesn't miss
+  short pulses. It never sends messages.
+
+  `mode: :capture` reads a parallel bus that's qualified by a strobe. The
+  subscribed handle has the strobe and `:data` is an input handle with the
+  bus. On each strobe edge selected by `:trigger` on the lines in `:lines`,
+  the NIF reads `:data` right away so that the value is from before the
+  device moves on to the next one. The values are sent in batches of
+  `:batch` records:
+
+  ```
+  {:circuits_gpio, %{ref: ref, event: :capture, timestamp: timestamp, data: data}}
+  ```
+
+  `timestamp` is the first record's. Each record in `data` is the strobe
+  edge's timestamp and the bus value:
+
+  ```elixir
+  for <<timestamp::little-signed-64, value::little-64 <- data>>, do: {timestamp, value}
+  ```
+
+  The read happens when the edge is seen rather than at the edge, so the data
+  needs to be held for longer than the notification latency. Edges where the
+  read fails are counted. That includes edges after `:data` is closed, so
+  unsubscribe before closing it. See `read_capture/3`.
+
+  ### Protocol decoders
+
+  Decoder modes turn the edges of a protocol into one notification per frame.
+  They run on the edge timestamps, so they aren't affected by how busy the
+  BEAM is. Frames that don't decode are counted but not sent. Call
+  `read_counter/3` to get `%{frames: frames, errors: errors}`.
+
+  `mode: :wiegand` reads an access control reader on a 2-line group (`D0` is
+  bit 0 and `D1` is bit 1). A frame ends when no bits come for
+  `:frame_gap_us` microseconds. `data` has the bits with the first one
+  received as the most significant. Parity checks depend on the card format,
+  so they're left to you.
+
+  ```
+  {:circuits_gpio, %{ref: ref, event: :wiegand, timestamp: timestamp, bits: bits, data: data}}
+  ```
+
+  `mode: :nec` reads NEC infrared remote codes from the output of an IR
+  receiver module on a 1-line handle. Held buttons send repeats with the last
+  address and command. Extended NEC addresses are 16 bits.
+
+  ```
+  {:circuits_gpio, %{ref: ref, event: :nec, timestamp: timestamp, address: address, command: command, repeat: repeat}}
+  ```
+
+  `mode: :dht` reads DHT22 and AM2302 temperature and humidity sensors on a
+  1-line handle. Start a reading by switching the line to an output, driving
+  it low for at least 1 ms, and switching it back to an input. Edge detection
+  is off while the line is an output and comes back when it's an input again.
+  The temperature is in °C and the humidity is in %. `raw` has the 40 bits
+  that were received so other DHT models can be decoded.
+
+  ```elixir
+  {:ok, ref} = Circuits.GPIO.subscribe(gpio, mode: :dht)
+  :ok = Circuits.GPIO.set_direction(gpio, :output)
+  :ok = Circuits.GPIO.write(gpio, 0)
+  Process.sleep(2)
+  :ok = Circuits.GPIO.set_direction(gpio, :input)
+  ```
+
+  ```
+  {:circuits_gpio, %{ref: ref, event: :dht, timestamp: timestamp, temperature: temperature, humidity: humidity, raw: raw}}
+  ```
+
   Timestamps are not necessarily the same as from `System.monotonic_time/0`.
   For example, with the cdev backend, they're applied by the Linux kernel or
   can be come from a hardware timer. Erlang's monotonic time is adjusted so
@@ -630,11 +977,176 @@ defmodule Circuits.GPIO do
   defdelegate subscribe(handle, options \\ []), to: Handle
 
   @doc """
-  Stop GPIO value change notifications started with `subscribe/2`
+  Subscribe to change notifications from several handles as one stream
+
+  This is like calling `subscribe/2` on each handle with the same receiver and
+  ref, except that notifications have a `source` key with the index of the
+  handle in `handles` and they arrive in timestamp order. The handles can be on
+  different GPIO controllers.
+
+  ```
+  {:circuits_gpio, %{ref: ref, source: source, timestamp: timestamp, value: value, previous_value: previous_value}}
+  ```
+
+  Edges that are waiting when the notification thread wakes up are always
+  sorted. Edges on different handles can still be reported slightly out of
+  order. To sort those too, set
+  `:reorder_ns` to hold each notification for that long before it's sent. A
+  few hundred microseconds is usually enough. It adds that much latency to
+  every notification.
+
+  See `t:subscribe_merged_options/0` for options. Call `unsubscribe/2` on each
+  handle with the returned ref to stop notifications.
+  """
+  @spec subscribe_merged([Handle.t()], subscribe_merged_options()) ::
+          {:ok, term()} | {:error, atom()}
+  def subscribe_merged([first | _] = handles, options \\ []) do
+    Handle.subscribe_merged(first, handles, options)
+  end
+
+  @doc """
+  Stop all GPIO value change notifications started with `subscribe/2`
   """
   @spec unsubscribe(Handle.t()) :: :ok | {:error, atom()}
   defdelegate unsubscribe(handle), to: Handle
 
+  @doc """
+  Stop the GPIO value change notifications for one subscription
+
+  Pass the ref (or `:tag`) returned by `subscribe/2`. Other subscriptions on the
+  handle keep running.
+  """
+  @spec unsubscribe(Handle.t(), term()) :: :ok | {:error, atom()}
+  defdelegate unsubscribe(handle, ref), to: Handle
+
+  @doc """
+  Send a handle's notifications to another process
+
+  This is for handing a GPIO to a new owner without closing it. Reopening
+  would briefly release the GPIO, which can glitch outputs, and rebuilding
+  subscriptions would miss edges. Instead, the handle stays open and every
+  subscription made on it switches to `pid` in place. Settle windows,
+  debounces, and the state of subscription modes carry over. Messages
+  already sent stay in the old process's mailbox.
+
+  `pid` can also be a registered name. Subscriptions on sub-handles from
+  `open_sub/2` aren't affected since they belong to those handles.
+  Subscriptions stop for good when their process exits, so transfer them
+  before the old owner exits.
+
+  A `subscribe_merged/2` stream is shared by all of its handles, so this
+  returns `{:error, :merged}` and changes nothing if the handle has one
+  that another handle is still part of.
+  """
+  @spec transfer(Handle.t(), pid() | atom()) :: :ok | {:error, atom()}
+  def transfer(handle, pid) when is_pid(pid), do: Handle.transfer(handle, pid)
+
+  def transfer(handle, name) when is_atom(name) do
+    case Process.whereis(name) do
+      nil -> {:error, :not_found}
+      pid -> Handle.transfer(handle, pid)
+    end
+  end
+
+  @doc """
+  Read the counts from a `mode: :encoder`, `mode: :counter`, or decoder subscription
+
+  Pass the ref returned by `subscribe/2`. This doesn't send any messages and is
+  cheap enough to call in a control loop.
+
+  For `mode: :encoder`, this returns a map with:
+
+  * `:position` - current position in counts (4 per cycle)
+  * `:errors` - number of invalid transitions seen
+  * `:index_count` - number of rising edges on the index line
+  * `:index_position` - position at the last index edge
+
+  For `mode: :counter`, this returns a map with a `:timestamp` and `:lines`.
+  `:lines` has a map for each line in the group (bit 0 first) with:
+
+  * `:count` - number of edges counted
+  * `:frequency` - cycles per second over the window as a float
+  * `:first_timestamp` - timestamp of the first edge counted or `nil`
+  * `:last_timestamp` - timestamp of the last edge counted or `nil`
+
+  For the protocol decoders, this returns a map with the number of `:frames`
+  decoded and `:errors`.
+
+  Options:
+
+  * `:clear` - set everything back to `0` after reading. Defaults to `false`.
+  """
+  @spec read_counter(Handle.t(), term(), clear: boolean()) :: {:ok, map()} | {:error, atom()}
+  def read_counter(handle, ref, options \\ []) do
+    Handle.read_subscription(handle, ref, Keyword.get(options, :clear, false))
+  end
+
+  @doc """
+  Read the measurements from a `mode: :pulse` subscription
+
+  Pass the ref returned by `subscribe/2`. Returns a map with a `:timestamp` and
+  `:lines`. `:lines` has a map for each line in the group (bit 0 first) with:
+
+  * `:count` - number of pulses measured
+  * `:high_ns` - pulse widths
+  * `:low_ns` - time between pulses
+  * `:period_ns` - time from one rising edge to the next
+  * `:duty` - `high_ns / (high_ns + low_ns)` as a float from 0 to 1
+
+  Each measurement is `%{min: min, max: max, mean: mean}` or `nil` if there
+  wasn't one.
+
+  Options:
+
+  * `:clear` - start a new summary after reading. Defaults to `false`.
+  """
+  @spec read_pulses(Handle.t(), term(), clear: boolean()) :: {:ok, map()} | {:error, atom()}
+  def read_pulses(handle, ref, options \\ []) do
+    Handle.read_subscription(handle, ref, Keyword.get(options, :clear, false))
+  end
+
+  @doc """
+  Take the records waiting in a `mode: :capture` subscription
+
+  Pass the ref returned by `subscribe/2`. Returns a map with:
+
+  * `:data` - records that haven't been sent yet in the same format as the
+    `:capture` notification. They won't be sent.
+  * `:errors` - how many strobe edges had failed reads
+
+  Options:
+
+  * `:clear` - set `:errors` back to `0` after reading. Defaults to `false`.
+  """
+  @spec read_capture(Handle.t(), term(), clear: boolean()) :: {:ok, map()} | {:error, atom()}
+  def read_capture(handle, ref, options \\ []) do
+    Handle.read_subscription(handle, ref, Keyword.get(options, :clear, false))
+  end
+
+  @doc """
+  Read which lines had edges
+
+  This needs a `mode: :latch` subscription on the handle:
+
+  ```elixir
+  {:ok, _ref} = Circuits.GPIO.subscribe(handle, mode: :latch)
+  ```
+
+  Returns `{:ok, %{rising: rising, falling: falling}}` with a bit set for each
+  line that went high or low since the latch was last cleared. A line that
+  pulsed has its bit set in both. Returns `{:error, :not_found}` if there's no
+  `mode: :latch` subscription.
+
+  Options:
+
+  * `:clear` - clear the latch in the same step as reading it so that no edges
+    are lost between the two. Defaults to `false`.
+  """
+  @spec read_latched(Handle.t(), clear: boolean()) :: {:ok, map()} | {:error, atom()}
+  def read_latched(handle, options \\ []) do
+    Handle.read_latched(handle, Keyword.get(options, :clear, false))
+  end
+
   @doc """
   Change the direction of the pin
   """
@@ -0,0 +1,47 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+
+defmodule Circuits.GPIO.CApi do
+  @moduledoc """
+  Use GPIO handles from other NIF libraries
+
+  Drivers like SPI displays often need to toggle a GPIO, like a data/command
+  line, between every transfer. Going back to Elixir for each one adds a lot
+  of latency. Instead, the driver's NIF can read and write the handle
+  directly using the function table in `c_src/circuits_gpio_api.h`.
+
+  Add `-I$(MIX_DEPS_PATH)/circuits_gpio/c_src` to the other library's
+  `CFLAGS` and pass it the table's address and the handle's resource:
+
+  ```elixir
+  iex> {:ok, dc} = Circuits.GPIO.open("SPI_DC", :output)
+  iex> {:ok, %{address: address}} = Circuits.GPIO.CApi.api()
+  iex> {:ok, resource} = Circuits.GPIO.CApi.resource(dc)
+  iex> MyDisplay.Nif.attach_dc(address, resource)
+  ```
+
+  See the header for the C side. The table stays valid as long as
+  Circuits.GPIO is loaded. The other library should hold a reference to the
+  handle for as long as it uses it. Closing the handle from Elixir still
+  works and reads and writes return `-EBADF` after that.
+
+  Only the `Circuits.GPIO.CDev` backend supports this.
+  """
+
+  @doc """
+  Return the C API's version and the function table's address
+  """
+  @spec api() :: {:ok, %{version: pos_integer(), address: non_neg_integer()}}
+  def api() do
+    {version, address} = Circuits.GPIO.Nif.c_api()
+    {:ok, %{version: version, address: address}}
+  end
+
+  @doc """
+  Return the resource to pass to other NIF libraries for a handle
+  """
+  @spec resource(Circuits.GPIO.Handle.t()) :: {:ok, reference()} | {:error, :not_supported}
+  def resource(%Circuits.GPIO.CDev{ref: ref}), do: {:ok, ref}
+  def resource(_handle), do: {:error, :not_supported}
+end
@@ -27,6 +27,7 @@ defmodule Circuits.GPIO.CDev do
   alias Circuits.GPIO.Backend
   alias Circuits.GPIO.Handle
   alias Circuits.GPIO.Nif
+  alias Circuits.GPIO.Receiver
 
   defstruct [:ref, :locations]
 
@@ -169,6 +170,26 @@ defmodule Circuits.GPIO.CDev do
   end
 
   defimpl Handle do
+    import Bitwise
+
+    # Options for subscribe/2 that are handled by the NIF
+    @subscribe_options [
+      :settle_ns,
+      :debounce_us,
+      :timeout_ms,
+      :lines,
+      :match,
+      :mode,
+      :report_ms,
+      :window_ms,
+      :each_pulse,
+      :frame_gap_us,
+      :reflex,
+      :data,
+      :batch,
+      :flush_ms
+    ]
+
     @impl Handle
     def read(%Circuits.GPIO.CDev{ref: ref}) do
       Nif.read(ref)
@@ -206,36 +227,132 @@ defmodule Circuits.GPIO.CDev do
     @impl Handle
     def set_interrupts(%Circuits.GPIO.CDev{ref: ref}, trigger, options) do
       suppress_glitches = Keyword.get(options, :suppress_glitches, true)
-      Nif.set_interrupts(ref, trigger, suppress_glitches, resolve_receiver(options))
+      Nif.set_interrupts(ref, trigger, suppress_glitches, Receiver.resolve(options))
     end
 
     @impl Handle
-    def subscribe(%Circuits.GPIO.CDev{ref: ref}, options) do
+    def subscribe(%Circuits.GPIO.CDev{ref: ref, locations: locations}, options) do
       notify_id = Keyword.get(options, :tag) || make_ref()
       trigger = Keyword.get(options, :trigger) || :both
+      routes = resolve_routes(Keyword.get(options, :receiver), length(locations))
+      nif_options =
+        options |> Keyword.take(@subscribe_options) |> Map.new() |> resolve_reflex() |> resolve_data()
 
-      case Nif.subscribe(ref, notify_id, trigger, resolve_receiver(options)) do
+      case Nif.subscribe(ref, notify_id, trigger, routes, nif_options) do
         :ok -> {:ok, notify_id}
         error -> error
       end
     end
 
+    @impl Handle
+    def subscribe_merged(%Circuits.GPIO.CDev{}, handles, options) do
+      if Enum.all?(handles, &is_struct(&1, Circuits.GPIO.CDev)) do
+        notify_id = Keyword.get(options, :tag) || make_ref()
+        trigger = Keyword.get(options, :trigger) || :both
+        nif_options = options |> Keyword.take([:settle_ns, :debounce_us, :timeout_ms, :reorder_ns]) |> Map.new()
+        refs = Enum.map(handles, & &1.ref)
+
+        case Nif.subscribe_merged(refs, notify_id, trigger, Receiver.resolve(options), nif_options) do
+          :ok -> {:ok, notify_id}
+          error -> error
+        end
+      else
+        {:error, :mixed_backends}
+      end
+    end
+
     @impl Handle
     def unsubscribe(%Circuits.GPIO.CDev{ref: ref}) do
       Nif.unsubscribe(ref)
     end
 
+    @impl Handle
+    def unsubscribe(%Circuits.GPIO.CDev{ref: ref}, notify_id) do
+      Nif.unsubscribe(ref, notify_id)
+    end
+
+    @impl Handle
+    def transfer(%Circuits.GPIO.CDev{ref: ref}, pid) do
+      Nif.transfer(ref, pid)
+    end
+
+    @impl Handle
+    def read_subscription(%Circuits.GPIO.CDev{ref: ref}, notify_id, clear) do
+      Nif.read_subscription(ref, notify_id, clear)
+    end
+
+    @impl Handle
+    def read_latched(%Circuits.GPIO.CDev{ref: ref}, clear) do
+      Nif.read_latched(ref, clear)
+    end
+
+    @impl Handle
+    def open_sub(%Circuits.GPIO.CDev{ref: ref, locations: locations}, lines) do
+      num_lines = length(locations)
+
+      cond do
+        not Enum.all?(lines, &(is_integer(&1) and &1 >= 0 and &1 < num_lines)) ->
+          {:error, :not_found}
+
+        lines != Enum.uniq(lines) ->
+          {:error, :duplicate_lines}
+
+        true ->
+          with {:ok, sub_ref} <- Nif.open_sub(ref, lines) do
+            sub_locations = Enum.map(lines, &Enum.at(locations, &1))
+            {:ok, %Circuits.GPIO.CDev{ref: sub_ref, locations: sub_locations}}
+          end
+      end
+    end
+
     @impl Handle
     def close(%Circuits.GPIO.CDev{ref: ref}) do
       Nif.close(ref)
     end
 
-    defp resolve_receiver(options) do
-      case Keyword.get(options, :receiver) do
-        pid when is_pid(pid) -> pid
-        name when is_atom(name) and not is_nil(name) -> Process.whereis(name) || self()
-        _ -> self()
+    # The NIF needs the output's resource
+    defp resolve_reflex(%{reflex: reflex} = options) when is_tuple(reflex) do
+      case Tuple.to_list(reflex) do
+        [%Circuits.GPIO.CDev{ref: output} | rest] ->
+          %{options | reflex: List.to_tuple([output | rest])}
+
+        _ ->
+          raise ArgumentError, ":reflex output should be a Circuits.GPIO.CDev handle"
+      end
+    end
+
+    defp resolve_reflex(options), do: options
+
+    defp resolve_data(%{data: %Circuits.GPIO.CDev{ref: data}} = options) do
+      %{options | data: data}
+    end
+
+    defp resolve_data(%{data: _}) do
+      raise ArgumentError, ":data should be a Circuits.GPIO.CDev handle"
+    end
+
+    defp resolve_data(options), do: options
+
+    # Routes are {pid, line_mask} pairs. A list of receivers has one entry per
+    # line (bit 0 first) and lines going to the same process share a route.
+    # `nil` entries aren't routed anywhere.
+    defp resolve_routes(receivers, num_lines) when is_list(receivers) do
+      if length(receivers) != num_lines do
+        raise ArgumentError,
+              ":receiver list should have one entry per GPIO in the handle (#{num_lines})"
       end
+
+      receivers
+      |> Enum.with_index()
+      |> Enum.reject(fn {receiver, _bit} -> is_nil(receiver) end)
+      |> Enum.group_by(fn {receiver, _bit} -> Receiver.resolve_pid(receiver) end, &elem(&1, 1))
+      |> Enum.map(fn {pid, bits} -> {pid, bits_to_mask(bits)} end)
     end
+
+    defp resolve_routes(receiver, num_lines) do
+      [{Receiver.resolve_pid(receiver), (1 <<< num_lines) - 1}]
+    end
+
+    defp bits_to_mask(bits), do: Enum.reduce(bits, 0, fn bit, acc -> acc ||| 1 <<< bit end)
   end
 end
@@ -0,0 +1,172 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+
+defmodule Circuits.GPIO.FlightRecorder do
+  @moduledoc """
+  Record a handle's edges to a file that survives crashes
+
+  The recorder writes every edge on the handle to a ring in a memory-mapped
+  file. Adding an edge is a few memory writes, so it's cheap enough to leave
+  on. The file is updated by the kernel, so if the BEAM crashes or is killed,
+  the edges leading up to that are still there and can be read with
+  `read/1` after it restarts.
+
+  ```elixir
+  iex> {:ok, gpio} = Circuits.GPIO.open({"gpiochip0", 17}, :input)
+  iex> {:ok, _ref} = Circuits.GPIO.FlightRecorder.start(gpio, "/data/gpio17.fr")
+
+  # After a restart
+  iex> {:ok, %{records: records}} = Circuits.GPIO.FlightRecorder.read("/data/gpio17.fr")
+  ```
+
+  The file is replaced when a recorder starts, so use a different path for
+  each handle and copy the file somewhere else before starting a new
+  recorder if it's needed. Records are only as durable as the page cache, so
+  they don't survive power loss.
+
+  The recorder is a subscription, so it counts towards the handle's
+  subscriber limit and stops when the handle is closed. Only the
+  `Circuits.GPIO.CDev` backend supports recorders.
+
+  ## File format
+
+  All integers are little endian. The file starts with a 128-byte header:
+
+  | Offset | Field |
+  | ------ | ----- |
+  | 0 | `"GPIOFR01"` |
+  | 8 | u32 version (1) |
+  | 12 | u32 header size |
+  | 16 | u32 record size |
+  | 20 | u32 capacity in records |
+  | 24 | u64 records written (the next goes in slot `written % capacity`) |
+  | 32 | i64 `CLOCK_REALTIME - CLOCK_MONOTONIC` in nanoseconds at start |
+  | 40 | u32 number of lines |
+  | 48 | gpiochip path (64 bytes, NUL padded) |
+
+  The ring of 32-byte records follows:
+
+  | Offset | Field |
+  | ------ | ----- |
+  | 0 | i64 timestamp (`CLOCK_MONOTONIC` nanoseconds) |
+  | 8 | u64 handle value after the edge |
+  | 16 | u32 line request sequence number |
+  | 20 | u32 line offset |
+  | 24 | u8 `1` for rising or `2` for falling |
+  """
+
+  alias Circuits.GPIO.Handle
+  alias Circuits.GPIO.Nif
+
+  @header_size 128
+
+  @typedoc """
+  An edge from a recorder file
+
+  `:timestamp` is the same as in change notifications. `:system_time` is the
+  wall clock time in nanoseconds based on the clocks when the recorder
+  started.
+  """
+  @type record() :: %{
+          timestamp: integer(),
+          system_time: integer(),
+          value: non_neg_integer(),
+          seqno: non_neg_integer(),
+          offset: non_neg_integer(),
+          edge: :rising | :falling
+        }
+
+  @typedoc """
+  Options for `start/3`
+
+  * `:max_records` - how many edges the file holds before the oldest ones
+    are overwritten. Each takes 32 bytes. Defaults to `65_536`.
+  * `:tag` - the ref to return. Defaults to a new reference.
+  """
+  @type options() :: [max_records: pos_integer(), tag: term()]
+
+  @doc """
+  Start recording a handle's edges to a file
+
+  Returns a ref to pass to `stop/2`.
+  """
+  @spec start(Handle.t(), Path.t(), options()) :: {:ok, term()} | {:error, atom()}
+  def start(%Circuits.GPIO.CDev{ref: gpio}, path, options \\ []) do
+    ref = Keyword.get(options, :tag) || make_ref()
+    max_records = Keyword.get(options, :max_records, 65_536)
+
+    case Nif.recorder_start(gpio, ref, IO.chardata_to_string(path), max_records) do
+      :ok -> {:ok, ref}
+      error -> error
+    end
+  end
+
+  @doc """
+  Stop a recorder
+
+  The file is left as it is.
+  """
+  @spec stop(Handle.t(), term()) :: :ok | {:error, atom()}
+  def stop(handle, ref), do: Handle.unsubscribe(handle, ref)
+
+  @doc """
+  Read a recorder file
+
+  Returns the header fields and the records, oldest first.
+  """
+  @spec read(Path.t()) :: {:ok, map()} | {:error, atom()}
+  def read(path) do
+    with {:ok, contents} <- File.read(path), do: decode(contents)
+  end
+
+  @doc """
+  Decode the contents of a recorder file
+
+  See `read/1`.
+  """
+  @spec decode(binary()) :: {:ok, map()} | {:error, :invalid_file}
+  def decode(
+        <<"GPIOFR01", 1::little-32, header_size::little-32, record_size::little-32,
+          capacity::little-32, written::little-64, realtime_offset::little-signed-64,
+          num_lines::little-32, _::little-32, gpiochip::binary-64, _::binary>> = contents
+      )
+      when header_size >= @header_size and record_size >= 25 and capacity > 0 and
+             byte_size(contents) >= header_size + capacity * record_size do
+    ring = binary_part(contents, header_size, capacity * record_size)
+    count = min(written, capacity)
+    first = if written > capacity, do: rem(written, capacity), else: 0
+
+    records =
+      for i <- 0..(count - 1)//1 do
+        slot = rem(first + i, capacity)
+        decode_record(binary_part(ring, slot * record_size, record_size), realtime_offset)
+      end
+
+    {:ok,
+     %{
+       gpiochip: gpiochip |> :binary.split(<<0>>) |> hd(),
+       num_lines: num_lines,
+       capacity: capacity,
+       written: written,
+       records: records
+     }}
+  end
+
+  def decode(_contents), do: {:error, :invalid_file}
+
+  defp decode_record(
+         <<timestamp::little-signed-64, value::little-64, seqno::little-32, offset::little-32,
+           edge, _::binary>>,
+         realtime_offset
+       ) do
+    %{
+      timestamp: timestamp,
+      system_time: timestamp + realtime_offset,
+      value: value,
+      seqno: seqno,
+      offset: offset,
+      edge: if(edge == 1, do: :rising, else: :falling)
+    }
+  end
+end
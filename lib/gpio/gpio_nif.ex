@@ -18,6 +18,7 @@ defmodule Circuits.GPIO.Nif do
   def open(_gpio_spec, _resolved_gpio_spec, _direction, _initial_value, _pull_mode, _drive_mode),
     do: :erlang.nif_error(:nif_not_loaded)
 
+  def open_sub(_gpio, _lines), do: :erlang.nif_error(:nif_not_loaded)
   def close(_gpio), do: :erlang.nif_error(:nif_not_loaded)
   def force_close(_gpio), do: :erlang.nif_error(:nif_not_loaded)
   def read(_gpio), do: :erlang.nif_error(:nif_not_loaded)
@@ -26,8 +27,20 @@ defmodule Circuits.GPIO.Nif do
   def set_interrupts(_gpio, _trigger, _suppress_glitches, _process),
     do: :erlang.nif_error(:nif_not_loaded)
 
-  def subscribe(_gpio, _notify_id, _trigger, _process), do: :erlang.nif_error(:nif_not_loaded)
+  def subscribe(_gpio, _notify_id, _trigger, _routes, _options), do: :erlang.nif_error(:nif_not_loaded)
+  def subscribe_merged(_gpios, _notify_id, _trigger, _pid, _options),
+    do: :erlang.nif_error(:nif_not_loaded)
+
+  def capture_start(_gpios, _notify_id, _pid, _options), do: :erlang.nif_error(:nif_not_loaded)
+  def capture_stop(_capture), do: :erlang.nif_error(:nif_not_loaded)
+
+  def recorder_start(_gpio, _notify_id, _path, _capacity), do: :erlang.nif_error(:nif_not_loaded)
+
   def unsubscribe(_gpio), do: :erlang.nif_error(:nif_not_loaded)
+  def unsubscribe(_gpio, _notify_id), do: :erlang.nif_error(:nif_not_loaded)
+  def transfer(_gpio, _pid), do: :erlang.nif_error(:nif_not_loaded)
+  def read_subscription(_gpio, _notify_id, _clear), do: :erlang.nif_error(:nif_not_loaded)
+  def read_latched(_gpio, _clear), do: :erlang.nif_error(:nif_not_loaded)
 
   def set_direction(_gpio, _direction), do: :erlang.nif_error(:nif_not_loaded)
   def set_pull_mode(_gpio, _pull_mode), do: :erlang.nif_error(:nif_not_loaded)
@@ -36,4 +49,38 @@ defmodule Circuits.GPIO.Nif do
   def status(_resolved_gpio_spec), do: :erlang.nif_error(:nif_not_loaded)
   def backend_info(), do: :erlang.nif_error(:nif_not_loaded)
   def enumerate(), do: :erlang.nif_error(:nif_not_loaded)
+
+  def task_stop(_task), do: :erlang.nif_error(:nif_not_loaded)
+
+  def keypad_start(_rows, _cols, _notify_id, _pid, _options),
+    do: :erlang.nif_error(:nif_not_loaded)
+
+  def keypad_pressed(_task), do: :erlang.nif_error(:nif_not_loaded)
+
+  def pwm_start(_gpio, _notify_id, _pid, _channels), do: :erlang.nif_error(:nif_not_loaded)
+  def pwm_set(_task, _channel, _settings), do: :erlang.nif_error(:nif_not_loaded)
+  def pwm_get(_task, _channel), do: :erlang.nif_error(:nif_not_loaded)
+
+  def stepper_start(_gpio, _notify_id, _pid, _options), do: :erlang.nif_error(:nif_not_loaded)
+
+  def stepper_move(_task, _steps, _absolute, _max_speed, _acceleration),
+    do: :erlang.nif_error(:nif_not_loaded)
+
+  def stepper_halt(_task), do: :erlang.nif_error(:nif_not_loaded)
+  def stepper_status(_task), do: :erlang.nif_error(:nif_not_loaded)
+
+  def sequencer_start(_gpios, _notify_id, _pid, _program),
+    do: :erlang.nif_error(:nif_not_loaded)
+
+  def shift_transfer(_out, _in, _data, _options), do: :erlang.nif_error(:nif_not_loaded)
+
+  def onewire_transfer(_gpio, _data, _read_count, _check_crc),
+    do: :erlang.nif_error(:nif_not_loaded)
+
+  def onewire_search(_gpio, _alarm), do: :erlang.nif_error(:nif_not_loaded)
+
+  def heartbeat_start(_gpio, _notify_id, _pid, _options), do: :erlang.nif_error(:nif_not_loaded)
+  def heartbeat_feed(_task), do: :erlang.nif_error(:nif_not_loaded)
+
+  def c_api(), do: :erlang.nif_error(:nif_not_loaded)
 end
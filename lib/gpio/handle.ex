@@ -41,6 +41,11 @@ defprotocol Circuits.GPIO.Handle do
   @spec set_drive_mode(t(), GPIO.drive_mode()) :: :ok | {:error, atom()}
   def set_drive_mode(handle, mode)
 
+  # Return a handle to some of this handle's lines that shares its line request
+  @doc false
+  @spec open_sub(t(), [non_neg_integer()]) :: {:ok, t()} | {:error, atom()}
+  def open_sub(handle, lines)
+
   # Free up resources associated with the handle
   #
   # Well behaved backends free up their resources with the help of the Erlang
@@ -60,8 +65,35 @@ defprotocol Circuits.GPIO.Handle do
   @spec subscribe(t(), GPIO.subscribe_options()) :: {:ok, term()} | {:error, atom()}
   def subscribe(handle, options)
 
-  # Stop change notifications started with subscribe/2
+  # Subscribe to change notifications from this handle and `handles` (which
+  # includes this one) as one time-ordered stream
+  @doc false
+  @spec subscribe_merged(t(), [t()], GPIO.subscribe_merged_options()) ::
+          {:ok, term()} | {:error, atom()}
+  def subscribe_merged(handle, handles, options)
+
+  # Stop all change notifications started with subscribe/2
   @doc false
   @spec unsubscribe(t()) :: :ok | {:error, atom()}
   def unsubscribe(handle)
+
+  # Stop the change notifications for one ref/tag returned by subscribe/2
+  @doc false
+  @spec unsubscribe(t(), term()) :: :ok | {:error, atom()}
+  def unsubscribe(handle, ref)
+
+  # Send the handle's notifications to another process from now on
+  @doc false
+  @spec transfer(t(), pid()) :: :ok | {:error, atom()}
+  def transfer(handle, pid)
+
+  # Return the state kept by a subscription with a `:mode`, optionally resetting it
+  @doc false
+  @spec read_subscription(t(), term(), boolean()) :: {:ok, map()} | {:error, atom()}
+  def read_subscription(handle, ref, clear)
+
+  # Return the edges seen by the handle's `mode: :latch` subscription, optionally resetting them
+  @doc false
+  @spec read_latched(t(), boolean()) :: {:ok, map()} | {:error, atom()}
+  def read_latched(handle, clear)
 end
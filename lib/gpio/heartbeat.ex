@@ -0,0 +1,99 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+
+defmodule Circuits.GPIO.Heartbeat do
+  @moduledoc """
+  Toggle GPIOs for heartbeat LEDs and hardware watchdogs
+
+  Toggling from an Elixir process jitters when the BEAM is busy with garbage
+  collection or scheduling, and that can look like a hang to an external
+  watchdog. This toggles every GPIO in an output handle from a native thread
+  instead.
+
+  ```elixir
+  iex> {:ok, wdi} = Circuits.GPIO.open("WDT_IN", :output)
+  iex> {:ok, heartbeat} = Circuits.GPIO.Heartbeat.start(wdi, period_ms: 200, feed_ms: 5000)
+
+  # From a process that only runs when the system is healthy
+  iex> Circuits.GPIO.Heartbeat.feed(heartbeat)
+  :ok
+  ```
+
+  Since the thread keeps toggling even if the BEAM hangs, set `:feed_ms` to
+  have it stop when `feed/1` hasn't been called for that long. The watchdog
+  then sees the signal stop and resets the board. The deadline is checked at
+  each toggle. Feeding after that starts toggling again. These messages are
+  sent when toggling stops and starts again:
+
+  ```elixir
+  {:circuits_gpio, %{ref: ref, event: :starved, timestamp: timestamp}}
+  {:circuits_gpio, %{ref: ref, event: :resumed, timestamp: timestamp}}
+  ```
+
+  The GPIOs are left where they are when toggling stops. If they can't be
+  written, an `{:circuits_gpio, %{ref: ref, event: :error, reason: reason}}`
+  message is sent and the thread exits.
+
+  Heartbeats need the `Circuits.GPIO.CDev` backend. Toggling stops for good
+  when the struct from `start/2` is garbage collected, which looks the same as
+  a hang to a watchdog. Keep it in a process that lives as long as the
+  system.
+  """
+
+  alias Circuits.GPIO.Nif
+  alias Circuits.GPIO.Receiver
+
+  defstruct [:ref, :task]
+
+  @type t() :: %__MODULE__{ref: reference() | term(), task: reference()}
+
+  @typedoc """
+  Heartbeat options
+
+  * `:period_ms` - time for a full cycle. The GPIOs toggle twice per period.
+    Defaults to `1000`.
+  * `:feed_ms` - stop toggling if `feed/1` isn't called for this long. `0`
+    never stops. Defaults to `0`.
+  * `:receiver` - process to send messages to. This can be a pid or a
+    registered name. Defaults to the calling process.
+  * `:tag` - value to use for `:ref` in messages. Defaults to a new reference.
+  """
+  @type options() :: [
+          period_ms: pos_integer(),
+          feed_ms: non_neg_integer(),
+          receiver: pid() | atom(),
+          tag: term()
+        ]
+
+  @doc """
+  Start toggling every GPIO in an output handle
+
+  The GPIOs all toggle together starting with going high.
+  """
+  @spec start(Circuits.GPIO.Handle.t(), options()) :: {:ok, t()} | {:error, atom()}
+  def start(%Circuits.GPIO.CDev{ref: gpio}, options \\ []) do
+    ref = Keyword.get(options, :tag) || make_ref()
+
+    nif_options = %{
+      period_ns: Keyword.get(options, :period_ms, 1000) * 1_000_000,
+      feed_ns: Keyword.get(options, :feed_ms, 0) * 1_000_000
+    }
+
+    with {:ok, task} <- Nif.heartbeat_start(gpio, ref, Receiver.resolve(options), nif_options) do
+      {:ok, %__MODULE__{ref: ref, task: task}}
+    end
+  end
+
+  @doc """
+  Reset the feed deadline
+  """
+  @spec feed(t()) :: :ok
+  def feed(%__MODULE__{task: task}), do: Nif.heartbeat_feed(task)
+
+  @doc """
+  Stop toggling
+  """
+  @spec stop(t()) :: :ok
+  def stop(%__MODULE__{task: task}), do: Nif.task_stop(task)
+end
@@ -0,0 +1,120 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+
+defmodule Circuits.GPIO.Keypad do
+  @moduledoc """
+  Matrix keypad scanner
+
+  Matrix keypads wire each key between a row and a column. The scanner drives
+  one row at a time and reads the columns to see which keys on that row are
+  pressed. This runs in a native thread so that scans are regular and key
+  presses are debounced without involving Erlang processes.
+
+  Rows are a GPIO handle opened as an output and columns are a handle opened
+  as an input. Use pull-ups on the columns for the default active-low wiring.
+  Pressing two keys in the same column connects their rows, so rows need to
+  be opened with `drive_mode: :open_drain` to only pull the scanned row low.
+  Active-high keypads need `drive_mode: :open_source` and pull-downs on the
+  columns instead.
+
+  ```elixir
+  iex> {:ok, rows} = Circuits.GPIO.open(["ROW0", "ROW1", "ROW2", "ROW3"], :output, initial_value: 0b1111, drive_mode: :open_drain)
+  iex> {:ok, cols} = Circuits.GPIO.open(["COL0", "COL1", "COL2"], :input, pull_mode: :pullup)
+  iex> {:ok, keypad} = Circuits.GPIO.Keypad.start(rows, cols, keys: ~c"123456789*0#")
+  iex> flush()
+  {:circuits_gpio, %{ref: #Reference<...>, event: :key_down, key: ?5, row: 1, column: 1, timestamp: 12345}}
+  ```
+
+  Keys are reported in messages that look like:
+
+  ```elixir
+  {:circuits_gpio, %{ref: ref, event: :key_down | :key_up, timestamp: timestamp, key: key, row: row, column: column}}
+  ```
+
+  If the scanner fails to access the GPIOs, it sends one
+  `%{event: :error, reason: reason}` message and stops.
+
+  Keypads need the `Circuits.GPIO.CDev` backend. Keep the struct from
+  `start/3` in the process that handles the key messages. Scanning stops
+  without any more messages if it's garbage collected.
+  """
+
+  alias Circuits.GPIO.Nif
+  alias Circuits.GPIO.Receiver
+
+  defstruct [:ref, :task]
+
+  @type t() :: %__MODULE__{ref: reference() | term(), task: reference()}
+
+  @typedoc """
+  Keypad options
+
+  * `:scan_ms` - how often to scan the keypad. Defaults to 10 ms.
+  * `:settle_us` - how long to wait after driving a row before reading the
+    columns. Defaults to 10 µs. It can be up to 10000 µs as long as the
+    rows' settle times add up to less than `:scan_ms`.
+  * `:debounce_us` - how long a key needs to be stable before it's reported.
+    Defaults to 20000 µs (20 ms).
+  * `:active_low` - `true` if rows are driven low and pressed keys read low
+    on the columns. Defaults to `true`.
+  * `:keys` - a list with one key for each row and column. The key for `row`
+    and `column` is at index `row * number_of_columns + column`. If not
+    passed, keys are reported as that index.
+  * `:receiver` - process to send messages to. This can be a pid or a
+    registered name. Defaults to the calling process.
+  * `:tag` - value to use for `:ref` in messages. Defaults to a new reference.
+  """
+  @type options() :: [
+          scan_ms: pos_integer(),
+          settle_us: non_neg_integer(),
+          debounce_us: non_neg_integer(),
+          active_low: boolean(),
+          keys: [term()],
+          receiver: pid() | atom(),
+          tag: term()
+        ]
+
+  @doc """
+  Start scanning a keypad
+
+  Rows are driven to their inactive level when not being scanned. See
+  `t:options/0` for options. Returns `{:error, :not_open_drain}` or
+  `{:error, :not_open_source}` if the rows' drive mode doesn't match
+  `:active_low`.
+  """
+  @spec start(Circuits.GPIO.Handle.t(), Circuits.GPIO.Handle.t(), options()) ::
+          {:ok, t()} | {:error, atom()}
+  def start(%Circuits.GPIO.CDev{ref: rows}, %Circuits.GPIO.CDev{ref: cols}, options \\ []) do
+    ref = Keyword.get(options, :tag) || make_ref()
+
+    nif_options =
+      options
+      |> Keyword.take([:scan_ms, :settle_us, :debounce_us, :active_low, :keys])
+      |> Map.new(fn
+        {:keys, keys} -> {:keys, List.to_tuple(keys)}
+        other -> other
+      end)
+
+    with {:ok, task} <-
+           Nif.keypad_start(rows, cols, ref, Receiver.resolve(options), nif_options) do
+      {:ok, %__MODULE__{ref: ref, task: task}}
+    end
+  end
+
+  @doc """
+  Stop scanning
+
+  No more messages are sent after this returns.
+  """
+  @spec stop(t()) :: :ok
+  def stop(%__MODULE__{task: task}), do: Nif.task_stop(task)
+
+  @doc """
+  Return the keys that are currently pressed
+
+  Keys are in the order that they were passed in the `:keys` option.
+  """
+  @spec pressed(t()) :: [term()]
+  def pressed(%__MODULE__{task: task}), do: Nif.keypad_pressed(task)
+end
@@ -0,0 +1,229 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+
+defmodule Circuits.GPIO.LogicAnalyzer do
+  @moduledoc """
+  Record edges on a set of handles like a logic analyzer
+
+  A capture records every edge on its handles in the NIF with the same
+  timestamps as change notifications. No message is sent per edge, so it can
+  keep up with thousands of edges per second. The edges come back as one
+  binary when the capture is stopped and can be saved as a VCD file for
+  waveform viewers like GTKWave or PulseView.
+
+  ```elixir
+  iex> {:ok, bus} = Circuits.GPIO.open([{"gpiochip0", 17}, {"gpiochip0", 27}], :input)
+  iex> {:ok, cs} = Circuits.GPIO.open({"gpiochip0", 22}, :input)
+  iex> {:ok, capture} = Circuits.GPIO.LogicAnalyzer.capture_start([bus, cs], trigger: {cs, 1, 0}, pre_trigger: 100)
+  iex> {:ok, result} = Circuits.GPIO.LogicAnalyzer.capture_stop(capture)
+  iex> Circuits.GPIO.LogicAnalyzer.write_vcd(result, "capture.vcd", names: ["bus", "cs"])
+  :ok
+  ```
+
+  Memory for `:max_edges` edges is allocated when the capture starts. Once
+  it's full, later edges are only counted. Without a `:trigger`, recording
+  starts right away. With one, only the last `:pre_trigger` edges are kept
+  until the trigger and then recording continues until the buffer is full.
+  These messages are sent along the way:
+
+  ```elixir
+  {:circuits_gpio, %{ref: ref, event: :triggered, timestamp: timestamp}}
+  {:circuits_gpio, %{ref: ref, event: :capture_full, timestamp: timestamp}}
+  ```
+
+  A capture uses a subscription on each handle, so it counts towards their
+  subscriber limits. Only the `Circuits.GPIO.CDev` backend supports captures.
+  """
+
+  import Bitwise
+
+  alias Circuits.GPIO.Handle
+  alias Circuits.GPIO.Nif
+  alias Circuits.GPIO.Receiver
+
+  defstruct [:ref, :handles, :capture]
+
+  @typedoc "A running capture"
+  @type t() :: %__MODULE__{ref: term(), handles: [Handle.t()], capture: reference()}
+
+  @typedoc """
+  A stopped capture
+
+  * `:widths` - the number of lines in each handle
+  * `:initial` - each handle's value before the first edge
+  * `:start_timestamp` - when the initial values were seen
+  * `:trigger_timestamp` - when the trigger happened or `nil` if it didn't
+  * `:edges` - binary with a record for each edge in the order they were
+    recorded. See `edges/1`.
+  * `:dropped` - edges that didn't fit
+  """
+  @type result() :: %{
+          widths: [pos_integer()],
+          initial: [non_neg_integer()],
+          start_timestamp: integer(),
+          trigger_timestamp: integer() | nil,
+          edges: binary(),
+          dropped: non_neg_integer()
+        }
+
+  @typedoc """
+  Options for `capture_start/2`
+
+  * `:max_edges` - how many edges to record (1 to 4,194,304). Defaults to
+    `65_536`.
+  * `:pre_trigger` - how many edges to keep from before the trigger. Defaults
+    to `0`.
+  * `:trigger` - `{handle, mask, pattern}` to start recording when
+    `value &&& mask` becomes `pattern` on one of the handles
+  * `:receiver` - process to send messages to. This can be a pid or a
+    registered name. Defaults to the calling process.
+  * `:tag` - value to use for `:ref` in messages. Defaults to a new reference.
+  """
+  @type options() :: [
+          max_edges: pos_integer(),
+          pre_trigger: non_neg_integer(),
+          trigger: {Handle.t(), non_neg_integer(), non_neg_integer()},
+          receiver: pid() | atom(),
+          tag: term()
+        ]
+
+  @doc """
+  Start recording the edges on one or more handles
+  """
+  @spec capture_start(Handle.t() | [Handle.t()], options()) :: {:ok, t()} | {:error, atom()}
+  def capture_start(handles, options \\ []) do
+    handles = List.wrap(handles)
+    ref = Keyword.get(options, :tag) || make_ref()
+    gpios = Enum.map(handles, fn %Circuits.GPIO.CDev{ref: gpio} -> gpio end)
+
+    nif_options =
+      options
+      |> Keyword.take([:max_edges, :pre_trigger, :trigger])
+      |> Map.new()
+      |> resolve_trigger(handles)
+
+    with {:ok, capture} <- Nif.capture_start(gpios, ref, Receiver.resolve(options), nif_options) do
+      {:ok, %__MODULE__{ref: ref, handles: handles, capture: capture}}
+    end
+  end
+
+  @doc """
+  Stop recording and return what was recorded
+  """
+  @spec capture_stop(t()) :: {:ok, result()}
+  def capture_stop(%__MODULE__{ref: ref, handles: handles, capture: capture}) do
+    result = Nif.capture_stop(capture)
+    Enum.each(handles, &Handle.unsubscribe(&1, ref))
+    result
+  end
+
+  @doc """
+  Decode the edges in a result
+
+  Returns `{timestamp, source, value}` tuples where `source` is the handle's
+  index in the list passed to `capture_start/2` and `value` is the handle's
+  value after the edge. The binary has 17 bytes per edge:
+
+  ```elixir
+  <<timestamp::little-signed-64, value::little-64, source::8>>
+  ```
+  """
+  @spec edges(result()) :: [{integer(), non_neg_integer(), non_neg_integer()}]
+  def edges(%{edges: edges}) do
+    for <<timestamp::little-signed-64, value::little-64, source::8 <- edges>>,
+      do: {timestamp, source, value}
+  end
+
+  @doc """
+  Write a result to a VCD file
+
+  See `to_vcd/2` for options.
+  """
+  @spec write_vcd(result(), Path.t(), keyword()) :: :ok | {:error, File.posix()}
+  def write_vcd(result, path, options \\ []) do
+    File.write(path, to_vcd(result, options))
+  end
+
+  @doc """
+  Convert a result to VCD (Value Change Dump)
+
+  Times are in nanoseconds from the start of the capture. Each handle is a
+  signal with one bit per line.
+
+  Options:
+
+  * `:names` - signal names with one for each handle. Defaults to `"gpio0"`,
+    `"gpio1"`, and so on.
+  * `:module` - the scope that the signals are in. Defaults to `"gpio"`.
+  """
+  @spec to_vcd(result(), keyword()) :: iodata()
+  def to_vcd(%{widths: widths, initial: initial, start_timestamp: start} = result, options \\ []) do
+    count = length(widths)
+    names = Keyword.get_lazy(options, :names, fn -> for i <- 0..(count - 1), do: "gpio#{i}" end)
+    module = Keyword.get(options, :module, "gpio")
+
+    if length(names) != count, do: raise(ArgumentError, "expected #{count} names")
+
+    # Edges from different handles can be recorded slightly out of order
+    edges = result |> edges() |> Enum.sort_by(&elem(&1, 0))
+    start = edges |> Enum.map(&elem(&1, 0)) |> Enum.min(fn -> start end) |> min(start)
+
+    vars =
+      for {{name, width}, i} <- Enum.with_index(Enum.zip(names, widths)) do
+        ["$var wire ", Integer.to_string(width), " ", vcd_id(i), " ", vcd_name(name, width), " $end\n"]
+      end
+
+    dumpvars =
+      for {{value, width}, i} <- Enum.with_index(Enum.zip(initial, widths)),
+        do: vcd_value(value, width, i)
+
+    changes =
+      edges
+      |> Enum.chunk_by(&elem(&1, 0))
+      |> Enum.map(fn [{timestamp, _, _} | _] = same_time ->
+        [
+          "#",
+          Integer.to_string(timestamp - start),
+          "\n"
+          | for({_, source, value} <- same_time, do: vcd_value(value, Enum.at(widths, source), source))
+        ]
+      end)
+
+    [
+      "$timescale 1ns $end\n",
+      "$scope module ",
+      module,
+      " $end\n",
+      vars,
+      "$upscope $end\n",
+      "$enddefinitions $end\n",
+      "#0\n$dumpvars\n",
+      dumpvars,
+      "$end\n",
+      changes
+    ]
+  end
+
+  # Identifiers are printable ASCII characters and there are at most 32 handles
+  defp vcd_id(i), do: <<?! + i>>
+
+  defp vcd_name(name, 1), do: to_string(name)
+  defp vcd_name(name, width), do: "#{name} [#{width - 1}:0]"
+
+  defp vcd_value(value, 1, i), do: [Integer.to_string(value &&& 1), vcd_id(i), "\n"]
+
+  defp vcd_value(value, width, i) do
+    bits = value |> Integer.to_string(2) |> String.pad_leading(width, "0")
+    ["b", bits, " ", vcd_id(i), "\n"]
+  end
+
+  defp resolve_trigger(%{trigger: {handle, mask, pattern}} = options, handles) do
+    case Enum.find_index(handles, &(&1 == handle)) do
+      nil -> raise ArgumentError, ":trigger handle should be one of the captured handles"
+      index -> %{options | trigger: {index, mask, pattern}}
+    end
+  end
+
+  defp resolve_trigger(options, _handles), do: options
+end
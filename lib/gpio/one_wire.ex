@@ -0,0 +1,100 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+
+defmodule Circuits.GPIO.OneWire do
+  @moduledoc """
+  Bit-banged 1-Wire bus master
+
+  This talks to 1-Wire devices like DS18B20 temperature sensors on any GPIO
+  without the Linux `w1-gpio` driver. Each transaction runs in one native call
+  that does the bus reset, the writes, and the reads with µs timing.
+
+  Open the bus GPIO as an open-drain output with an external pull-up
+  resistor (4.7 kΩ is typical):
+
+  ```elixir
+  iex> {:ok, bus} = Circuits.GPIO.open("GPIO4", :output, initial_value: 1, drive_mode: :open_drain)
+  iex> {:ok, [rom]} = Circuits.GPIO.OneWire.search(bus)
+  {:ok, [<<0x28, 0xFF, 0x64, 0x1E, 0x0F, 0x07, 0x00, 0x8B>>]}
+
+  # Start a temperature conversion, wait for it, and read the scratchpad
+  iex> Circuits.GPIO.OneWire.transfer(bus, rom, <<0x44>>)
+  {:ok, ""}
+  iex> Process.sleep(750)
+  iex> Circuits.GPIO.OneWire.transfer(bus, rom, <<0xBE>>, 9, check_crc: true)
+  {:ok, <<0x91, 0x01, 0x4B, 0x46, 0x7F, 0xFF, 0x0F, 0x10, 0x25>>}
+  ```
+
+  Transactions return `{:error, :no_presence}` when no device answers the
+  reset and `{:error, :bus_low}` if the bus doesn't go high when released.
+  That's usually a missing pull-up.
+
+  Bit timing is done in software, so a slot can be corrupted if the OS
+  preempts the call. Use `check_crc: true` on reads that end with a CRC and
+  retry on `{:error, :crc}`. Searches retry on their own.
+
+  Parasite power isn't supported, so devices need their own power supply.
+  Only the `Circuits.GPIO.CDev` backend supports 1-Wire.
+  """
+
+  alias Circuits.GPIO.Handle
+  alias Circuits.GPIO.Nif
+
+  @typedoc """
+  A device's 8-byte ROM code
+
+  The first byte is the family code and the last byte is a CRC.
+  """
+  @type rom() :: <<_::64>>
+
+  @doc """
+  Reset the bus and report whether any devices answered
+  """
+  @spec reset(Handle.t()) :: :ok | {:error, atom()}
+  def reset(%Circuits.GPIO.CDev{ref: gpio}) do
+    with {:ok, _} <- Nif.onewire_transfer(gpio, <<>>, 0, false), do: :ok
+  end
+
+  @doc """
+  Find the ROM codes of the devices on the bus
+
+  Options:
+
+  * `:alarm` - set to `true` to only find devices with an alarm condition.
+    Defaults to `false`.
+  """
+  @spec search(Handle.t(), alarm: boolean()) :: {:ok, [rom()]} | {:error, atom()}
+  def search(%Circuits.GPIO.CDev{ref: gpio}, options \\ []) do
+    Nif.onewire_search(gpio, Keyword.get(options, :alarm, false))
+  end
+
+  @doc """
+  Run a transaction
+
+  This resets the bus, selects a device, writes `data`, and then reads
+  `read_count` bytes. Devices are selected with:
+
+  * a ROM code - send Match ROM to select one device
+  * `:skip` - send Skip ROM to select all devices. This only works for reads
+    when there's one device on the bus.
+  * `:none` - don't send a ROM command. Use this to send a ROM command in
+    `data` like Read ROM.
+
+  Options:
+
+  * `:check_crc` - check that the bytes read end with their CRC. Returns
+    `{:error, :crc}` if not. Defaults to `false`.
+  """
+  @spec transfer(Handle.t(), rom() | :skip | :none, iodata(), non_neg_integer(),
+          check_crc: boolean()
+        ) :: {:ok, binary()} | {:error, atom()}
+  def transfer(%Circuits.GPIO.CDev{ref: gpio}, rom, data, read_count \\ 0, options \\ []) do
+    data = [rom_command(rom), data] |> IO.iodata_to_binary()
+    Nif.onewire_transfer(gpio, data, read_count, Keyword.get(options, :check_crc, false))
+  end
+
+  defp rom_command(<<_::64>> = rom), do: [0x55, rom]
+  defp rom_command(:skip), do: 0xCC
+  defp rom_command(:none), do: []
+end
@@ -0,0 +1,23 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+
+defmodule Circuits.GPIO.Receiver do
+  @moduledoc false
+
+  # Turn a `:receiver` option into the pid that the NIF sends messages to.
+  # Registered names are looked up now, so messages keep going to the same
+  # process if the name is re-registered. Unknown names and no `:receiver`
+  # mean the caller.
+
+  @spec resolve(keyword()) :: pid()
+  def resolve(options), do: resolve_pid(Keyword.get(options, :receiver))
+
+  @spec resolve_pid(pid() | atom()) :: pid()
+  def resolve_pid(pid) when is_pid(pid), do: pid
+
+  def resolve_pid(name) when is_atom(name) and not is_nil(name),
+    do: Process.whereis(name) || self()
+
+  def resolve_pid(_), do: self()
+end
@@ -0,0 +1,171 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+
+defmodule Circuits.GPIO.Sequencer do
+  @moduledoc """
+  Run short GPIO programs with consistent timing
+
+  Bit-banged protocols need writes, reads, and waits to happen in order and on
+  time. Doing each step with a separate `Circuits.GPIO` call leaves gaps of
+  unknown length between them. The sequencer runs a whole list of steps on a
+  native thread and returns everything that it read as one binary.
+
+  For example, this clocks 8 bits out of a shift register and reads the data
+  line after each rising edge:
+
+  ```elixir
+  iex> {:ok, out} = Circuits.GPIO.open(["LOAD", "CLK"], :output, initial_value: 0b01)
+  iex> {:ok, data} = Circuits.GPIO.open("DATA", :input)
+  iex> program = [
+  ...>   {:write, 0b01, 0b00},
+  ...>   {:wait_us, 1},
+  ...>   {:write, 0b01, 0b01},
+  ...>   {:loop, 8, [{:write, 0b10, 0b10}, {:read, 1}, {:wait_us, 1}, {:write, 0b10, 0}, {:wait_us, 1}]}
+  ...> ]
+  iex> Circuits.GPIO.Sequencer.run([out, data], program)
+  {:ok, <<1, 0, 1, 1, 0, 0, 1, 0>>}
+  ```
+
+  Only the `Circuits.GPIO.CDev` backend supports the sequencer.
+  """
+
+  alias Circuits.GPIO.Nif
+  alias Circuits.GPIO.Receiver
+
+  defstruct [:ref, :task]
+
+  @type t() :: %__MODULE__{ref: reference() | term(), task: reference()}
+
+  @typedoc """
+  Sequencer operations
+
+  Handles are referred to by their index in the list passed to `run/3`.
+
+  * `{:write, mask, value}` - write the GPIOs in `mask` to their bits in
+    `value`. GPIOs not in `mask` aren't changed.
+  * `:read` - read the handle and append the value to the result.
+    Values take one byte for each 8 GPIOs in the handle, least significant
+    byte first.
+  * `{:wait_ns, ns}` and `{:wait_us, us}` - wait. Waits are measured from the
+    end of the previous wait so that time spent on writes and reads doesn't
+    add up. Waits of up to about 4 seconds are supported.
+  * `{:wait_level, mask, value, timeout_us}` - wait for the GPIOs in `mask`
+    to read `value`. Timeouts can be up to about 4 seconds. If this times out, the program stops with
+    `{:error, :timeout}`. The next wait is measured from when the level was
+    seen.
+  * `{:loop, count, operations}` - run operations `count` times. Loops can
+    be nested 8 deep.
+
+  Operations that take a handle index as their first element, like
+  `{:write, 1, mask, value}` and `{:read, 1}`, use that handle instead.
+  """
+  @type operation() ::
+          {:write, non_neg_integer(), non_neg_integer()}
+          | {:write, non_neg_integer(), non_neg_integer(), non_neg_integer()}
+          | :read
+          | {:read, non_neg_integer()}
+          | {:wait_ns, non_neg_integer()}
+          | {:wait_us, non_neg_integer()}
+          | {:wait_level, non_neg_integer(), non_neg_integer(), non_neg_integer()}
+          | {:wait_level, non_neg_integer(), non_neg_integer(), non_neg_integer(),
+             non_neg_integer()}
+          | {:loop, non_neg_integer(), [operation()]}
+
+  @typedoc """
+  Options
+
+  * `:timeout` - how long `run/3` waits for the program to finish in
+    milliseconds. Defaults to 5000.
+  * `:receiver` - process to send the result to for `start/3`. This can be a
+    pid or a registered name. Defaults to the calling process.
+  * `:tag` - value to use for `:ref` in messages from `start/3`. Defaults to
+    a new reference.
+  """
+  @type options() :: [timeout: timeout(), receiver: pid() | atom(), tag: term()]
+
+  @doc """
+  Run a program and wait for the result
+
+  If the program stops early, the error includes what was read up to then.
+  """
+  @spec run(Circuits.GPIO.Handle.t() | [Circuits.GPIO.Handle.t()], [operation()], options()) ::
+          {:ok, binary()} | {:error, atom()} | {:error, atom(), binary()}
+  def run(handles, program, options \\ []) do
+    ref = make_ref()
+    timeout = Keyword.get(options, :timeout, 5000)
+
+    with {:ok, sequencer} <- start(handles, program, tag: ref, receiver: self()) do
+      receive do
+        {:circuits_gpio, %{ref: ^ref, event: :sequence_done, data: data}} ->
+          {:ok, data}
+
+        {:circuits_gpio, %{ref: ^ref, event: :error, reason: reason, data: data}} ->
+          {:error, reason, data}
+      after
+        timeout ->
+          stop(sequencer)
+          {:error, :timeout}
+      end
+    end
+  end
+
+  @doc """
+  Run a program in the background
+
+  When the program finishes, a message like the following is sent:
+
+  ```elixir
+  {:circuits_gpio, %{ref: ref, event: :sequence_done, timestamp: timestamp, data: data}}
+  ```
+
+  If it stops early, the message has `event: :error`, a `:reason`, and the
+  data read up to then. Keep the returned struct around until the program
+  finishes since the program is stopped if it's garbage collected.
+  """
+  @spec start(Circuits.GPIO.Handle.t() | [Circuits.GPIO.Handle.t()], [operation()], options()) ::
+          {:ok, t()} | {:error, atom()}
+  def start(handles, program, options \\ []) do
+    ref = Keyword.get(options, :tag) || make_ref()
+    gpios = handles |> List.wrap() |> Enum.map(fn %Circuits.GPIO.CDev{ref: gpio} -> gpio end)
+
+    with {:ok, task} <-
+           Nif.sequencer_start(gpios, ref, Receiver.resolve(options), compile(program)) do
+      {:ok, %__MODULE__{ref: ref, task: task}}
+    end
+  end
+
+  @doc """
+  Stop a program started with `start/3`
+
+  No message is sent for a program that's stopped.
+  """
+  @spec stop(t()) :: :ok
+  def stop(%__MODULE__{task: task}), do: Nif.task_stop(task)
+
+  @doc """
+  Compile a program to the sequencer's binary format
+
+  Programs are compiled automatically. This is useful for compiling programs
+  ahead of time since `run/3` and `start/3` take binaries too.
+  """
+  @spec compile([operation()] | binary()) :: binary()
+  def compile(program) when is_binary(program), do: program
+  def compile(program) when is_list(program), do: for(op <- program, into: <<>>, do: encode(op))
+
+  defp encode({:write, mask, value}), do: encode({:write, 0, mask, value})
+  defp encode({:write, h, mask, value}), do: <<1, h, mask::little-64, value::little-64>>
+  defp encode(:read), do: encode({:read, 0})
+  defp encode({:read, h}), do: <<2, h>>
+  defp encode({:wait_ns, ns}) when ns in 0..0xFFFFFFFF, do: <<3, ns::little-32>>
+  defp encode({:wait_us, us}), do: encode({:wait_ns, us * 1000})
+
+  defp encode({:wait_level, mask, value, timeout_us}),
+    do: encode({:wait_level, 0, mask, value, timeout_us})
+
+  defp encode({:wait_level, h, mask, value, timeout_us}) when timeout_us in 0..4_294_967,
+    do: <<4, h, mask::little-64, value::little-64, timeout_us * 1000::little-32>>
+
+  defp encode({:loop, count, ops}) when count in 0..0xFFFFFFFF, do: <<5, count::little-32, compile(ops)::binary, 6>>
+  defp encode(op), do: raise(ArgumentError, "invalid sequencer operation #{inspect(op)}")
+end
@@ -0,0 +1,114 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+
+defmodule Circuits.GPIO.Shift do
+  @moduledoc """
+  Bit-banged shift registers and SPI
+
+  These functions clock bytes in and out of GPIOs in one native call. That's
+  much faster than toggling clock and data GPIOs with `Circuits.GPIO.write/2`
+  and useful for chains of 74HC595 output and 74HC165 input shift registers
+  and for simple SPI devices.
+
+  The clock, data out, and latch or chip select GPIOs are opened as one
+  output handle. Data in is opened as a separate input handle.
+
+  ```elixir
+  # 74HC595: SER, SRCLK, RCLK
+  iex> {:ok, out} = Circuits.GPIO.open(["SER", "SRCLK", "RCLK"], :output)
+  iex> Circuits.GPIO.Shift.shift_out(out, <<0xA5, 0x0F>>)
+  :ok
+
+  # 74HC165: CLK, SH/LD and QH
+  iex> {:ok, out} = Circuits.GPIO.open(["CLK", "SH_LD"], :output, initial_value: 0b10)
+  iex> {:ok, qh} = Circuits.GPIO.open("QH", :input)
+  iex> Circuits.GPIO.Shift.shift_in(out, qh, 2)
+  <<0x12, 0x34>>
+  ```
+
+  Only the `Circuits.GPIO.CDev` backend supports shifting.
+  """
+
+  alias Circuits.GPIO.Handle
+  alias Circuits.GPIO.Nif
+
+  @typedoc """
+  Shift options
+
+  * `:mode` - SPI clock mode from 0 to 3. Mode 0 idles the clock low and
+    samples on the rising edge. This is what 74HC595s and 74HC165s use.
+    Defaults to 0.
+  * `:bit_order` - `:msb_first` or `:lsb_first`. Defaults to `:msb_first`.
+  * `:delay_ns` - extra time to hold each half of the clock cycle. Defaults
+    to 0 for as fast as possible.
+  """
+  @type options() :: [
+          mode: 0..3,
+          bit_order: :msb_first | :lsb_first,
+          delay_ns: non_neg_integer()
+        ]
+
+  @doc """
+  Shift bytes out
+
+  The output handle is `[data, clock]` or `[data, clock, latch]`. If there's
+  a latch GPIO, it's pulsed high after all bytes are shifted out.
+  """
+  @spec shift_out(Handle.t(), iodata(), options()) :: :ok
+  def shift_out(%Circuits.GPIO.CDev{ref: out, locations: locations}, data, options \\ []) do
+    lines = %{data_out: 0, clock: 1} |> put_select(locations, 2, :latch)
+    Nif.shift_transfer(out, nil, IO.iodata_to_binary(data), nif_options(lines, options))
+  end
+
+  @doc """
+  Shift bytes in
+
+  The output handle is `[clock]` or `[clock, load]` and the input handle is
+  the data GPIO. If there's a load GPIO, it's pulsed low before shifting in
+  to capture the shift register's inputs. It should idle high.
+  """
+  @spec shift_in(Handle.t(), Handle.t(), non_neg_integer(), options()) :: binary()
+  def shift_in(
+        %Circuits.GPIO.CDev{ref: out, locations: locations},
+        %Circuits.GPIO.CDev{ref: in},
+        count,
+        options \\ []
+      ) do
+    lines = %{clock: 0} |> put_select(locations, 1, :load)
+    Nif.shift_transfer(out, in, :binary.copy(<<0>>, count), nif_options(lines, options))
+  end
+
+  @doc """
+  Shift bytes out and in at the same time like SPI
+
+  The output handle is `[mosi, sck]` or `[mosi, sck, cs]` and the input
+  handle is the MISO GPIO. If there's a chip select GPIO, it's driven low
+  during the transfer and should idle high.
+  """
+  @spec transfer(Handle.t(), Handle.t(), iodata(), options()) :: binary()
+  def transfer(
+        %Circuits.GPIO.CDev{ref: out, locations: locations},
+        %Circuits.GPIO.CDev{ref: in},
+        data,
+        options \\ []
+      ) do
+    lines = %{data_out: 0, clock: 1} |> put_select(locations, 2, :cs)
+    Nif.shift_transfer(out, in, IO.iodata_to_binary(data), nif_options(lines, options))
+  end
+
+  defp put_select(lines, locations, index, mode) do
+    if length(locations) > index do
+      Map.merge(lines, %{select: index, select_mode: mode})
+    else
+      lines
+    end
+  end
+
+  defp nif_options(lines, options) do
+    lines
+    |> Map.put(:mode, Keyword.get(options, :mode, 0))
+    |> Map.put(:delay_ns, Keyword.get(options, :delay_ns, 0))
+    |> Map.put(:lsb_first, Keyword.get(options, :bit_order, :msb_first) == :lsb_first)
+  end
+end
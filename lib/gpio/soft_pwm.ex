@@ -0,0 +1,128 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+
+defmodule Circuits.GPIO.SoftPWM do
+  @moduledoc """
+  Software PWM on GPIOs
+
+  This drives PWM signals on ordinary GPIOs for when there aren't enough
+  hardware PWM channels, like for dimming LEDs or controlling slow fans. Each
+  GPIO in an output handle is a channel with its own period and duty cycle.
+  One native thread runs every channel and combines edges that happen at the
+  same time into one write, so many channels cost little more than one.
+
+  ```elixir
+  iex> {:ok, leds} = Circuits.GPIO.open(["LED_R", "LED_G", "LED_B"], :output)
+  iex> {:ok, pwm} = Circuits.GPIO.SoftPWM.start(leds, period_us: 5000)
+  iex> Circuits.GPIO.SoftPWM.set(pwm, 0, 0.25)
+  :ok
+  iex> Circuits.GPIO.SoftPWM.set(pwm, 2, 0.5, period_us: 10000)
+  :ok
+  ```
+
+  Software PWM has jitter from the OS scheduler. It's fine for LEDs and most
+  fans, but use hardware PWM for servos and anything else that needs precise
+  pulses.
+
+  All channels start low. Duty cycle and period changes take effect at the
+  start of the channel's next period. When the engine stops, all channels are
+  driven low. If it can't write to the GPIOs, it sends an
+  `{:circuits_gpio, %{ref: ref, event: :error, reason: reason}}` message and
+  stops.
+
+  Software PWM needs the `Circuits.GPIO.CDev` backend. Keep the struct from
+  `start/2` for as long as the outputs should be driven, since dropping it
+  stops the engine and drives the channels low just like `stop/1`.
+  """
+
+  alias Circuits.GPIO.Nif
+  alias Circuits.GPIO.Receiver
+
+  defstruct [:ref, :task]
+
+  @type t() :: %__MODULE__{ref: reference() | term(), task: reference()}
+
+  @typedoc """
+  Duty cycle as a number from 0 (always low) to 1 (always high)
+  """
+  @type duty() :: number()
+
+  @typedoc """
+  Software PWM options
+
+  * `:period_us` - the period of each channel in microseconds. This can be
+    from 100 µs to 10 seconds. Defaults to 10000 µs (100 Hz).
+  * `:duty` - the starting duty cycle of each channel. Defaults to 0.
+  * `:receiver` - process to send error messages to. This can be a pid or a
+    registered name. Defaults to the calling process.
+  * `:tag` - value to use for `:ref` in messages. Defaults to a new reference.
+  """
+  @type options() :: [
+          period_us: pos_integer(),
+          duty: duty(),
+          receiver: pid() | atom(),
+          tag: term()
+        ]
+
+  @doc """
+  Start software PWM on every GPIO in an output handle
+
+  Channels are numbered in the order of the GPIOs in the handle starting at 0.
+  """
+  @spec start(Circuits.GPIO.Handle.t(), options()) :: {:ok, t()} | {:error, atom()}
+  def start(%Circuits.GPIO.CDev{ref: gpio, locations: locations}, options \\ []) do
+    ref = Keyword.get(options, :tag) || make_ref()
+    period_us = Keyword.get(options, :period_us, 10000)
+    duty = Keyword.get(options, :duty, 0)
+    channels = List.duplicate(to_nif(duty, period_us), length(locations))
+
+    with {:ok, task} <- Nif.pwm_start(gpio, ref, Receiver.resolve(options), channels) do
+      {:ok, %__MODULE__{ref: ref, task: task}}
+    end
+  end
+
+  @doc """
+  Stop software PWM
+
+  All channels are driven low.
+  """
+  @spec stop(t()) :: :ok
+  def stop(%__MODULE__{task: task}), do: Nif.task_stop(task)
+
+  @doc """
+  Change a channel's duty cycle
+
+  Options:
+
+  * `:period_us` - change the channel's period too. Defaults to keeping the
+    current period.
+  """
+  @spec set(t(), non_neg_integer(), duty(), period_us: pos_integer()) :: :ok
+  def set(%__MODULE__{task: task} = pwm, channel, duty, options \\ []) do
+    period_us = Keyword.get_lazy(options, :period_us, fn -> get(pwm, channel).period_us end)
+    Nif.pwm_set(task, channel, to_nif(duty, period_us))
+  end
+
+  @doc """
+  Return a channel's duty cycle and period
+
+  This returns the most recently set values even if they haven't taken effect
+  yet.
+  """
+  @spec get(t(), non_neg_integer()) :: %{duty: float(), period_us: pos_integer()}
+  def get(%__MODULE__{task: task}, channel) do
+    {period_ns, duty} = Nif.pwm_get(task, channel)
+    %{duty: duty / 1_000_000, period_us: div(period_ns, 1000)}
+  end
+
+  defp to_nif(duty, period_us)
+       when is_number(duty) and duty >= 0 and duty <= 1 and is_integer(period_us) do
+    {period_us * 1000, round(duty * 1_000_000)}
+  end
+
+  defp to_nif(duty, period_us) do
+    raise ArgumentError,
+          "invalid duty cycle #{inspect(duty)} or period #{inspect(period_us)}"
+  end
+end
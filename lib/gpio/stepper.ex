@@ -0,0 +1,147 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+
+defmodule Circuits.GPIO.Stepper do
+  @moduledoc """
+  Step/direction stepper motor driver
+
+  This generates step pulses for stepper motor drivers with step and direction
+  inputs like the A4988, DRV8825, and TMC2208. A native thread times each step
+  so that motors run smoothly at thousands of steps per second.
+
+  Open the step and direction GPIOs as a two GPIO output handle with the step
+  GPIO first:
+
+  ```elixir
+  iex> {:ok, gpios} = Circuits.GPIO.open(["STEP", "DIR"], :output)
+  iex> {:ok, stepper} = Circuits.GPIO.Stepper.start(gpios)
+  iex> Circuits.GPIO.Stepper.move(stepper, 3200, max_speed: 4000, acceleration: 8000)
+  :ok
+  iex> flush()
+  {:circuits_gpio, %{ref: #Reference<...>, event: :move_done, position: 3200, halted: false, timestamp: 12345}}
+  ```
+
+  Moves use a trapezoidal velocity profile. The motor accelerates at
+  `:acceleration` until it reaches `:max_speed`, cruises, and then
+  decelerates to stop at the target. Short moves that don't have room to reach
+  `:max_speed` turn around halfway. Step times are computed from the start of
+  the move, so scheduling delays don't add up.
+
+  When a move finishes, a `:move_done` event is sent with the final position
+  and whether it was halted. If the GPIOs can't be written, an
+  `%{event: :error, reason: reason}` message is sent and the stepper stops.
+
+  Steppers need the `Circuits.GPIO.CDev` backend. If the struct from `start/2`
+  is garbage collected, stepping stops where it is without a `:move_done`
+  event, like with `stop/1`. Keep it in the state of the process that owns
+  the motor.
+  """
+
+  alias Circuits.GPIO.Nif
+  alias Circuits.GPIO.Receiver
+
+  defstruct [:ref, :task]
+
+  @type t() :: %__MODULE__{ref: reference() | term(), task: reference()}
+
+  @typedoc """
+  Stepper options
+
+  * `:pulse_us` - how long to hold the step GPIO high. Defaults to 5 µs.
+  * `:dir_setup_us` - how long to wait after changing direction before
+    stepping. Defaults to 5 µs.
+  * `:invert_dir` - set to `true` to drive the direction GPIO high for
+    positive moves. By default, it's low for positive moves.
+  * `:position` - the starting position. Defaults to 0.
+  * `:receiver` - process to send messages to. This can be a pid or a
+    registered name. Defaults to the calling process.
+  * `:tag` - value to use for `:ref` in messages. Defaults to a new reference.
+  """
+  @type options() :: [
+          pulse_us: pos_integer(),
+          dir_setup_us: non_neg_integer(),
+          invert_dir: boolean(),
+          position: integer(),
+          receiver: pid() | atom(),
+          tag: term()
+        ]
+
+  @typedoc """
+  Move options
+
+  * `:max_speed` - top speed in steps per second. Defaults to 1000.
+  * `:acceleration` - acceleration and deceleration in steps per second per
+    second. Defaults to 2000.
+  """
+  @type move_options() :: [max_speed: number(), acceleration: number()]
+
+  @doc """
+  Start a stepper on a `[step, dir]` output handle
+  """
+  @spec start(Circuits.GPIO.Handle.t(), options()) :: {:ok, t()} | {:error, atom()}
+  def start(%Circuits.GPIO.CDev{ref: gpio}, options \\ []) do
+    ref = Keyword.get(options, :tag) || make_ref()
+
+    nif_options =
+      options
+      |> Keyword.take([:pulse_us, :dir_setup_us, :invert_dir, :position])
+      |> Map.new()
+
+    with {:ok, task} <- Nif.stepper_start(gpio, ref, Receiver.resolve(options), nif_options) do
+      {:ok, %__MODULE__{ref: ref, task: task}}
+    end
+  end
+
+  @doc """
+  Stop the stepper thread
+
+  This stops stepping immediately. No `:move_done` event is sent for a move
+  that was in progress.
+  """
+  @spec stop(t()) :: :ok
+  def stop(%__MODULE__{task: task}), do: Nif.task_stop(task)
+
+  @doc """
+  Move a number of steps from the current position
+
+  Negative steps move backwards. This returns immediately. Only one move can
+  run at a time and `{:error, :busy}` is returned if one is in progress.
+  """
+  @spec move(t(), integer(), move_options()) :: :ok | {:error, :busy}
+  def move(%__MODULE__{task: task}, steps, options \\ []) when is_integer(steps) do
+    nif_move(task, steps, false, options)
+  end
+
+  @doc """
+  Move to an absolute position
+
+  See `move/3`.
+  """
+  @spec move_to(t(), integer(), move_options()) :: :ok | {:error, :busy}
+  def move_to(%__MODULE__{task: task}, position, options \\ []) when is_integer(position) do
+    nif_move(task, position, true, options)
+  end
+
+  @doc """
+  Halt a move
+
+  The motor stops without decelerating. A `:move_done` event is sent with
+  `halted: true`.
+  """
+  @spec halt(t()) :: :ok
+  def halt(%__MODULE__{task: task}), do: Nif.stepper_halt(task)
+
+  @doc """
+  Return the current position and whether a move is in progress
+  """
+  @spec status(t()) :: %{position: integer(), moving: boolean()}
+  def status(%__MODULE__{task: task}), do: Nif.stepper_status(task)
+
+  defp nif_move(task, steps, absolute, options) do
+    max_speed = Keyword.get(options, :max_speed, 1000)
+    acceleration = Keyword.get(options, :acceleration, 2000)
+
+    Nif.stepper_move(task, steps, absolute, max_speed / 1, acceleration / 1)
+  end
+end
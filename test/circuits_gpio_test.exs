@@ -8,6 +8,7 @@
 defmodule Circuits.GPIOTest do
   use ExUnit.Case
   require Circuits.GPIO
+  import Bitwise
   alias Circuits.GPIO
 
   defmodule ForceCloseBackend do
@@ -715,6 +716,62 @@ defmodule Circuits.GPIOTest do
       GPIO.close(gpio1)
     end
 
+    test "multiple subscribers each get notifications" do
+      {:ok, gpio0} = GPIO.open({@gpiochip, 0}, :output)
+      {:ok, gpio1} = GPIO.open({@gpiochip, 1}, :input)
+
+      parent = self()
+      receiver = spawn_link(fn -> receive do: (msg -> send(parent, {:got, msg})) end)
+
+      {:ok, ref1} = GPIO.subscribe(gpio1)
+      {:ok, ref2} = GPIO.subscribe(gpio1, receiver: receiver, trigger: :rising)
+      {:ok, ref3} = GPIO.subscribe(gpio1, trigger: :falling)
+
+      :ok = GPIO.write(gpio0, 1)
+      assert_receive {:circuits_gpio, %{ref: ^ref1, value: 1, previous_value: 0}}
+      assert_receive {:got, {:circuits_gpio, %{ref: ^ref2, value: 1, previous_value: 0}}}
+      refute_receive {:circuits_gpio, %{ref: ^ref3}}
+
+      :ok = GPIO.write(gpio0, 0)
+      assert_receive {:circuits_gpio, %{ref: ^ref1, value: 0, previous_value: 1}}
+      assert_receive {:circuits_gpio, %{ref: ^ref3, value: 0, previous_value: 1}}
+
+      GPIO.close(gpio0)
+      GPIO.close(gpio1)
+    end
+
+    test "can unsubscribe one subscriber" do
+      {:ok, gpio0} = GPIO.open({@gpiochip, 0}, :output)
+      {:ok, gpio1} = GPIO.open({@gpiochip, 1}, :input)
+
+      {:ok, ref1} = GPIO.subscribe(gpio1)
+      {:ok, ref2} = GPIO.subscribe(gpio1)
+
+      :ok = GPIO.unsubscribe(gpio1, ref1)
+
+      :ok = GPIO.write(gpio0, 1)
+      assert_receive {:circuits_gpio, %{ref: ^ref2, value: 1}}
+      refute_receive {:circuits_gpio, %{ref: ^ref1}}
+
+      GPIO.close(gpio0)
+      GPIO.close(gpio1)
+    end
+
+    test "set_interrupts replaces subscribers" do
+      {:ok, gpio0} = GPIO.open({@gpiochip, 0}, :output)
+      {:ok, gpio1} = GPIO.open({@gpiochip, 1}, :input)
+
+      {:ok, _ref} = GPIO.subscribe(gpio1)
+      :ok = GPIO.set_interrupts(gpio1, :both)
+
+      :ok = GPIO.write(gpio0, 1)
+      assert_receive {:circuits_gpio, {@gpiochip, 1}, _timestamp, 1}
+      refute_receive {:circuits_gpio, %{}}
+
+      GPIO.close(gpio0)
+      GPIO.close(gpio1)
+    end
+
     test "no messages after closing" do
       {:ok, gpio0} = GPIO.open({@gpiochip, 0}, :output)
       {:ok, gpio1} = GPIO.open({@gpiochip, 1}, :input)
@@ -973,5 +1030,1098 @@ defmodule Circuits.GPIOTest do
       GPIO.close(out)
       GPIO.close(input)
     end
+
+    test "a receiver list routes each line to its own process" do
+      {:ok, out} = GPIO.open([{@gpiochip, 0}, {@gpiochip, 2}, {@gpiochip, 4}], :output)
+      {:ok, input} = GPIO.open([{@gpiochip, 1}, {@gpiochip, 3}, {@gpiochip, 5}], :input)
+
+      parent = self()
+
+      receiver = spawn_link(fn -> receive do: (msg -> send(parent, {:got, msg})) end)
+
+      {:ok, ref} = GPIO.subscribe(input, receiver: [self(), receiver, nil])
+
+      # Line 0 comes here
+      :ok = GPIO.write(out, 0b001)
+      assert_receive {:circuits_gpio, %{ref: ^ref, value: 0b001, previous_value: 0b000}}
+      refute_receive {:got, _}
+
+      # Line 1 goes to the other process
+      :ok = GPIO.write(out, 0b011)
+      assert_receive {:got, {:circuits_gpio, %{ref: ^ref, value: 0b011, previous_value: 0b001}}}
+      refute_receive {:circuits_gpio, _}
+
+      # Line 2 isn't reported
+      :ok = GPIO.write(out, 0b111)
+      refute_receive {:circuits_gpio, _}
+      refute_receive {:got, _}
+
+      GPIO.close(out)
+      GPIO.close(input)
+    end
+
+    test "a receiver list needs one entry per line" do
+      {:ok, input} = GPIO.open([{@gpiochip, 1}, {@gpiochip, 3}], :input)
+      assert_raise ArgumentError, fn -> GPIO.subscribe(input, receiver: [self()]) end
+      GPIO.close(input)
+    end
+
+    test "settle_ns merges edges into one notification" do
+      {:ok, out} = GPIO.open([{@gpiochip, 0}, {@gpiochip, 2}], :output)
+      {:ok, input} = GPIO.open([{@gpiochip, 1}, {@gpiochip, 3}], :input)
+
+      {:ok, ref} = GPIO.subscribe(input, settle_ns: 1_000_000)
+
+      # The stub reports each line separately, so both edges have to be merged
+      :ok = GPIO.write(out, 0b11)
+
+      assert_receive {:circuits_gpio,
+                      %{ref: ^ref, value: 0b11, previous_value: 0b00, changed: 0b11}}
+
+      refute_receive {:circuits_gpio, _}
+
+      GPIO.close(out)
+      GPIO.close(input)
+    end
+
+    test "lines only reports changes on selected lines" do
+      {:ok, out} = GPIO.open([{@gpiochip, 0}, {@gpiochip, 2}], :output)
+      {:ok, input} = GPIO.open([{@gpiochip, 1}, {@gpiochip, 3}], :input)
+
+      {:ok, ref} = GPIO.subscribe(input, lines: 0b10)
+
+      :ok = GPIO.write(out, 0b01)
+      refute_receive {:circuits_gpio, _}
+
+      :ok = GPIO.write(out, 0b11)
+      assert_receive {:circuits_gpio, %{ref: ^ref, value: 0b11, previous_value: 0b01}}
+
+      GPIO.close(out)
+      GPIO.close(input)
+    end
+
+    test "match reports entering and leaving a pattern" do
+      {:ok, out} = GPIO.open([{@gpiochip, 0}, {@gpiochip, 2}, {@gpiochip, 4}], :output)
+      {:ok, input} = GPIO.open([{@gpiochip, 1}, {@gpiochip, 3}, {@gpiochip, 5}], :input)
+
+      {:ok, ref} = GPIO.subscribe(input, match: {0b011, 0b011})
+
+      :ok = GPIO.write(out, 0b001)
+      refute_receive {:circuits_gpio, _}
+
+      # Enter
+      :ok = GPIO.write(out, 0b011)
+      assert_receive {:circuits_gpio, %{ref: ^ref, value: 0b011, previous_value: 0b001}}
+
+      # Bit 2 isn't in the mask
+      :ok = GPIO.write(out, 0b111)
+      refute_receive {:circuits_gpio, _}
+
+      # Leave
+      :ok = GPIO.write(out, 0b101)
+      assert_receive {:circuits_gpio, %{ref: ^ref, value: 0b101, previous_value: 0b111}}
+
+      GPIO.close(out)
+      GPIO.close(input)
+    end
+
+    test "match with trigger: :rising only reports entering" do
+      {:ok, out} = GPIO.open([{@gpiochip, 0}, {@gpiochip, 2}], :output)
+      {:ok, input} = GPIO.open([{@gpiochip, 1}, {@gpiochip, 3}], :input)
+
+      {:ok, ref} = GPIO.subscribe(input, match: {0b11, 0b10}, trigger: :rising)
+
+      :ok = GPIO.write(out, 0b10)
+      assert_receive {:circuits_gpio, %{ref: ^ref, value: 0b10}}
+
+      :ok = GPIO.write(out, 0b00)
+      refute_receive {:circuits_gpio, _}
+
+      GPIO.close(out)
+      GPIO.close(input)
+    end
+
+    test "match pattern must be within the mask" do
+      {:ok, input} = GPIO.open([{@gpiochip, 1}, {@gpiochip, 3}], :input)
+      assert_raise ArgumentError, fn -> GPIO.subscribe(input, match: {0b01, 0b10}) end
+      GPIO.close(input)
+    end
+
+    test "timeout_ms reports inactivity once per quiet period" do
+      {:ok, out} = GPIO.open([{@gpiochip, 0}, {@gpiochip, 2}], :output, initial_value: 0b10)
+      {:ok, input} = GPIO.open([{@gpiochip, 1}, {@gpiochip, 3}], :input)
+
+      {:ok, ref} = GPIO.subscribe(input, timeout_ms: 20)
+
+      assert_receive {:circuits_gpio, %{ref: ^ref, event: :timeout, value: 0b10}}
+      refute_receive {:circuits_gpio, %{ref: ^ref, event: :timeout}}, 50
+
+      # An edge re-arms it
+      :ok = GPIO.write(out, 0b11)
+      assert_receive {:circuits_gpio, %{ref: ^ref, value: 0b11, previous_value: 0b10}}
+      assert_receive {:circuits_gpio, %{ref: ^ref, event: :timeout, value: 0b11}}
+
+      GPIO.close(out)
+      GPIO.close(input)
+    end
+
+    test "debounce_us reports one change after the line is stable" do
+      {:ok, out} = GPIO.open([{@gpiochip, 0}, {@gpiochip, 2}], :output, initial_value: 0)
+      {:ok, input} = GPIO.open([{@gpiochip, 1}, {@gpiochip, 3}], :input)
+
+      {:ok, ref} = GPIO.subscribe(input, debounce_us: 10_000)
+
+      # Bounce on line 0 and end high
+      Enum.each([0b01, 0b00, 0b01, 0b00, 0b01], &GPIO.write(out, &1))
+      refute_received {:circuits_gpio, _}
+      assert_receive {:circuits_gpio, %{ref: ^ref, value: 0b01, previous_value: 0b00}}
+
+      # A glitch that returns to where it was isn't reported
+      :ok = GPIO.write(out, 0b11)
+      :ok = GPIO.write(out, 0b01)
+      refute_receive {:circuits_gpio, _}, 50
+
+      GPIO.close(out)
+      GPIO.close(input)
+    end
+
+    test "settle_ns must be a non-negative integer" do
+      {:ok, input} = GPIO.open([{@gpiochip, 1}, {@gpiochip, 3}], :input)
+      assert_raise ArgumentError, fn -> GPIO.subscribe(input, settle_ns: -1) end
+      GPIO.close(input)
+    end
+  end
+
+  describe "subscribe_merged/2" do
+    test "notifications from several handles come to one process" do
+      {:ok, out0} = GPIO.open({"gpiochip0", 0}, :output)
+      {:ok, out1} = GPIO.open({"gpiochip1", 0}, :output)
+      {:ok, in0} = GPIO.open({"gpiochip0", 1}, :input)
+      {:ok, in1} = GPIO.open({"gpiochip1", 1}, :input)
+
+      {:ok, ref} = GPIO.subscribe_merged([in0, in1])
+
+      :ok = GPIO.write(out1, 1)
+      :ok = GPIO.write(out0, 1)
+
+      assert_receive {:circuits_gpio, %{ref: ^ref, source: 1, value: 1} = msg1}
+      assert_receive {:circuits_gpio, %{ref: ^ref, source: 0, value: 1} = msg2}
+      assert msg1.timestamp <= msg2.timestamp
+
+      :ok = GPIO.unsubscribe(in0, ref)
+      :ok = GPIO.write(out0, 0)
+      refute_receive {:circuits_gpio, _}
+
+      Enum.each([out0, out1, in0, in1], &GPIO.close/1)
+    end
+
+    test "reorder_ns holds notifications and keeps them in order" do
+      {:ok, out0} = GPIO.open({"gpiochip0", 0}, :output)
+      {:ok, out1} = GPIO.open({"gpiochip1", 0}, :output)
+      {:ok, in0} = GPIO.open({"gpiochip0", 1}, :input)
+      {:ok, in1} = GPIO.open({"gpiochip1", 1}, :input)
+
+      {:ok, ref} = GPIO.subscribe_merged([in0, in1], reorder_ns: 10_000_000)
+
+      :ok = GPIO.write(out0, 1)
+      :ok = GPIO.write(out1, 1)
+      :ok = GPIO.write(out0, 0)
+
+      assert_receive {:circuits_gpio, %{ref: ^ref, source: 0, value: 1}}
+      assert_receive {:circuits_gpio, %{ref: ^ref, source: 1, value: 1}}
+      assert_receive {:circuits_gpio, %{ref: ^ref, source: 0, value: 0}}
+
+      Enum.each([out0, out1, in0, in1], &GPIO.close/1)
+    end
+
+    test "the same handle can't be listed twice" do
+      {:ok, in0} = GPIO.open({"gpiochip0", 1}, :input)
+      assert_raise ArgumentError, fn -> GPIO.subscribe_merged([in0, in0]) end
+      GPIO.close(in0)
+    end
+  end
+
+  describe "reflexes" do
+    test "mirror drives the output before the notification is sent" do
+      {:ok, out} = GPIO.open({@gpiochip, 0}, :output, initial_value: 0)
+      {:ok, input} = GPIO.open({@gpiochip, 1}, :input)
+      {:ok, reflex_out} = GPIO.open({@gpiochip, 2}, :output, initial_value: 1)
+      {:ok, reflex_in} = GPIO.open({@gpiochip, 3}, :input)
+
+      {:ok, ref} = GPIO.subscribe(input, reflex: {reflex_out, :mirror})
+
+      # The output is set to match the input right away
+      assert GPIO.read(reflex_in) == 0
+
+      :ok = GPIO.write(out, 1)
+      assert GPIO.read(reflex_in) == 1
+      assert_receive {:circuits_gpio, %{ref: ^ref, value: 1}}
+
+      :ok = GPIO.write(out, 0)
+      assert GPIO.read(reflex_in) == 0
+
+      Enum.each([out, input, reflex_out, reflex_in], &GPIO.close/1)
+    end
+
+    test "pulse drives the output high for a while" do
+      {:ok, out} = GPIO.open({@gpiochip, 0}, :output, initial_value: 0)
+      {:ok, input} = GPIO.open({@gpiochip, 1}, :input)
+      {:ok, reflex_out} = GPIO.open([{@gpiochip, 2}, {@gpiochip, 4}], :output, initial_value: 0)
+      {:ok, reflex_in} = GPIO.open([{@gpiochip, 3}, {@gpiochip, 5}], :input)
+
+      {:ok, _ref} =
+        GPIO.subscribe(input, reflex: {reflex_out, {:pulse, 20_000}, 0b10}, trigger: :none)
+
+      :ok = GPIO.write(out, 1)
+      assert GPIO.read(reflex_in) == 0b10
+
+      Process.sleep(50)
+      assert GPIO.read(reflex_in) == 0
+      refute_receive {:circuits_gpio, _}
+
+      Enum.each([out, input, reflex_out, reflex_in], &GPIO.close/1)
+    end
+
+    test "the reflex output must be an output" do
+      {:ok, input} = GPIO.open({@gpiochip, 1}, :input)
+      {:ok, other} = GPIO.open({@gpiochip, 3}, :input)
+
+      assert {:error, :pin_not_output} = GPIO.subscribe(input, reflex: {other, :mirror})
+      assert_raise ArgumentError, fn -> GPIO.subscribe(input, reflex: {other, :bogus}) end
+
+      # Sub-handles go by their group's current direction
+      {:ok, group} = GPIO.open([{@gpiochip, 2}, {@gpiochip, 4}], :output)
+      {:ok, sub} = GPIO.open_sub(group, [1])
+      :ok = GPIO.set_direction(group, :input)
+      assert {:error, :pin_not_output} = GPIO.subscribe(input, reflex: {sub, :mirror})
+
+      GPIO.close(sub)
+      GPIO.close(group)
+      GPIO.close(input)
+      GPIO.close(other)
+    end
+  end
+
+  describe "keypad" do
+    alias Circuits.GPIO.Keypad
+
+    test "reports pressed keys" do
+      # The stub connects each row to the next line, so keys (0, 0) and (1, 1)
+      # read as pressed
+      {:ok, rows} =
+        GPIO.open([{@gpiochip, 0}, {@gpiochip, 2}], :output,
+          initial_value: 0b11,
+          drive_mode: :open_drain
+        )
+
+      {:ok, cols} = GPIO.open([{@gpiochip, 1}, {@gpiochip, 3}], :input, pull_mode: :pullup)
+
+      {:ok, keypad} = Keypad.start(rows, cols, scan_ms: 2, debounce_us: 0, keys: [:a, :b, :c, :d])
+      ref = keypad.ref
+
+      assert_receive {:circuits_gpio, %{ref: ^ref, event: :key_down, key: :a, row: 0, column: 0}}
+      assert_receive {:circuits_gpio, %{ref: ^ref, event: :key_down, key: :d, row: 1, column: 1}}
+      assert Keypad.pressed(keypad) == [:a, :d]
+
+      :ok = Keypad.stop(keypad)
+      refute_receive {:circuits_gpio, _}
+
+      GPIO.close(rows)
+      GPIO.close(cols)
+    end
+
+    test "rows must be an output and options must fit" do
+      {:ok, rows} =
+        GPIO.open([{@gpiochip, 0}, {@gpiochip, 2}], :output,
+          initial_value: 0b11,
+          drive_mode: :open_drain
+        )
+
+      {:ok, cols} = GPIO.open([{@gpiochip, 1}, {@gpiochip, 3}], :input)
+
+      assert {:error, :pin_not_output} = Keypad.start(cols, rows)
+      assert_raise ArgumentError, fn -> Keypad.start(rows, cols, keys: [:a]) end
+
+      # Both rows settling for 5 ms doesn't fit in a 10 ms scan
+      assert_raise ArgumentError, fn -> Keypad.start(rows, cols, settle_us: 5000) end
+
+      GPIO.close(rows)
+      GPIO.close(cols)
+    end
+
+    test "rows can't be push-pull" do
+      {:ok, rows} = GPIO.open([{@gpiochip, 0}, {@gpiochip, 2}], :output, initial_value: 0b11)
+      {:ok, cols} = GPIO.open([{@gpiochip, 1}, {@gpiochip, 3}], :input)
+
+      assert {:error, :not_open_drain} = Keypad.start(rows, cols)
+      assert {:error, :not_open_source} = Keypad.start(rows, cols, active_low: false)
+
+      GPIO.close(rows)
+      GPIO.close(cols)
+    end
+  end
+
+  describe "software PWM" do
+    alias Circuits.GPIO.SoftPWM
+
+    test "drives each channel with its own duty cycle" do
+      {:ok, out} = GPIO.open([{@gpiochip, 0}, {@gpiochip, 2}], :output, initial_value: 0)
+      {:ok, input} = GPIO.open([{@gpiochip, 1}, {@gpiochip, 3}], :input)
+
+      {:ok, pwm} = SoftPWM.start(out, period_us: 1000, duty: 0.5)
+
+      # Both levels show up when sampling a 50% duty cycle
+      samples = for _ <- 1..2000, do: GPIO.read(input)
+      assert 0b00 in samples
+      assert 0b11 in samples
+
+      :ok = SoftPWM.set(pwm, 0, 1)
+      :ok = SoftPWM.set(pwm, 1, 0, period_us: 2000)
+      assert SoftPWM.get(pwm, 1) == %{duty: 0.0, period_us: 2000}
+
+      Process.sleep(10)
+      assert GPIO.read(input) == 0b01
+
+      :ok = SoftPWM.stop(pwm)
+      assert GPIO.read(input) == 0
+
+      GPIO.close(out)
+      GPIO.close(input)
+    end
+
+    test "rejects bad settings" do
+      {:ok, out} = GPIO.open({@gpiochip, 0}, :output)
+      {:ok, input} = GPIO.open({@gpiochip, 1}, :input)
+
+      assert {:error, :pin_not_output} = SoftPWM.start(input)
+      assert_raise ArgumentError, fn -> SoftPWM.start(out, period_us: 1) end
+
+      {:ok, pwm} = SoftPWM.start(out)
+      assert_raise ArgumentError, fn -> SoftPWM.set(pwm, 0, 1.5) end
+      assert_raise ArgumentError, fn -> SoftPWM.set(pwm, 1, 0.5) end
+      SoftPWM.stop(pwm)
+
+      GPIO.close(out)
+      GPIO.close(input)
+    end
+  end
+
+  describe "heartbeat" do
+    alias Circuits.GPIO.Heartbeat
+
+    test "toggles until it isn't fed" do
+      {:ok, out} = GPIO.open({@gpiochip, 0}, :output, initial_value: 0)
+      {:ok, input} = GPIO.open({@gpiochip, 1}, :input)
+
+      {:ok, heartbeat} = Heartbeat.start(out, period_ms: 2, feed_ms: 30)
+      ref = heartbeat.ref
+
+      samples = for _ <- 1..200, do: GPIO.read(input)
+      assert 0 in samples
+      assert 1 in samples
+
+      assert_receive {:circuits_gpio, %{ref: ^ref, event: :starved}}, 200
+      level = GPIO.read(input)
+      Process.sleep(10)
+      assert GPIO.read(input) == level
+
+      :ok = Heartbeat.feed(heartbeat)
+      assert_receive {:circuits_gpio, %{ref: ^ref, event: :resumed}}
+
+      :ok = Heartbeat.stop(heartbeat)
+      GPIO.close(out)
+      GPIO.close(input)
+    end
+
+    test "needs an output" do
+      {:ok, input} = GPIO.open({@gpiochip, 1}, :input)
+      assert {:error, :pin_not_output} = Heartbeat.start(input)
+      GPIO.close(input)
+    end
+
+    test "stops with an error when its output is closed" do
+      {:ok, out} = GPIO.open({@gpiochip, 0}, :output, initial_value: 0)
+      {:ok, heartbeat} = Heartbeat.start(out, period_ms: 2, feed_ms: 1000)
+      ref = heartbeat.ref
+
+      GPIO.close(out)
+      assert_receive {:circuits_gpio, %{ref: ^ref, event: :error, reason: :ebadf}}, 200
+
+      :ok = Heartbeat.stop(heartbeat)
+    end
+  end
+
+  describe "stepper" do
+    alias Circuits.GPIO.Stepper
+
+    test "moves with a trapezoidal profile" do
+      {:ok, out} = GPIO.open([{@gpiochip, 0}, {@gpiochip, 2}], :output, initial_value: 0)
+      {:ok, input} = GPIO.open([{@gpiochip, 1}, {@gpiochip, 3}], :input)
+
+      {:ok, stepper} = Stepper.start(out)
+      ref = stepper.ref
+
+      # 200 steps accelerating at 20000 steps/s^2 never reaches max_speed and
+      # takes 0.2 seconds
+      start = System.monotonic_time(:millisecond)
+      :ok = Stepper.move(stepper, 200, max_speed: 5000, acceleration: 20000)
+      assert {:error, :busy} = Stepper.move(stepper, 1)
+      assert %{moving: true} = Stepper.status(stepper)
+
+      assert_receive {:circuits_gpio,
+                      %{ref: ^ref, event: :move_done, position: 200, halted: false}},
+                     1000
+
+      assert System.monotonic_time(:millisecond) - start >= 190
+      assert Stepper.status(stepper) == %{position: 200, moving: false}
+
+      # Moving backwards sets the direction GPIO
+      :ok = Stepper.move_to(stepper, 150, max_speed: 5000, acceleration: 100_000)
+      assert_receive {:circuits_gpio, %{ref: ^ref, event: :move_done, position: 150}}, 1000
+      assert GPIO.read(input) == 0b10
+
+      :ok = Stepper.stop(stepper)
+      GPIO.close(out)
+      GPIO.close(input)
+    end
+
+    test "halts a move" do
+      {:ok, out} = GPIO.open([{@gpiochip, 0}, {@gpiochip, 2}], :output, initial_value: 0)
+
+      {:ok, stepper} = Stepper.start(out, position: 1000)
+      :ok = Stepper.move(stepper, -100_000)
+      Process.sleep(50)
+      :ok = Stepper.halt(stepper)
+
+      assert_receive {:circuits_gpio, %{event: :move_done, position: position, halted: true}}
+      assert position < 1000
+
+      :ok = Stepper.stop(stepper)
+      GPIO.close(out)
+    end
+  end
+
+  describe "sequencer" do
+    alias Circuits.GPIO.Sequencer
+
+    test "runs writes, reads, waits and loops" do
+      {:ok, out} = GPIO.open([{@gpiochip, 0}, {@gpiochip, 2}], :output, initial_value: 0)
+      {:ok, input} = GPIO.open([{@gpiochip, 1}, {@gpiochip, 3}], :input)
+
+      program = [
+        {:write, 0b11, 0b01},
+        {:wait_us, 10},
+        {:read, 1},
+        {:loop, 2, [{:write, 0b10, 0b10}, {:read, 1}, {:write, 0b11, 0}, {:read, 1}]},
+        {:wait_level, 1, 0b11, 0, 1000}
+      ]
+
+      assert Sequencer.run([out, input], program) == {:ok, <<1, 3, 0, 2, 0>>}
+
+      GPIO.close(out)
+      GPIO.close(input)
+    end
+
+    test "reports wait_level timeouts with the data so far" do
+      {:ok, out} = GPIO.open({@gpiochip, 0}, :output, initial_value: 0)
+      {:ok, input} = GPIO.open({@gpiochip, 1}, :input)
+
+      program = [{:read, 1}, {:wait_level, 1, 1, 1, 1000}]
+      assert Sequencer.run([out, input], program) == {:error, :timeout, <<0>>}
+
+      GPIO.close(out)
+      GPIO.close(input)
+    end
+
+    test "rejects bad programs" do
+      {:ok, out} = GPIO.open({@gpiochip, 0}, :output)
+      {:ok, input} = GPIO.open({@gpiochip, 1}, :input)
+
+      assert {:error, :pin_not_output} = Sequencer.run([out, input], [{:write, 1, 1, 1}])
+      assert_raise ArgumentError, fn -> Sequencer.run(out, [{:read, 3}]) end
+      assert_raise ArgumentError, fn -> Sequencer.run(out, [:bogus]) end
+
+      GPIO.close(out)
+      GPIO.close(input)
+    end
+  end
+
+  describe "shift" do
+    alias Circuits.GPIO.Shift
+
+    test "transfer loops data back in every mode and bit order" do
+      {:ok, out} = GPIO.open([{@gpiochip, 0}, {@gpiochip, 2}], :output, initial_value: 0)
+      {:ok, miso} = GPIO.open({@gpiochip, 1}, :input)
+      {:ok, sck} = GPIO.open({@gpiochip, 3}, :input)
+
+      for mode <- 0..3, bit_order <- [:msb_first, :lsb_first] do
+        assert Shift.transfer(out, miso, [0xA5, 0x01, 0x80], mode: mode, bit_order: bit_order) ==
+                 <<0xA5, 0x01, 0x80>>
+
+        # The clock is left at its idle level
+        assert GPIO.read(sck) == div(mode, 2)
+      end
+
+      Enum.each([out, miso, sck], &GPIO.close/1)
+    end
+
+    test "shift_out pulses the latch and transfer releases chip select" do
+      {:ok, out} = GPIO.open([{@gpiochip, 0}, {@gpiochip, 2}, {@gpiochip, 4}], :output)
+      {:ok, miso} = GPIO.open({@gpiochip, 1}, :input)
+      {:ok, select} = GPIO.open({@gpiochip, 5}, :input)
+      {:ok, ref} = GPIO.subscribe(select)
+
+      assert Shift.shift_out(out, <<0x55>>) == :ok
+      assert_receive {:circuits_gpio, %{ref: ^ref, value: 1}}
+      assert_receive {:circuits_gpio, %{ref: ^ref, value: 0}}
+
+      assert Shift.transfer(out, miso, <<0x3C>>) == <<0x3C>>
+      assert GPIO.read(select) == 1
+
+      Enum.each([out, miso, select], &GPIO.close/1)
+    end
+
+    test "needs an output handle" do
+      {:ok, input} = GPIO.open([{@gpiochip, 1}, {@gpiochip, 3}], :input)
+      assert_raise ErlangError, fn -> Shift.shift_out(input, <<1>>) end
+      GPIO.close(input)
+    end
+  end
+
+  describe "1-Wire" do
+    alias Circuits.GPIO.OneWire
+
+    test "reports an empty bus" do
+      {:ok, bus} =
+        GPIO.open({@gpiochip, 0}, :output,
+          initial_value: 1,
+          drive_mode: :open_drain,
+          pull_mode: :pullup
+        )
+
+      assert OneWire.reset(bus) == {:error, :no_presence}
+      assert OneWire.search(bus) == {:ok, []}
+      assert OneWire.transfer(bus, :skip, <<0x44>>) == {:error, :no_presence}
+
+      GPIO.close(bus)
+    end
+
+    test "reports a bus that's stuck low" do
+      {:ok, bus} = GPIO.open({@gpiochip, 0}, :output, initial_value: 1, drive_mode: :open_drain)
+      {:ok, other} = GPIO.open({@gpiochip, 1}, :output, initial_value: 0)
+
+      assert OneWire.reset(bus) == {:error, :bus_low}
+
+      GPIO.close(bus)
+      GPIO.close(other)
+    end
+
+    test "needs an open-drain output" do
+      {:ok, gpio} = GPIO.open({@gpiochip, 0}, :output, initial_value: 1)
+      assert OneWire.reset(gpio) == {:error, :not_open_drain}
+      assert OneWire.search(gpio) == {:error, :not_open_drain}
+      GPIO.close(gpio)
+    end
+  end
+
+  describe "logic analyzer" do
+    alias Circuits.GPIO.LogicAnalyzer
+
+    test "records edges after the trigger with pre-trigger history" do
+      {:ok, a_out} = GPIO.open([{@gpiochip, 0}, {@gpiochip, 2}], :output, initial_value: 0)
+      {:ok, a} = GPIO.open([{@gpiochip, 1}, {@gpiochip, 3}], :input)
+      {:ok, b_out} = GPIO.open({@gpiochip, 4}, :output, initial_value: 0)
+      {:ok, b} = GPIO.open({@gpiochip, 5}, :input)
+
+      {:ok, capture} =
+        LogicAnalyzer.capture_start([a, b], max_edges: 4, pre_trigger: 2, trigger: {b, 1, 1})
+
+      ref = capture.ref
+      Enum.each([1, 3, 2], &GPIO.write(a_out, &1))
+      :ok = GPIO.write(b_out, 1)
+      assert_receive {:circuits_gpio, %{ref: ^ref, event: :triggered}}
+      :ok = GPIO.write(a_out, 0)
+      assert_receive {:circuits_gpio, %{ref: ^ref, event: :capture_full}}
+      :ok = GPIO.write(a_out, 1)
+
+      assert {:ok, result} = LogicAnalyzer.capture_stop(capture)
+      assert %{widths: [2, 1], initial: [1, 0], dropped: 1, trigger_timestamp: trigger} = result
+      assert [{_, 0, 3}, {_, 0, 2}, {^trigger, 1, 1}, {_, 0, 0}] = LogicAnalyzer.edges(result)
+
+      GPIO.close(a_out)
+      GPIO.close(a)
+      GPIO.close(b_out)
+      GPIO.close(b)
+    end
+
+    test "converts captures to VCD" do
+      result = %{
+        widths: [1, 2],
+        initial: [0, 2],
+        start_timestamp: 1000,
+        trigger_timestamp: 1000,
+        edges: <<1500::little-signed-64, 1::little-64, 0, 1500::little-signed-64, 1::little-64, 1>>,
+        dropped: 0
+      }
+
+      vcd = result |> LogicAnalyzer.to_vcd(names: ["clk", "bus"]) |> IO.iodata_to_binary()
+      assert vcd =~ "$var wire 1 ! clk $end"
+      assert vcd =~ "$var wire 2 \" bus [1:0] $end"
+      assert vcd =~ "$dumpvars\n0!\nb10 \"\n$end\n"
+      assert vcd =~ "#500\n1!\nb01 \"\n"
+    end
+  end
+
+  describe "flight recorder" do
+    alias Circuits.GPIO.FlightRecorder
+
+    @tag :tmp_dir
+    test "records the last edges to a file", %{tmp_dir: tmp_dir} do
+      path = Path.join(tmp_dir, "gpio.fr")
+      {:ok, out} = GPIO.open([{@gpiochip, 0}, {@gpiochip, 2}], :output, initial_value: 0)
+      {:ok, input} = GPIO.open([{@gpiochip, 1}, {@gpiochip, 3}], :input)
+
+      {:ok, ref} = FlightRecorder.start(input, path, max_records: 4)
+      Enum.each([0b01, 0b11, 0b10, 0b00, 0b01, 0b00], &GPIO.write(out, &1))
+      refute_receive {:circuits_gpio, _}
+      assert :ok = FlightRecorder.stop(input, ref)
+
+      assert {:ok, %{gpiochip: @gpiochip, num_lines: 2, written: 6, records: records}} =
+               FlightRecorder.read(path)
+
+      assert [
+               %{offset: 1, edge: :falling, value: 0b10},
+               %{offset: 3, edge: :falling, value: 0b00},
+               %{offset: 1, edge: :rising, value: 0b01},
+               %{offset: 1, edge: :falling, value: 0b00}
+             ] = records
+
+      assert Enum.map(records, & &1.seqno) == Enum.sort(Enum.map(records, & &1.seqno))
+
+      GPIO.close(out)
+      GPIO.close(input)
+    end
+
+    test "rejects files that aren't recordings" do
+      assert {:error, :invalid_file} = FlightRecorder.decode("not a recording")
+    end
+  end
+
+  describe "transfer" do
+    test "moves subscriptions to another process" do
+      {:ok, out} = GPIO.open({@gpiochip, 0}, :output)
+      {:ok, input} = GPIO.open({@gpiochip, 1}, :input)
+      {:ok, ref} = GPIO.subscribe(input)
+      {:ok, counter_ref} = GPIO.subscribe(input, mode: :counter)
+
+      test_pid = self()
+
+      owner =
+        spawn_link(fn ->
+          receive do
+            {:circuits_gpio, _} = msg -> send(test_pid, {:forwarded, msg})
+          end
+        end)
+
+      :ok = GPIO.write(out, 1)
+      assert_receive {:circuits_gpio, %{ref: ^ref, value: 1}}
+
+      :ok = GPIO.transfer(input, owner)
+      :ok = GPIO.write(out, 0)
+      assert_receive {:forwarded, {:circuits_gpio, %{ref: ^ref, value: 0}}}
+      refute_received {:circuits_gpio, _}
+
+      # Mode state carries over
+      assert {:ok, %{lines: [%{count: 2}]}} = GPIO.read_counter(input, counter_ref)
+
+      GPIO.close(out)
+      GPIO.close(input)
+    end
+
+    test "leaves merged subscriptions with other handles alone" do
+      {:ok, out0} = GPIO.open({"gpiochip0", 0}, :output)
+      {:ok, out1} = GPIO.open({"gpiochip1", 0}, :output)
+      {:ok, in0} = GPIO.open({"gpiochip0", 1}, :input)
+      {:ok, in1} = GPIO.open({"gpiochip1", 1}, :input)
+
+      {:ok, ref} = GPIO.subscribe_merged([in0, in1])
+      other = spawn_link(fn -> Process.sleep(:infinity) end)
+
+      assert GPIO.transfer(in0, other) == {:error, :merged}
+
+      :ok = GPIO.write(out0, 1)
+      :ok = GPIO.write(out1, 1)
+      assert_receive {:circuits_gpio, %{ref: ^ref, source: 0, value: 1}}
+      assert_receive {:circuits_gpio, %{ref: ^ref, source: 1, value: 1}}
+
+      Enum.each([out0, out1, in0, in1], &GPIO.close/1)
+    end
+
+    test "rejects unknown names" do
+      {:ok, input} = GPIO.open({@gpiochip, 1}, :input)
+      assert GPIO.transfer(input, :no_such_process) == {:error, :not_found}
+      GPIO.close(input)
+    end
+  end
+
+  describe "sub-handles" do
+    test "writes only change the sub-handle's lines" do
+      {:ok, out} =
+        GPIO.open([{@gpiochip, 0}, {@gpiochip, 2}, {@gpiochip, 4}, {@gpiochip, 6}], :output)
+
+      {:ok, low} = GPIO.open_sub(out, [0, 1])
+      {:ok, high} = GPIO.open_sub(out, [3])
+
+      :ok = GPIO.write(low, 0b11)
+      :ok = GPIO.write(high, 1)
+      assert GPIO.read(out) == 0b1011
+
+      :ok = GPIO.write(low, 0)
+      assert GPIO.read(out) == 0b1000
+      assert GPIO.read(high) == 1
+
+      assert GPIO.set_direction(low, :input) == {:error, :sub_handle}
+      assert GPIO.open_sub(out, [4]) == {:error, :not_found}
+      assert GPIO.open_sub(out, [1, 1]) == {:error, :duplicate_lines}
+
+      GPIO.close(low)
+      GPIO.close(high)
+      GPIO.close(out)
+    end
+
+    test "subscriptions only see the sub-handle's lines" do
+      {:ok, out} = GPIO.open([{@gpiochip, 0}, {@gpiochip, 2}], :output)
+      {:ok, input} = GPIO.open([{@gpiochip, 1}, {@gpiochip, 3}], :input)
+      {:ok, sub} = GPIO.open_sub(input, [1])
+
+      {:ok, ref} = GPIO.subscribe(sub)
+      {:ok, group_ref} = GPIO.subscribe(input)
+
+      :ok = GPIO.write(out, 0b01)
+      assert_receive {:circuits_gpio, %{ref: ^group_ref, value: 0b01}}
+      refute_receive {:circuits_gpio, %{ref: ^ref}}
+
+      :ok = GPIO.write(out, 0b11)
+      assert_receive {:circuits_gpio, %{ref: ^ref, value: 1, previous_value: 0}}
+      assert_receive {:circuits_gpio, %{ref: ^group_ref, value: 0b11}}
+
+      # Unsubscribing the sub-handle leaves the group's subscription alone
+      :ok = GPIO.unsubscribe(sub)
+      :ok = GPIO.write(out, 0b10)
+      assert_receive {:circuits_gpio, %{ref: ^group_ref, value: 0b10}}
+      refute_receive {:circuits_gpio, %{ref: ^ref}}
+
+      GPIO.close(sub)
+      GPIO.close(out)
+      GPIO.close(input)
+    end
+
+    test "direction checks use the group's current direction" do
+      {:ok, group} = GPIO.open([{@gpiochip, 0}, {@gpiochip, 2}], :output)
+      {:ok, sub} = GPIO.open_sub(group, [1])
+      :ok = GPIO.set_direction(group, :input)
+
+      assert {:error, :pin_not_output} = Circuits.GPIO.SoftPWM.start(sub)
+      assert {:error, :pin_not_output} = Circuits.GPIO.Heartbeat.start(sub)
+
+      GPIO.close(sub)
+      GPIO.close(group)
+    end
+  end
+
+  describe "C API" do
+    alias Circuits.GPIO.CApi
+
+    test "returns the function table" do
+      assert {:ok, %{version: 1, address: address}} = CApi.api()
+      assert is_integer(address) and address > 0
+    end
+
+    test "returns handle resources" do
+      {:ok, gpio} = GPIO.open({@gpiochip, 0}, :output)
+      assert {:ok, ref} = CApi.resource(gpio)
+      assert ref == gpio.ref
+      GPIO.close(gpio)
+    end
+  end
+
+  describe "subscription modes" do
+    test "encoder mode counts quadrature steps without messages" do
+      {:ok, out} = GPIO.open([{@gpiochip, 0}, {@gpiochip, 2}], :output, initial_value: 0)
+      {:ok, input} = GPIO.open([{@gpiochip, 1}, {@gpiochip, 3}], :input)
+
+      {:ok, ref} = GPIO.subscribe(input, mode: :encoder)
+
+      Enum.each([0b01, 0b11, 0b10, 0b00, 0b01], &GPIO.write(out, &1))
+      assert {:ok, %{position: 5, errors: 0}} = GPIO.read_counter(input, ref)
+
+      Enum.each([0b00, 0b10, 0b11], &GPIO.write(out, &1))
+      assert {:ok, %{position: 2}} = GPIO.read_counter(input, ref, clear: true)
+      assert {:ok, %{position: 0}} = GPIO.read_counter(input, ref)
+
+      refute_receive {:circuits_gpio, _}
+
+      GPIO.close(out)
+      GPIO.close(input)
+    end
+
+    test "encoder mode sends throttled position notifications" do
+      {:ok, out} = GPIO.open([{@gpiochip, 0}, {@gpiochip, 2}], :output, initial_value: 0)
+      {:ok, input} = GPIO.open([{@gpiochip, 1}, {@gpiochip, 3}], :input)
+
+      {:ok, ref} = GPIO.subscribe(input, mode: :encoder, report_ms: 20)
+
+      Enum.each([0b01, 0b11, 0b10, 0b00], &GPIO.write(out, &1))
+
+      # The first step is reported right away and the rest after report_ms
+      assert_receive {:circuits_gpio, %{ref: ^ref, event: :position, position: 1}}
+      assert_receive {:circuits_gpio, %{ref: ^ref, event: :position, position: 4, errors: 0}}
+      refute_receive {:circuits_gpio, _}, 50
+
+      GPIO.close(out)
+      GPIO.close(input)
+    end
+
+    test "counter mode counts edges on each line" do
+      {:ok, out} = GPIO.open([{@gpiochip, 0}, {@gpiochip, 2}], :output, initial_value: 0)
+      {:ok, input} = GPIO.open([{@gpiochip, 1}, {@gpiochip, 3}], :input)
+
+      {:ok, ref} = GPIO.subscribe(input, mode: :counter, trigger: :rising)
+
+      Enum.each([0b01, 0b00, 0b01, 0b11, 0b00], &GPIO.write(out, &1))
+
+      assert {:ok, %{lines: [line0, line1]}} = GPIO.read_counter(input, ref, clear: true)
+      assert %{count: 2, first_timestamp: first, last_timestamp: last} = line0
+      assert first <= last
+      assert line0.frequency > 0.0
+      assert %{count: 1} = line1
+
+      assert {:ok, %{lines: [%{count: 0, last_timestamp: nil}, %{count: 0}]}} =
+               GPIO.read_counter(input, ref)
+
+      refute_receive {:circuits_gpio, _}
+
+      GPIO.close(out)
+      GPIO.close(input)
+    end
+
+    test "counter mode sends counts every report_ms" do
+      {:ok, out} = GPIO.open({@gpiochip, 0}, :output, initial_value: 0)
+      {:ok, input} = GPIO.open({@gpiochip, 1}, :input)
+
+      {:ok, ref} = GPIO.subscribe(input, mode: :counter, report_ms: 20)
+
+      :ok = GPIO.write(out, 1)
+      assert_receive {:circuits_gpio, %{ref: ^ref, event: :count, lines: [%{count: 1}]}}
+      assert_receive {:circuits_gpio, %{ref: ^ref, event: :count, lines: [%{count: 1}]}}
+
+      GPIO.close(out)
+      GPIO.close(input)
+    end
+
+    test "pulse mode measures pulses" do
+      {:ok, out} = GPIO.open({@gpiochip, 0}, :output, initial_value: 0)
+      {:ok, input} = GPIO.open({@gpiochip, 1}, :input)
+
+      {:ok, ref} = GPIO.subscribe(input, mode: :pulse, each_pulse: true)
+
+      :ok = GPIO.write(out, 1)
+      :ok = GPIO.write(out, 0)
+      assert_receive {:circuits_gpio, %{ref: ^ref, event: :pulse, line: 0, high_ns: high, low_ns: nil}}
+      assert high >= 0
+
+      :ok = GPIO.write(out, 1)
+      :ok = GPIO.write(out, 0)
+      assert_receive {:circuits_gpio, %{ref: ^ref, event: :pulse, low_ns: low, period_ns: period}}
+      assert period >= low
+
+      assert {:ok, %{lines: [line]}} = GPIO.read_pulses(input, ref, clear: true)
+      assert %{count: 2, high_ns: %{min: _, max: _, mean: _}, duty: %{mean: duty}} = line
+      assert duty >= 0.0 and duty <= 1.0
+
+      assert {:ok, %{lines: [%{count: 0, high_ns: nil}]}} = GPIO.read_pulses(input, ref)
+
+      GPIO.close(out)
+      GPIO.close(input)
+    end
+
+    test "latch mode remembers short pulses" do
+      {:ok, out} = GPIO.open([{@gpiochip, 0}, {@gpiochip, 2}], :output, initial_value: 0)
+      {:ok, input} = GPIO.open([{@gpiochip, 1}, {@gpiochip, 3}], :input)
+
+      assert {:error, :not_found} = GPIO.read_latched(input)
+      {:ok, _ref} = GPIO.subscribe(input, mode: :latch)
+
+      :ok = GPIO.write(out, 0b01)
+      :ok = GPIO.write(out, 0b00)
+      :ok = GPIO.write(out, 0b10)
+
+      assert {:ok, %{rising: 0b11, falling: 0b01}} = GPIO.read_latched(input, clear: true)
+      assert {:ok, %{rising: 0, falling: 0}} = GPIO.read_latched(input)
+      refute_receive {:circuits_gpio, _}
+
+      GPIO.close(out)
+      GPIO.close(input)
+    end
+
+    test "wiegand mode sends one message per frame" do
+      {:ok, out} = GPIO.open([{@gpiochip, 0}, {@gpiochip, 2}], :output, initial_value: 0b11)
+      {:ok, input} = GPIO.open([{@gpiochip, 1}, {@gpiochip, 3}], :input)
+
+      {:ok, ref} = GPIO.subscribe(input, mode: :wiegand, frame_gap_us: 10_000)
+
+      # Send 1011. A 0 pulses D0 (bit 0) low and a 1 pulses D1 (bit 1) low.
+      for bit <- [1, 0, 1, 1] do
+        :ok = GPIO.write(out, if(bit == 1, do: 0b01, else: 0b10))
+        :ok = GPIO.write(out, 0b11)
+      end
+
+      assert_receive {:circuits_gpio, %{ref: ^ref, event: :wiegand, bits: 4, data: 0b1011}}
+      refute_receive {:circuits_gpio, _}, 50
+      assert {:ok, %{frames: 1, errors: 0}} = GPIO.read_counter(input, ref)
+
+      GPIO.close(out)
+      GPIO.close(input)
+    end
+
+    test "nec mode decodes codes and repeats" do
+      {:ok, out} = GPIO.open({@gpiochip, 0}, :output, initial_value: 1)
+      {:ok, input} = GPIO.open({@gpiochip, 1}, :input)
+
+      {:ok, ref} = GPIO.subscribe(input, mode: :nec)
+
+      # Address 0x04 and command 0x08 with their inverses, least significant bit first
+      data = 0x04 ||| 0xFB <<< 8 ||| 0x08 <<< 16 ||| 0xF7 <<< 24
+      bits = for i <- 0..31, do: data >>> i &&& 1
+      spaces = for bit <- bits, do: if(bit == 1, do: 1687, else: 562)
+
+      leader = [{0, 9000}, {1, 4500}]
+      pulse_train(out, leader ++ Enum.flat_map(spaces, &[{0, 562}, {1, &1}]) ++ [{0, 562}, {1, 0}])
+
+      assert_receive {:circuits_gpio,
+                      %{ref: ^ref, event: :nec, address: 0x04, command: 0x08, repeat: false}}
+
+      Process.sleep(20)
+      pulse_train(out, [{0, 9000}, {1, 2250}, {0, 562}, {1, 0}])
+
+      assert_receive {:circuits_gpio,
+                      %{ref: ^ref, event: :nec, address: 0x04, command: 0x08, repeat: true}}
+      refute_receive {:circuits_gpio, _}, 50
+      assert {:ok, %{frames: 1, errors: 0}} = GPIO.read_counter(input, ref)
+
+      GPIO.close(out)
+      GPIO.close(input)
+    end
+
+    test "dht mode decodes a reading and checks the checksum" do
+      {:ok, out} = GPIO.open({@gpiochip, 0}, :output, initial_value: 1)
+      {:ok, input} = GPIO.open({@gpiochip, 1}, :input)
+
+      {:ok, ref} = GPIO.subscribe(input, mode: :dht)
+
+      # 65.2 % and -10.1 °C. Only the high times matter, so keep the lows short.
+      send_dht = fn raw ->
+        bits = for i <- 39..0//-1, do: raw >>> i &&& 1
+        highs = Enum.flat_map(bits, &[{1, if(&1 == 1, do: 100, else: 0)}, {0, 10}])
+        pulse_train(out, [{0, 10}] ++ highs ++ [{1, 0}])
+      end
+
+      send_dht.(0x028C806573)
+
+      assert_receive {:circuits_gpio,
+                      %{ref: ^ref, event: :dht, humidity: 65.2, temperature: -10.1, raw: 0x028C806573}}
+
+      send_dht.(0x028C806574)
+
+      refute_receive {:circuits_gpio, _}, 50
+      assert {:ok, %{frames: 1, errors: 1}} = GPIO.read_counter(input, ref)
+
+      GPIO.close(out)
+      GPIO.close(input)
+    end
+
+    test "capture mode reads the data on each strobe edge" do
+      {:ok, strobe_out} = GPIO.open({@gpiochip, 0}, :output, initial_value: 0)
+      {:ok, strobe} = GPIO.open({@gpiochip, 1}, :input)
+      {:ok, data_out} = GPIO.open([{@gpiochip, 2}, {@gpiochip, 4}], :output, initial_value: 0)
+      {:ok, data} = GPIO.open([{@gpiochip, 3}, {@gpiochip, 5}], :input)
+
+      {:ok, ref} =
+        GPIO.subscribe(strobe, mode: :capture, data: data, trigger: :rising, batch: 3, flush_ms: 0)
+
+      for value <- [0b01, 0b10, 0b11] do
+        :ok = GPIO.write(data_out, value)
+        :ok = GPIO.write(strobe_out, 1)
+        :ok = GPIO.write(strobe_out, 0)
+      end
+
+      assert_receive {:circuits_gpio, %{ref: ^ref, event: :capture, timestamp: first, data: bin}}
+      records = for <<ts::little-signed-64, value::little-64 <- bin>>, do: {ts, value}
+      assert [{^first, 0b01}, {t2, 0b10}, {t3, 0b11}] = records
+      assert first <= t2 and t2 <= t3
+
+      GPIO.close(strobe_out)
+      GPIO.close(strobe)
+      GPIO.close(data_out)
+      GPIO.close(data)
+    end
+
+    test "capture mode flushes partial batches" do
+      {:ok, strobe_out} = GPIO.open({@gpiochip, 0}, :output, initial_value: 0)
+      {:ok, strobe} = GPIO.open({@gpiochip, 1}, :input)
+      {:ok, data_out} = GPIO.open({@gpiochip, 2}, :output, initial_value: 1)
+      {:ok, data} = GPIO.open({@gpiochip, 3}, :input)
+
+      {:ok, ref} = GPIO.subscribe(strobe, mode: :capture, data: data, flush_ms: 0)
+      :ok = GPIO.write(strobe_out, 1)
+      assert {:ok, %{data: <<_::little-64, 1::little-64>>, errors: 0}} = GPIO.read_capture(strobe, ref)
+      assert {:ok, %{data: <<>>}} = GPIO.read_capture(strobe, ref)
+      GPIO.unsubscribe(strobe, ref)
+
+      {:ok, ref} = GPIO.subscribe(strobe, mode: :capture, data: data, flush_ms: 10)
+      :ok = GPIO.write(strobe_out, 0)
+      assert_receive {:circuits_gpio, %{ref: ^ref, event: :capture, data: <<_::128>>}}
+      refute_receive {:circuits_gpio, _}, 50
+
+      assert_raise ArgumentError, fn -> GPIO.subscribe(strobe, mode: :capture) end
+
+      GPIO.close(strobe_out)
+      GPIO.close(strobe)
+      GPIO.close(data_out)
+      GPIO.close(data)
+    end
+
+    test "encoder mode needs 2 or 3 lines" do
+      {:ok, input} = GPIO.open({@gpiochip, 1}, :input)
+      assert_raise ArgumentError, fn -> GPIO.subscribe(input, mode: :encoder) end
+      assert {:error, :not_found} = GPIO.read_counter(input, make_ref())
+      GPIO.close(input)
+    end
+
+    test "modes can't be filtered or merged" do
+      {:ok, input} = GPIO.open({@gpiochip, 1}, :input)
+
+      assert_raise ArgumentError, fn -> GPIO.subscribe(input, mode: :counter, settle_ns: 1000) end
+      assert_raise ArgumentError, fn -> GPIO.subscribe(input, mode: :latch, match: {1, 1}) end
+
+      GPIO.close(input)
+    end
+  end
+
+  # Write each value and then busy wait for the microseconds after it. The stub
+  # timestamps edges when they're written, so this is close enough to the real
+  # timing for the decoders.
+  defp pulse_train(gpio, steps) do
+    for {value, us} <- steps do
+      :ok = GPIO.write(gpio, value)
+      deadline = :erlang.monotonic_time(:microsecond) + us
+      spin_until(deadline)
+    end
+
+    :ok
+  end
+
+  defp spin_until(deadline) do
+    if :erlang.monotonic_time(:microsecond) < deadline, do: spin_until(deadline)
   end
 end